@@ -1,5 +1,6 @@
 ﻿#include "pch.h"
 #include "dllmain.h"
+#include "sources/AllocationCounter.h"
 
 
 #ifdef _UNITY
@@ -18,6 +19,9 @@ INTERFACE_EXPORT void INTERFACE_API CreateModule()
 
     DebugLog::Create("[libWindowGraphicCapture]");
 
+    BufferPool::Create();
+    PixelKernels::Initialize();
+
     MessageManager::Create();
 
     WindowManager::Create();
@@ -34,6 +38,9 @@ INTERFACE_EXPORT void INTERFACE_API INTERFACE_API DestroyModule()
 
     MessageManager::Destroy();
 
+    BufferPool::Get().Trim();
+    BufferPool::Destroy();
+
     DebugLog::Destroy();
 }
 INTERFACE_EXPORT bool INTERFACE_API IsActiveModule()
@@ -109,6 +116,23 @@ INTERFACE_EXPORT void INTERFACE_API SetErrorFunc(DebugLog::DebugLogFuncPtr func)
     DebugLog::SetErrorFunc(func);
 }
 
+INTERFACE_EXPORT UINT64 INTERFACE_API GetHeapAllocationCount()
+{
+    // Always 0 unless the module is built with _ALLOCATION_COUNTER.
+    return AllocationCounter::GetTotalCount();
+}
+
+INTERFACE_EXPORT void INTERFACE_API SetPixelKernelIsa(CpuIsa maxIsa)
+{
+    // Caps the pixel kernels to the given instruction set, e.g. to reproduce issues seen on older CPUs.
+    PixelKernels::Initialize(maxIsa);
+}
+
+INTERFACE_EXPORT CpuIsa INTERFACE_API GetPixelKernelIsa()
+{
+    return PixelKernels::GetActiveIsa();
+}
+
 void INTERFACE_API OnRenderEvent(int id)
 {
     if (WindowManager::IsNull()) return;
@@ -185,6 +209,10 @@ INTERFACE_EXPORT void INTERFACE_API RequestUpdateWindowTitle(int id)
 INTERFACE_EXPORT void INTERFACE_API RequestCaptureWindow(int id, CapturePriority priority)
 {
     if (WindowManager::IsNull()) return;
+    if (auto window = GetWindow(id))
+    {
+        window->Touch();
+    }
     WindowManager::GetCaptureManager()->RequestCapture(id, priority);
 }
 
@@ -194,6 +222,30 @@ INTERFACE_EXPORT void INTERFACE_API RequestCaptureIcon(int id)
     WindowManager::GetCaptureManager()->RequestCaptureIcon(id);
 }
 
+INTERFACE_EXPORT bool INTERFACE_API GetCaptureRateSettings(CaptureRateSettings* settings)
+{
+    if (!settings || WindowManager::IsNull()) return false;
+    *settings = WindowManager::GetCaptureManager()->GetCaptureRateSettings();
+    return true;
+}
+
+INTERFACE_EXPORT void INTERFACE_API SetCaptureRateSettings(const CaptureRateSettings* settings)
+{
+    if (!settings || WindowManager::IsNull()) return;
+    WindowManager::GetCaptureManager()->SetCaptureRateSettings(*settings);
+}
+
+INTERFACE_EXPORT bool INTERFACE_API GetWindowCaptureRateStats(int id, CaptureRateStats* stats)
+{
+    if (!stats) return false;
+    if (auto window = GetWindow(id))
+    {
+        *stats = window->GetCaptureRateStats();
+        return true;
+    }
+    return false;
+}
+
 INTERFACE_EXPORT HWND INTERFACE_API GetWindowOwnerHandle(int id)
 {
     if (auto window = GetWindow(id))
@@ -417,6 +469,23 @@ INTERFACE_EXPORT void INTERFACE_API SetWindowIconTexturePtr(int id, ID3D11Textur
     }
 }
 
+INTERFACE_EXPORT AlphaMode INTERFACE_API GetWindowIconAlphaMode(int id)
+{
+    if (auto window = GetWindow(id))
+    {
+        return window->GetIconAlphaMode();
+    }
+    return AlphaMode::Straight;
+}
+
+INTERFACE_EXPORT void INTERFACE_API SetWindowIconAlphaMode(int id, AlphaMode mode)
+{
+    if (auto window = GetWindow(id))
+    {
+        window->SetIconAlphaMode(mode);
+    }
+}
+
 INTERFACE_EXPORT CaptureMode INTERFACE_API GetWindowCaptureMode(int id)
 {
     if (auto window = GetWindow(id))
@@ -451,6 +520,187 @@ INTERFACE_EXPORT void INTERFACE_API SetWindowCursorDraw(int id, bool draw)
     }
 }
 
+INTERFACE_EXPORT FrameRotation INTERFACE_API GetWindowRotation(int id)
+{
+    if (auto window = GetWindow(id))
+    {
+        return window->GetRotation();
+    }
+    return FrameRotation::None;
+}
+
+INTERFACE_EXPORT void INTERFACE_API SetWindowRotation(int id, FrameRotation rotation)
+{
+    if (auto window = GetWindow(id))
+    {
+        window->SetRotation(rotation);
+    }
+}
+
+INTERFACE_EXPORT bool INTERFACE_API GetWindowMirror(int id)
+{
+    if (auto window = GetWindow(id))
+    {
+        return window->GetMirror();
+    }
+    return false;
+}
+
+INTERFACE_EXPORT void INTERFACE_API SetWindowMirror(int id, bool mirror)
+{
+    if (auto window = GetWindow(id))
+    {
+        window->SetMirror(mirror);
+    }
+}
+
+INTERFACE_EXPORT void INTERFACE_API SetWindowOutputSize(int id, UINT width, UINT height)
+{
+    if (auto window = GetWindow(id))
+    {
+        window->SetOutputSize(width, height);
+    }
+}
+
+INTERFACE_EXPORT ResampleFilter INTERFACE_API GetWindowOutputFilter(int id)
+{
+    if (auto window = GetWindow(id))
+    {
+        return window->GetOutputFilter();
+    }
+    return ResampleFilter::Nearest;
+}
+
+INTERFACE_EXPORT void INTERFACE_API SetWindowOutputFilter(int id, ResampleFilter filter)
+{
+    if (auto window = GetWindow(id))
+    {
+        window->SetOutputFilter(filter);
+    }
+}
+
+INTERFACE_EXPORT bool INTERFACE_API GetWindowMipGeneration(int id)
+{
+    if (auto window = GetWindow(id))
+    {
+        return window->GetMipGeneration();
+    }
+    return false;
+}
+
+INTERFACE_EXPORT void INTERFACE_API SetWindowMipGeneration(int id, bool enabled)
+{
+    if (auto window = GetWindow(id))
+    {
+        window->SetMipGeneration(enabled);
+    }
+}
+
+INTERFACE_EXPORT UINT64 INTERFACE_API GetWindowMipGenerationTime(int id)
+{
+    // Microseconds spent on the mip chain of the latest frame.
+    if (auto window = GetWindow(id))
+    {
+        return window->GetMipGenerationTime();
+    }
+    return 0;
+}
+
+INTERFACE_EXPORT UINT INTERFACE_API GetWindowMipLevelCount(int id)
+{
+    if (auto window = GetWindow(id))
+    {
+        return window->GetMipLevelCount();
+    }
+    return 0;
+}
+
+INTERFACE_EXPORT bool INTERFACE_API AcquireWindowMipLevel(int id, UINT level, FrameSnapshot* snapshot)
+{
+    // Released with ReleaseWindowFrame().
+    if (auto window = GetWindow(id))
+    {
+        return window->AcquireMipSnapshot(level, snapshot);
+    }
+    return false;
+}
+
+INTERFACE_EXPORT bool INTERFACE_API GetWindowBufferGrowthPolicy(int id, BufferGrowthPolicy* policy)
+{
+    if (!policy) return false;
+    if (auto window = GetWindow(id))
+    {
+        *policy = window->GetBufferGrowthPolicy();
+        return true;
+    }
+    return false;
+}
+
+INTERFACE_EXPORT void INTERFACE_API SetWindowBufferGrowthPolicy(int id, const BufferGrowthPolicy* policy)
+{
+    if (!policy) return;
+    if (auto window = GetWindow(id))
+    {
+        window->SetBufferGrowthPolicy(*policy);
+    }
+}
+
+INTERFACE_EXPORT bool INTERFACE_API GetWindowBufferStats(int id, BufferStats* stats)
+{
+    if (!stats) return false;
+    if (auto window = GetWindow(id))
+    {
+        *stats = window->GetBufferStats();
+        return true;
+    }
+    return false;
+}
+
+INTERFACE_EXPORT float INTERFACE_API GetWindowPartialUploadRatio(int id)
+{
+    if (auto window = GetWindow(id))
+    {
+        return window->GetPartialUploadRatio();
+    }
+    return 0.f;
+}
+
+INTERFACE_EXPORT void INTERFACE_API SetWindowPartialUploadRatio(int id, float ratio)
+{
+    if (auto window = GetWindow(id))
+    {
+        window->SetPartialUploadRatio(ratio);
+    }
+}
+
+INTERFACE_EXPORT bool INTERFACE_API GetWindowUploadStats(int id, UploadStats* stats)
+{
+    if (!stats) return false;
+    if (auto window = GetWindow(id))
+    {
+        *stats = window->GetUploadStats();
+        return true;
+    }
+    return false;
+}
+
+INTERFACE_EXPORT bool INTERFACE_API GetWindowScrollDetection(int id)
+{
+    if (auto window = GetWindow(id))
+    {
+        return window->GetScrollDetection();
+    }
+    return false;
+}
+
+INTERFACE_EXPORT void INTERFACE_API SetWindowScrollDetection(int id, bool enabled)
+{
+    if (auto window = GetWindow(id))
+    {
+        window->SetScrollDetection(enabled);
+    }
+}
+
 INTERFACE_EXPORT bool INTERFACE_API IsWindows(int id)
 {
     if (auto window = GetWindow(id))
@@ -586,6 +836,71 @@ INTERFACE_EXPORT bool INTERFACE_API GetWindowPixels(int id, BYTE* output, int x,
     return false;
 }
 
+INTERFACE_EXPORT UINT INTERFACE_API GetOutputFormatSize(OutputFormat format, int width, int height)
+{
+    if (width <= 0 || height <= 0) return 0;
+    return FormatConverter::GetSize(format, width, height);
+}
+
+INTERFACE_EXPORT bool INTERFACE_API GetWindowPixelsAs(int id, OutputFormat format, BYTE* output, UINT outputSize, int x, int y, int width, int height)
+{
+    if (auto window = GetWindow(id))
+    {
+        return window->GetPixelsAs(format, output, outputSize, x, y, width, height);
+    }
+    return false;
+}
+
+INTERFACE_EXPORT bool INTERFACE_API AcquireWindowFrame(int id, FrameSnapshot* snapshot)
+{
+    if (auto window = GetWindow(id))
+    {
+        return window->AcquireSnapshot(snapshot);
+    }
+    return false;
+}
+
+INTERFACE_EXPORT void INTERFACE_API ReleaseWindowFrame(FrameSnapshot* snapshot)
+{
+    ReleaseFrameSnapshot(snapshot);
+}
+
+INTERFACE_EXPORT int INTERFACE_API GetWindowFrameDirtyRects(const FrameSnapshot* snapshot, RECT* rects, UINT maxCount)
+{
+    // Tiles are 64x64 in frame coordinates and relative to the frame of the previous sequence.
+    return GetFrameSnapshotDirtyRects(snapshot, rects, maxCount);
+}
+
+INTERFACE_EXPORT bool INTERFACE_API GetWindowFrameMotion(const FrameSnapshot* snapshot, RECT* rect, int* dx, int* dy)
+{
+    // Only found with scroll detection on. Drawing the previous frame's pixels at rect offset by
+    // (-dx, -dy) into rect and then the remainder rects gives the frame.
+    return GetFrameSnapshotMotion(snapshot, rect, dx, dy);
+}
+
+INTERFACE_EXPORT int INTERFACE_API GetWindowFrameMotionRemainderRects(const FrameSnapshot* snapshot, RECT* rects, UINT maxCount)
+{
+    return GetFrameSnapshotMotionRemainderRects(snapshot, rects, maxCount);
+}
+
+INTERFACE_EXPORT int INTERFACE_API GetWindowDirtyTileCount(int id)
+{
+    if (auto window = GetWindow(id))
+    {
+        return window->GetDirtyTileCount();
+    }
+    return -1;
+}
+
+INTERFACE_EXPORT UINT64 INTERFACE_API GetWindowSuppressedFrameCount(int id)
+{
+    if (auto window = GetWindow(id))
+    {
+        return window->GetSuppressedFrameCount();
+    }
+    return 0;
+}
+
 INTERFACE_EXPORT POINT INTERFACE_API GetCursorPosition()
 {
     POINT point;
@@ -672,6 +987,44 @@ INTERFACE_EXPORT void INTERFACE_API SetCursorTexturePtr(ID3D11Texture2D* ptr)
     return;
 }
 
+INTERFACE_EXPORT CursorCaptureMode INTERFACE_API GetCursorCaptureMode()
+{
+    if (WindowManager::IsNull()) return CursorCaptureMode::Desktop;
+    if (auto& cursor = WindowManager::Get().GetCursor())
+    {
+        return cursor->GetCaptureMode();
+    }
+    return CursorCaptureMode::Desktop;
+}
+
+INTERFACE_EXPORT void INTERFACE_API SetCursorCaptureMode(CursorCaptureMode mode)
+{
+    if (WindowManager::IsNull()) return;
+    if (auto& cursor = WindowManager::Get().GetCursor())
+    {
+        cursor->SetCaptureMode(mode);
+    }
+}
+
+INTERFACE_EXPORT AlphaMode INTERFACE_API GetCursorAlphaMode()
+{
+    if (WindowManager::IsNull()) return AlphaMode::Straight;
+    if (auto& cursor = WindowManager::Get().GetCursor())
+    {
+        return cursor->GetAlphaMode();
+    }
+    return AlphaMode::Straight;
+}
+
+INTERFACE_EXPORT void INTERFACE_API SetCursorAlphaMode(AlphaMode mode)
+{
+    if (WindowManager::IsNull()) return;
+    if (auto& cursor = WindowManager::Get().GetCursor())
+    {
+        cursor->SetAlphaMode(mode);
+    }
+}
+
 INTERFACE_EXPORT UINT INTERFACE_API GetScreenX()
 {
     return ::GetSystemMetrics(SM_XVIRTUALSCREEN);
@@ -690,4 +1043,76 @@ INTERFACE_EXPORT UINT INTERFACE_API GetScreenWidth()
 INTERFACE_EXPORT UINT INTERFACE_API GetScreenHeight()
 {
     return ::GetSystemMetrics(SM_CYVIRTUALSCREEN);
+}
+
+INTERFACE_EXPORT UINT64 INTERFACE_API GetBufferPoolHitCount()
+{
+    if (BufferPool::IsNull()) return 0;
+    return BufferPool::Get().GetHitCount();
+}
+
+INTERFACE_EXPORT UINT64 INTERFACE_API GetBufferPoolMissCount()
+{
+    if (BufferPool::IsNull()) return 0;
+    return BufferPool::Get().GetMissCount();
+}
+
+INTERFACE_EXPORT UINT64 INTERFACE_API GetBufferPoolCachedBytes()
+{
+    if (BufferPool::IsNull()) return 0;
+    return BufferPool::Get().GetCachedBytes();
+}
+
+INTERFACE_EXPORT void INTERFACE_API SetBufferPoolMaxCachedBytes(UINT64 bytes)
+{
+    if (BufferPool::IsNull()) return;
+    BufferPool::Get().SetMaxCachedBytes(bytes);
+}
+
+INTERFACE_EXPORT void INTERFACE_API SetFrameMemoryBudget(UINT64 bytes)
+{
+    if (BufferPool::IsNull()) return;
+    BufferPool::Get().SetBudgetBytes(bytes);
+}
+
+INTERFACE_EXPORT UINT64 INTERFACE_API GetFrameMemoryBudget()
+{
+    if (BufferPool::IsNull()) return 0;
+    return BufferPool::Get().GetBudgetBytes();
+}
+
+INTERFACE_EXPORT UINT64 INTERFACE_API GetFrameMemoryUsage()
+{
+    if (BufferPool::IsNull()) return 0;
+    return BufferPool::Get().GetTotalBytes();
+}
+
+INTERFACE_EXPORT UINT64 INTERFACE_API GetFrameMemoryEvictionCount()
+{
+    if (WindowManager::IsNull()) return 0;
+    return WindowManager::Get().GetEvictionCount();
+}
+
+INTERFACE_EXPORT void INTERFACE_API SetFrameCompressionIdleTime(UINT64 milliseconds)
+{
+    if (WindowManager::IsNull()) return;
+    WindowManager::Get().SetCompressionIdleTime(milliseconds);
+}
+
+INTERFACE_EXPORT UINT64 INTERFACE_API GetFrameCompressionIdleTime()
+{
+    if (WindowManager::IsNull()) return 0;
+    return WindowManager::Get().GetCompressionIdleTime();
+}
+
+INTERFACE_EXPORT bool INTERFACE_API SetBufferPoolLargePageEnabled(bool enabled)
+{
+    if (BufferPool::IsNull()) return false;
+    return BufferPool::Get().SetLargePageEnabled(enabled);
+}
+
+INTERFACE_EXPORT void INTERFACE_API SetBufferPoolLargePageThreshold(UINT64 bytes)
+{
+    if (BufferPool::IsNull()) return;
+    BufferPool::Get().SetLargePageThreshold(bytes);
 }
\ No newline at end of file
@@ -57,6 +57,9 @@ extern "C"
 	INTERFACE_EXPORT void INTERFACE_API RequestUpdateWindowTitle(int id);
 	INTERFACE_EXPORT void INTERFACE_API RequestCaptureWindow(int id, CapturePriority priority);
 	INTERFACE_EXPORT void INTERFACE_API RequestCaptureIcon(int id);
+	INTERFACE_EXPORT bool INTERFACE_API GetCaptureRateSettings(CaptureRateSettings* settings);
+	INTERFACE_EXPORT void INTERFACE_API SetCaptureRateSettings(const CaptureRateSettings* settings);
+	INTERFACE_EXPORT bool INTERFACE_API GetWindowCaptureRateStats(int id, CaptureRateStats* stats);
 	INTERFACE_EXPORT HWND INTERFACE_API GetWindowOwnerHandle(int id);
 	INTERFACE_EXPORT HWND INTERFACE_API GetWindowParentHandle(int id);
 
@@ -93,6 +96,15 @@ extern "C"
 	INTERFACE_EXPORT bool INTERFACE_API IsWindowsBackground(int id);
 	INTERFACE_EXPORT UINT INTERFACE_API GetWindowPixel(int id, int x, int y);
 	INTERFACE_EXPORT bool INTERFACE_API GetWindowPixels(int id, BYTE* output, int x, int y, int width, int height);
+	INTERFACE_EXPORT UINT INTERFACE_API GetOutputFormatSize(OutputFormat format, int width, int height);
+	INTERFACE_EXPORT bool INTERFACE_API GetWindowPixelsAs(int id, OutputFormat format, BYTE* output, UINT outputSize, int x, int y, int width, int height);
+	INTERFACE_EXPORT bool INTERFACE_API AcquireWindowFrame(int id, FrameSnapshot* snapshot);
+	INTERFACE_EXPORT void INTERFACE_API ReleaseWindowFrame(FrameSnapshot* snapshot);
+	INTERFACE_EXPORT int INTERFACE_API GetWindowFrameDirtyRects(const FrameSnapshot* snapshot, RECT* rects, UINT maxCount);
+	INTERFACE_EXPORT bool INTERFACE_API GetWindowFrameMotion(const FrameSnapshot* snapshot, RECT* rect, int* dx, int* dy);
+	INTERFACE_EXPORT int INTERFACE_API GetWindowFrameMotionRemainderRects(const FrameSnapshot* snapshot, RECT* rects, UINT maxCount);
+	INTERFACE_EXPORT int INTERFACE_API GetWindowDirtyTileCount(int id);
+	INTERFACE_EXPORT UINT64 INTERFACE_API GetWindowSuppressedFrameCount(int id);
 	INTERFACE_EXPORT POINT INTERFACE_API GetCursorPosition();
 	INTERFACE_EXPORT int INTERFACE_API GetWindowIdFromPoint(int x, int y);
 	INTERFACE_EXPORT int INTERFACE_API GetWindowIdUnderCursor();
@@ -102,6 +114,10 @@ extern "C"
 	INTERFACE_EXPORT UINT INTERFACE_API GetCursorWidth();
 	INTERFACE_EXPORT UINT INTERFACE_API GetCursorHeight();
 	INTERFACE_EXPORT void INTERFACE_API SetCursorTexturePtr(ID3D11Texture2D* ptr);
+	INTERFACE_EXPORT CursorCaptureMode INTERFACE_API GetCursorCaptureMode();
+	INTERFACE_EXPORT void INTERFACE_API SetCursorCaptureMode(CursorCaptureMode mode);
+	INTERFACE_EXPORT AlphaMode INTERFACE_API GetCursorAlphaMode();
+	INTERFACE_EXPORT void INTERFACE_API SetCursorAlphaMode(AlphaMode mode);
 	INTERFACE_EXPORT UINT INTERFACE_API GetScreenX();
 	INTERFACE_EXPORT UINT INTERFACE_API GetScreenY();
 	INTERFACE_EXPORT UINT INTERFACE_API GetScreenWidth();
@@ -114,6 +130,8 @@ extern "C"
 	INTERFACE_EXPORT void  INTERFACE_API SetWindowTexturePtr(int id, ID3D11Texture2D* ptr);
 	INTERFACE_EXPORT ID3D11Texture2D* INTERFACE_API GetWindowIconTexturePtr(int id);
 	INTERFACE_EXPORT void INTERFACE_API SetWindowIconTexturePtr(int id, ID3D11Texture2D* ptr);
+	INTERFACE_EXPORT AlphaMode INTERFACE_API GetWindowIconAlphaMode(int id);
+	INTERFACE_EXPORT void INTERFACE_API SetWindowIconAlphaMode(int id, AlphaMode mode);
 
 	//Window capture setup
 	INTERFACE_EXPORT CaptureMode INTERFACE_API GetWindowCaptureMode(int id);
@@ -121,10 +139,48 @@ extern "C"
 
 	INTERFACE_EXPORT bool INTERFACE_API GetWindowCursorDraw(int id);
 	INTERFACE_EXPORT void INTERFACE_API SetWindowCursorDraw(int id, bool draw);
+	INTERFACE_EXPORT FrameRotation INTERFACE_API GetWindowRotation(int id);
+	INTERFACE_EXPORT void INTERFACE_API SetWindowRotation(int id, FrameRotation rotation);
+	INTERFACE_EXPORT bool INTERFACE_API GetWindowMirror(int id);
+	INTERFACE_EXPORT void INTERFACE_API SetWindowMirror(int id, bool mirror);
+	INTERFACE_EXPORT void INTERFACE_API SetWindowOutputSize(int id, UINT width, UINT height);
+	INTERFACE_EXPORT ResampleFilter INTERFACE_API GetWindowOutputFilter(int id);
+	INTERFACE_EXPORT void INTERFACE_API SetWindowOutputFilter(int id, ResampleFilter filter);
+	INTERFACE_EXPORT bool INTERFACE_API GetWindowMipGeneration(int id);
+	INTERFACE_EXPORT void INTERFACE_API SetWindowMipGeneration(int id, bool enabled);
+	INTERFACE_EXPORT UINT64 INTERFACE_API GetWindowMipGenerationTime(int id);
+	INTERFACE_EXPORT UINT INTERFACE_API GetWindowMipLevelCount(int id);
+	INTERFACE_EXPORT bool INTERFACE_API AcquireWindowMipLevel(int id, UINT level, FrameSnapshot* snapshot);
+
+	INTERFACE_EXPORT bool INTERFACE_API GetWindowBufferGrowthPolicy(int id, BufferGrowthPolicy* policy);
+	INTERFACE_EXPORT void INTERFACE_API SetWindowBufferGrowthPolicy(int id, const BufferGrowthPolicy* policy);
+	INTERFACE_EXPORT bool INTERFACE_API GetWindowBufferStats(int id, BufferStats* stats);
+	INTERFACE_EXPORT float INTERFACE_API GetWindowPartialUploadRatio(int id);
+	INTERFACE_EXPORT void INTERFACE_API SetWindowPartialUploadRatio(int id, float ratio);
+	INTERFACE_EXPORT bool INTERFACE_API GetWindowUploadStats(int id, UploadStats* stats);
+	INTERFACE_EXPORT bool INTERFACE_API GetWindowScrollDetection(int id);
+	INTERFACE_EXPORT void INTERFACE_API SetWindowScrollDetection(int id, bool enabled);
+
+	//Memory
+	INTERFACE_EXPORT UINT64 INTERFACE_API GetBufferPoolHitCount();
+	INTERFACE_EXPORT UINT64 INTERFACE_API GetBufferPoolMissCount();
+	INTERFACE_EXPORT UINT64 INTERFACE_API GetBufferPoolCachedBytes();
+	INTERFACE_EXPORT void INTERFACE_API SetBufferPoolMaxCachedBytes(UINT64 bytes);
+	INTERFACE_EXPORT void INTERFACE_API SetFrameMemoryBudget(UINT64 bytes);
+	INTERFACE_EXPORT UINT64 INTERFACE_API GetFrameMemoryBudget();
+	INTERFACE_EXPORT UINT64 INTERFACE_API GetFrameMemoryUsage();
+	INTERFACE_EXPORT UINT64 INTERFACE_API GetFrameMemoryEvictionCount();
+	INTERFACE_EXPORT void INTERFACE_API SetFrameCompressionIdleTime(UINT64 milliseconds);
+	INTERFACE_EXPORT UINT64 INTERFACE_API GetFrameCompressionIdleTime();
+	INTERFACE_EXPORT bool INTERFACE_API SetBufferPoolLargePageEnabled(bool enabled);
+	INTERFACE_EXPORT void INTERFACE_API SetBufferPoolLargePageThreshold(UINT64 bytes);
 
 	//Debug
 	INTERFACE_EXPORT void INTERFACE_API SetDebugMode(DebugLog::Mode mode);
 	INTERFACE_EXPORT void INTERFACE_API SetLogFunc(DebugLog::DebugLogFuncPtr func);
 	INTERFACE_EXPORT void INTERFACE_API SetErrorFunc(DebugLog::DebugLogFuncPtr func);
+	INTERFACE_EXPORT UINT64 INTERFACE_API GetHeapAllocationCount();
+	INTERFACE_EXPORT void INTERFACE_API SetPixelKernelIsa(CpuIsa maxIsa);
+	INTERFACE_EXPORT CpuIsa INTERFACE_API GetPixelKernelIsa();
 
 }
\ No newline at end of file
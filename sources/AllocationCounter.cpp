@@ -0,0 +1,92 @@
+#include "pch.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include "AllocationCounter.h"
+
+#ifdef _ALLOCATION_COUNTER
+
+namespace
+{
+    std::atomic<UINT64> totalCount = 0;
+    thread_local UINT64 threadCount = 0;
+}
+
+
+void* operator new(size_t size)
+{
+    ++totalCount;
+    ++threadCount;
+
+    if (auto ptr = std::malloc(size > 0 ? size : 1)) return ptr;
+    throw std::bad_alloc();
+}
+
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+
+void operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+
+void operator delete[](void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+
+void operator delete(void* ptr, size_t) noexcept
+{
+    std::free(ptr);
+}
+
+
+void operator delete[](void* ptr, size_t) noexcept
+{
+    std::free(ptr);
+}
+
+
+bool AllocationCounter::IsEnabled()
+{
+    return true;
+}
+
+
+UINT64 AllocationCounter::GetTotalCount()
+{
+    return totalCount;
+}
+
+
+UINT64 AllocationCounter::GetThreadCount()
+{
+    return threadCount;
+}
+
+#else //_ALLOCATION_COUNTER
+
+bool AllocationCounter::IsEnabled()
+{
+    return false;
+}
+
+
+UINT64 AllocationCounter::GetTotalCount()
+{
+    return 0;
+}
+
+
+UINT64 AllocationCounter::GetThreadCount()
+{
+    return 0;
+}
+
+#endif //_ALLOCATION_COUNTER
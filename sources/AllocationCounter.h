@@ -0,0 +1,45 @@
+#pragma once
+
+#include <Windows.h>
+
+// Counts the global heap allocations (operator new) made by this module, in total and per thread.
+// The counting operators are compiled in only when _ALLOCATION_COUNTER is defined, as in the
+// tests project; otherwise every count stays 0.
+class AllocationCounter
+{
+public:
+    static bool IsEnabled();
+    static UINT64 GetTotalCount();
+    static UINT64 GetThreadCount();
+};
+
+// Logs the heap allocations made in a scope, e.g. to confirm that a steady-state capture does not allocate.
+class ScopedAllocationCheck
+{
+public:
+    explicit ScopedAllocationCheck(const char* name)
+        : name_(name)
+        , start_(AllocationCounter::GetThreadCount())
+    {
+    }
+
+    ~ScopedAllocationCheck()
+    {
+        const auto count = AllocationCounter::GetThreadCount() - start_;
+        if (count > 0)
+        {
+            DebugLog::Log(name_, " => ", count, " heap allocations");
+        }
+    }
+
+private:
+    const char* const name_;
+    const UINT64 start_;
+};
+
+#ifdef _ALLOCATION_COUNTER
+#define ALLOCATION_CHECK(Name) \
+    ScopedAllocationCheck CONCAT(_allocationCheck_, __COUNTER__)(#Name);
+#else
+#define ALLOCATION_CHECK(Name)
+#endif
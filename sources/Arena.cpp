@@ -0,0 +1,102 @@
+#include "pch.h"
+#include "Arena.h"
+
+
+
+Arena::Arena(size_t blockSize)
+    : blockSize_(blockSize)
+{
+}
+
+
+Arena::~Arena()
+{
+    Release();
+}
+
+
+bool Arena::AddBlock(size_t minSize)
+{
+    if (blockCount_ >= kMaxBlockCount) return false;
+
+    // Double the block size each time so that a few blocks cover any burst.
+    size_t size = blockCount_ > 0 ? blocks_[blockCount_ - 1].capacity * 2 : blockSize_;
+    if (size < minSize) size = minSize;
+    auto block = BufferPool::Allocate(size);
+    if (!block.ptr) return false;
+
+    blocks_[blockCount_++] = block;
+    offset_ = 0;
+
+    return true;
+}
+
+
+void* Arena::Allocate(size_t size, size_t alignment)
+{
+    if (size == 0) return nullptr;
+
+    if (blockCount_ > 0)
+    {
+        const auto& block = blocks_[blockCount_ - 1];
+        const auto base = reinterpret_cast<uintptr_t>(block.ptr);
+        const size_t aligned = (base + offset_ + alignment - 1) / alignment * alignment - base;
+        if (aligned + size <= block.capacity)
+        {
+            offset_ = aligned + size;
+            usedBytes_ += size;
+            return static_cast<BYTE*>(block.ptr) + aligned;
+        }
+    }
+
+    // Blocks are aligned to BufferPool::kDefaultAlignment, which covers any alignof(T).
+    if (!AddBlock(size + alignment)) return nullptr;
+
+    return Allocate(size, alignment);
+}
+
+
+void Arena::Reset()
+{
+    if (blockCount_ > 1)
+    {
+        // Merge the blocks so that the same amount of temporaries fits in one block next time.
+        const size_t capacity = GetCapacity();
+        Release();
+        AddBlock(capacity);
+    }
+
+    offset_ = 0;
+    usedBytes_ = 0;
+}
+
+
+void Arena::Release()
+{
+    for (int i = 0; i < blockCount_; ++i)
+    {
+        BufferPool::Free(blocks_[i]);
+        blocks_[i] = BufferPool::Block();
+    }
+
+    blockCount_ = 0;
+    offset_ = 0;
+    usedBytes_ = 0;
+}
+
+
+size_t Arena::GetUsedBytes() const
+{
+    return usedBytes_;
+}
+
+
+size_t Arena::GetCapacity() const
+{
+    size_t capacity = 0;
+    for (int i = 0; i < blockCount_; ++i)
+    {
+        capacity += blocks_[i].capacity;
+    }
+    return capacity;
+}
\ No newline at end of file
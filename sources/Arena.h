@@ -0,0 +1,93 @@
+#pragma once
+
+#include <Windows.h>
+#include <cstddef>
+#include <new>
+
+#include "BufferPool.h"
+
+// Bump allocator for short-lived temporaries used by one thread.
+// Nothing is freed individually; Reset() releases everything at once and merges the blocks
+// so that the next cycle fits in a single block and does not touch the pool at all.
+class Arena
+{
+public:
+    static constexpr size_t kDefaultBlockSize = 4096;
+
+    explicit Arena(size_t blockSize = kDefaultBlockSize);
+    ~Arena();
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    // Returns nullptr if the arena has run out of blocks.
+    void* Allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+
+    template <class T>
+    T* Allocate(size_t count)
+    {
+        return static_cast<T*>(Allocate(sizeof(T) * count, alignof(T)));
+    }
+
+    void Reset();
+    void Release();
+
+    size_t GetUsedBytes() const;
+    size_t GetCapacity() const;
+
+private:
+    static constexpr int kMaxBlockCount = 8;
+
+    bool AddBlock(size_t minSize);
+
+    BufferPool::Block blocks_[kMaxBlockCount];
+    int blockCount_ = 0;
+    size_t offset_ = 0;
+    size_t usedBytes_ = 0;
+    size_t blockSize_ = kDefaultBlockSize;
+};
+
+
+// Lets standard containers allocate from an Arena. Deallocation is a no-op.
+template <class T>
+class ArenaAllocator
+{
+public:
+    using value_type = T;
+
+    explicit ArenaAllocator(Arena* arena) : arena_(arena) {}
+
+    template <class U>
+    ArenaAllocator(const ArenaAllocator<U>& other) : arena_(other.GetArena()) {}
+
+    T* allocate(size_t count)
+    {
+        auto ptr = arena_->Allocate<T>(count);
+        if (!ptr) throw std::bad_alloc();
+        return ptr;
+    }
+
+    void deallocate(T*, size_t)
+    {
+    }
+
+    Arena* GetArena() const
+    {
+        return arena_;
+    }
+
+private:
+    Arena* arena_;
+};
+
+template <class T, class U>
+bool operator==(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b)
+{
+    return a.GetArena() == b.GetArena();
+}
+
+template <class T, class U>
+bool operator!=(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b)
+{
+    return !(a == b);
+}
\ No newline at end of file
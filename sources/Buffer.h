@@ -2,20 +2,74 @@
 
 #include <memory>
 
+#include "BufferPool.h"
+
 class DebugLog;
 
-template <class T>
+// How ExpandIfNeeded() resizes the storage. The default keeps the original behavior:
+// grow exactly to the requested size, drop the contents and never shrink.
+struct BufferGrowthPolicy
+{
+    float growthFactor = 1.f;
+    float lowWaterRatio = 0.f;
+    UINT shrinkAfterCalls = 0;
+    bool preserveContents = false;
+};
+
+struct BufferStats
+{
+    UINT64 allocations = 0;
+    UINT64 shrinks = 0;
+    UINT64 inPlaceGrowths = 0;
+    UINT64 preservedBytes = 0;
+    UINT64 currentBytes = 0;
+    UINT64 peakBytes = 0;
+};
+
+// Alignment applies to the start of the storage, so pixel kernels can use aligned loads.
+template <class T, size_t Alignment = BufferPool::kDefaultAlignment>
 class Buffer
 {
+    static_assert((Alignment & (Alignment - 1)) == 0, "Alignment must be a power of two.");
+    static_assert(Alignment >= alignof(T), "Alignment must not be smaller than alignof(T).");
+
 public:
+    static constexpr size_t kAlignment = Alignment;
+
     Buffer() = default;
-    ~Buffer() = default;
+
+    ~Buffer()
+    {
+        Reset();
+    }
 
     explicit Buffer(UINT size)
     {
         ExpandIfNeeded(size);
     }
 
+    Buffer(const Buffer&) = delete;
+    Buffer& operator=(const Buffer&) = delete;
+
+    Buffer(Buffer&& other) noexcept
+    {
+        *this = std::move(other);
+    }
+
+    Buffer& operator=(Buffer&& other) noexcept
+    {
+        if (this != &other)
+        {
+            Reset();
+            std::swap(block_, other.block_);
+            std::swap(size_, other.size_);
+            std::swap(policy_, other.policy_);
+            std::swap(stats_, other.stats_);
+            std::swap(callsBelowLowWater_, other.callsBelowLowWater_);
+        }
+        return *this;
+    }
+
     bool Empty() const
     {
         return size_ == 0;
@@ -23,27 +77,60 @@ public:
 
     void ExpandIfNeeded(UINT size)
     {
-        if (size > size_)
+        const size_t bytes = sizeof(T) * size;
+
+        if (size <= size_)
+        {
+            ShrinkIfIdle(size);
+            return;
+        }
+
+        callsBelowLowWater_ = 0;
+
+        // The pooled block is rounded up to its size class, so small growth reuses it.
+        if (bytes <= block_.capacity)
         {
             size_ = size;
-            value_ = std::make_unique<T[]>(size);
+            ++stats_.inPlaceGrowths;
+            return;
         }
+
+        const auto grownBytes = static_cast<size_t>(block_.capacity * policy_.growthFactor);
+        Reallocate(size, grownBytes > bytes ? grownBytes : bytes);
+    }
+
+    void SetGrowthPolicy(const BufferGrowthPolicy& policy)
+    {
+        policy_ = policy;
+    }
+
+    const BufferGrowthPolicy& GetGrowthPolicy() const
+    {
+        return policy_;
+    }
+
+    const BufferStats& GetStats() const
+    {
+        return stats_;
     }
 
     void Clear()
     {
-        ZeroMemory(value_.get(), size_);
+        ZeroMemory(Get(), size_);
     }
 
     void Clear(int value)
     {
-        memset(value_.get(), value, sizeof(T) * size_);
+        memset(Get(), value, sizeof(T) * size_);
     }
 
     void Reset()
     {
-        value_.reset();
+        BufferPool::Free(block_);
+        block_ = BufferPool::Block();
         size_ = 0;
+        callsBelowLowWater_ = 0;
+        stats_.currentBytes = 0;
     }
 
     UINT Size() const
@@ -51,14 +138,19 @@ public:
         return size_;
     }
 
+    size_t Capacity() const
+    {
+        return block_.capacity / sizeof(T);
+    }
+
     T* Get() const
     {
-        return value_.get();
+        return static_cast<T*>(block_.ptr);
     }
 
     T* Get(UINT offset) const
     {
-        return (value_.get() + offset);
+        return (Get() + offset);
     }
 
     template <class U>
@@ -75,7 +167,7 @@ public:
 
     operator bool() const
     {
-        return value_ != nullptr;
+        return block_.ptr != nullptr;
     }
 
     const T& operator [](UINT index) const
@@ -83,9 +175,9 @@ public:
         if (index >= size_)
         {
             DebugLog::Error("Array index out of range: ", index, size_);
-            return value_[0];
+            return Get()[0];
         }
-        return value_[index];
+        return Get()[index];
     }
 
     T& operator [](UINT index)
@@ -93,12 +185,69 @@ public:
         if (index >= size_)
         {
             DebugLog::Error("Array index out of range: ", index, size_);
-            return value_[0];
+            return Get()[0];
         }
-        return value_[index];
+        return Get()[index];
     }
 
 private:
-    std::unique_ptr<T[]> value_;
+    void ShrinkIfIdle(UINT size)
+    {
+        if (policy_.shrinkAfterCalls == 0 || block_.capacity == 0) return;
+
+        const auto lowWater = static_cast<size_t>(block_.capacity * policy_.lowWaterRatio);
+        if (sizeof(T) * size >= lowWater)
+        {
+            callsBelowLowWater_ = 0;
+            return;
+        }
+
+        if (++callsBelowLowWater_ < policy_.shrinkAfterCalls) return;
+
+        callsBelowLowWater_ = 0;
+        if (BufferPool::GetBlockCapacity(sizeof(T) * size) >= block_.capacity) return;
+
+        ++stats_.shrinks;
+        Reallocate(size, sizeof(T) * size);
+    }
+
+    void Reallocate(UINT size, size_t bytes)
+    {
+        // Release the old block first unless its contents have to be carried over.
+        if (!policy_.preserveContents)
+        {
+            Reset();
+        }
+
+        auto block = BufferPool::Allocate(bytes, Alignment);
+        if (!block.ptr)
+        {
+            Reset();
+            return;
+        }
+
+        size_t preserved = 0;
+        if (block_.ptr)
+        {
+            const size_t oldBytes = sizeof(T) * size_;
+            preserved = oldBytes < block.capacity ? oldBytes : block.capacity;
+            memcpy(block.ptr, block_.ptr, preserved);
+            BufferPool::Free(block_);
+        }
+        ZeroMemory(static_cast<BYTE*>(block.ptr) + preserved, block.capacity - preserved);
+
+        block_ = block;
+        size_ = size;
+
+        ++stats_.allocations;
+        stats_.preservedBytes += preserved;
+        stats_.currentBytes = block_.capacity;
+        if (stats_.currentBytes > stats_.peakBytes) stats_.peakBytes = stats_.currentBytes;
+    }
+
+    BufferPool::Block block_;
     UINT size_ = 0;
+    BufferGrowthPolicy policy_;
+    BufferStats stats_;
+    UINT callsBelowLowWater_ = 0;
 };
\ No newline at end of file
@@ -0,0 +1,342 @@
+#include "pch.h"
+#include <malloc.h>
+#include "BufferPool.h"
+
+SINGLETON_INSTANCE(BufferPool)
+
+
+int BufferPool::GetSizeClass(size_t size)
+{
+    constexpr size_t minSize = static_cast<size_t>(1) << kMinClassShift;
+    if (size <= minSize) return 0;
+
+    int shift = kMinClassShift;
+    while ((static_cast<size_t>(1) << (shift + 1)) <= size) ++shift;
+
+    // Each power of two is split into 4 classes so that the waste is at most 25%.
+    const size_t base = static_cast<size_t>(1) << shift;
+    const size_t step = base / kSubClassCount;
+    const int sub = static_cast<int>((size - base + step - 1) / step);
+
+    return (shift - kMinClassShift) * kSubClassCount + sub;
+}
+
+
+size_t BufferPool::GetClassSize(int sizeClass)
+{
+    const int shift = kMinClassShift + sizeClass / kSubClassCount;
+    const int sub = sizeClass % kSubClassCount;
+    const size_t base = static_cast<size_t>(1) << shift;
+    return base + sub * (base / kSubClassCount);
+}
+
+
+size_t BufferPool::GetBlockCapacity(size_t size)
+{
+    return GetClassSize(GetSizeClass(size));
+}
+
+
+bool BufferPool::EnableLockMemoryPrivilege()
+{
+    HANDLE token = nullptr;
+    if (!::OpenProcessToken(::GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token))
+    {
+        OutputApiError(__FUNCTION__, "OpenProcessToken");
+        return false;
+    }
+    const auto tokenReleaser = MakeScopedReleaser([&] { ::CloseHandle(token); });
+
+    TOKEN_PRIVILEGES privileges {};
+    privileges.PrivilegeCount = 1;
+    privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+    if (!::LookupPrivilegeValue(nullptr, SE_LOCK_MEMORY_NAME, &privileges.Privileges[0].Luid))
+    {
+        OutputApiError(__FUNCTION__, "LookupPrivilegeValue");
+        return false;
+    }
+
+    // AdjustTokenPrivileges() succeeds even if the privilege is not held, so check the last error too.
+    if (!::AdjustTokenPrivileges(token, FALSE, &privileges, 0, nullptr, nullptr) ||
+        ::GetLastError() != ERROR_SUCCESS)
+    {
+        OutputApiError(__FUNCTION__, "AdjustTokenPrivileges");
+        return false;
+    }
+
+    return true;
+}
+
+
+BufferPool::Block BufferPool::AllocateBlock(size_t capacity, size_t alignment, bool useLargePage)
+{
+    Block block;
+    block.capacity = capacity;
+
+    // VirtualAlloc() returns page aligned memory, which covers any alignment Buffer<T> asks for.
+    if (useLargePage && alignment <= 4096)
+    {
+        const size_t pageSize = ::GetLargePageMinimum();
+        if (pageSize > 0)
+        {
+            const size_t size = (capacity + pageSize - 1) / pageSize * pageSize;
+            block.ptr = ::VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+            if (block.ptr)
+            {
+                block.kind = BlockKind::LargePage;
+                return block;
+            }
+        }
+
+        // Large pages are unavailable or fragmented, so fall back to regular pages.
+        block.ptr = ::VirtualAlloc(nullptr, capacity, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+        if (block.ptr)
+        {
+            block.kind = BlockKind::VirtualMemory;
+            return block;
+        }
+    }
+
+    block.ptr = ::_aligned_malloc(capacity, alignment);
+    block.kind = block.ptr ? BlockKind::Heap : BlockKind::None;
+    return block;
+}
+
+
+void BufferPool::FreeBlock(const Block& block)
+{
+    switch (block.kind)
+    {
+        case BlockKind::Heap:
+        {
+            ::_aligned_free(block.ptr);
+            break;
+        }
+        case BlockKind::VirtualMemory:
+        case BlockKind::LargePage:
+        {
+            if (!::VirtualFree(block.ptr, 0, MEM_RELEASE)) OutputApiError(__FUNCTION__, "VirtualFree");
+            break;
+        }
+        default:
+        {
+            break;
+        }
+    }
+}
+
+
+BufferPool::Block BufferPool::Allocate(size_t size, size_t alignment)
+{
+    if (size == 0) return Block();
+
+    if (alignment < kDefaultAlignment) alignment = kDefaultAlignment;
+
+    const int sizeClass = GetSizeClass(size);
+    const size_t capacity = GetClassSize(sizeClass);
+
+    if (IsNull())
+    {
+        return AllocateBlock(capacity, alignment, false);
+    }
+
+    auto& pool = Get();
+
+    Block block;
+    if (!pool.Pop(sizeClass, alignment, &block))
+    {
+        block = AllocateBlock(capacity, alignment, pool.ShouldUseLargePage(capacity));
+    }
+
+    if (block.ptr)
+    {
+        pool.usedBytes_ += block.capacity;
+    }
+
+    return block;
+}
+
+
+void BufferPool::Free(const Block& block)
+{
+    if (!block.ptr) return;
+
+    if (!IsNull())
+    {
+        auto& pool = Get();
+
+        // Blocks allocated before the pool was created were never counted.
+        UINT64 used = pool.usedBytes_;
+        while (!pool.usedBytes_.compare_exchange_weak(used, used >= block.capacity ? used - block.capacity : 0));
+
+        if (pool.Push(GetSizeClass(block.capacity), block))
+        {
+            return;
+        }
+    }
+
+    FreeBlock(block);
+}
+
+
+bool BufferPool::Pop(int sizeClass, size_t alignment, Block* block)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        auto& list = freeLists_[sizeClass];
+        for (auto it = list.rbegin(); it != list.rend(); ++it)
+        {
+            if (reinterpret_cast<uintptr_t>(it->ptr) % alignment != 0) continue;
+
+            *block = *it;
+            list.erase(std::next(it).base());
+            cachedBytes_ -= block->capacity;
+            ++hitCount_;
+            return true;
+        }
+    }
+
+    ++missCount_;
+    return false;
+}
+
+
+bool BufferPool::Push(int sizeClass, const Block& block)
+{
+    // Checked under the lock, otherwise concurrent pushes could all pass and overshoot the limit.
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (cachedBytes_ + block.capacity > maxCachedBytes_) return false;
+
+    freeLists_[sizeClass].push_back(block);
+    cachedBytes_ += block.capacity;
+
+    return true;
+}
+
+
+bool BufferPool::ShouldUseLargePage(size_t capacity) const
+{
+    return largePageEnabled_ && capacity >= largePageThreshold_;
+}
+
+
+void BufferPool::Trim()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    for (auto& list : freeLists_)
+    {
+        for (const auto& block : list)
+        {
+            FreeBlock(block);
+        }
+        // Keep the capacity of the list itself so that later pushes do not allocate.
+        list.clear();
+    }
+
+    cachedBytes_ = 0;
+}
+
+
+void BufferPool::SetMaxCachedBytes(UINT64 bytes)
+{
+    maxCachedBytes_ = bytes;
+    if (cachedBytes_ > bytes) Trim();
+}
+
+
+UINT64 BufferPool::GetMaxCachedBytes() const
+{
+    return maxCachedBytes_;
+}
+
+
+UINT64 BufferPool::GetCachedBytes() const
+{
+    return cachedBytes_;
+}
+
+
+UINT64 BufferPool::GetHitCount() const
+{
+    return hitCount_;
+}
+
+
+UINT64 BufferPool::GetMissCount() const
+{
+    return missCount_;
+}
+
+
+UINT64 BufferPool::GetUsedBytes() const
+{
+    return usedBytes_;
+}
+
+
+UINT64 BufferPool::GetTotalBytes() const
+{
+    return usedBytes_ + cachedBytes_;
+}
+
+
+void BufferPool::SetBudgetBytes(UINT64 bytes)
+{
+    budgetBytes_ = bytes;
+}
+
+
+UINT64 BufferPool::GetBudgetBytes() const
+{
+    return budgetBytes_;
+}
+
+
+bool BufferPool::IsOverBudget() const
+{
+    const UINT64 budget = budgetBytes_;
+    return budget > 0 && GetTotalBytes() > budget;
+}
+
+
+bool BufferPool::SetLargePageEnabled(bool enabled)
+{
+    if (!enabled)
+    {
+        largePageEnabled_ = false;
+        return true;
+    }
+
+    if (largePageEnabled_) return true;
+
+    // Without the privilege every large page allocation would fail and fall back anyway, so keep
+    // the flag off and let the caller know.
+    if (!EnableLockMemoryPrivilege() || ::GetLargePageMinimum() == 0)
+    {
+        DebugLog::Error(__FUNCTION__, " => Large pages are not available, regular pages are used instead.");
+        return false;
+    }
+
+    largePageEnabled_ = true;
+    return true;
+}
+
+
+bool BufferPool::IsLargePageEnabled() const
+{
+    return largePageEnabled_;
+}
+
+
+void BufferPool::SetLargePageThreshold(UINT64 bytes)
+{
+    largePageThreshold_ = bytes;
+}
+
+
+UINT64 BufferPool::GetLargePageThreshold() const
+{
+    return largePageThreshold_;
+}
\ No newline at end of file
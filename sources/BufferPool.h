@@ -0,0 +1,84 @@
+#pragma once
+
+#include <Windows.h>
+#include <vector>
+#include <mutex>
+#include <atomic>
+
+#include "Singleton.h"
+
+// Size-class pool that recycles pixel buffer blocks across captures and windows.
+// Buffer<T> allocates through the static functions, which fall back to the global heap
+// when the pool has not been created (or has already been destroyed).
+class BufferPool
+{
+    SINGLETON(BufferPool)
+public:
+    static constexpr size_t kDefaultAlignment = 64;
+
+    enum class BlockKind
+    {
+        None = 0,
+        Heap = 1,
+        VirtualMemory = 2,
+        LargePage = 3,
+    };
+
+    struct Block
+    {
+        void* ptr = nullptr;
+        size_t capacity = 0;
+        BlockKind kind = BlockKind::None;
+    };
+
+    static Block Allocate(size_t size, size_t alignment = kDefaultAlignment);
+    static void Free(const Block& block);
+    static size_t GetBlockCapacity(size_t size);
+
+    void Trim();
+    void SetMaxCachedBytes(UINT64 bytes);
+    UINT64 GetMaxCachedBytes() const;
+    UINT64 GetCachedBytes() const;
+    UINT64 GetHitCount() const;
+    UINT64 GetMissCount() const;
+
+    // Process-wide accounting of every pixel buffer, in use or cached. A budget of 0 means unlimited.
+    UINT64 GetUsedBytes() const;
+    UINT64 GetTotalBytes() const;
+    void SetBudgetBytes(UINT64 bytes);
+    UINT64 GetBudgetBytes() const;
+    bool IsOverBudget() const;
+
+    // Blocks at or above the threshold are backed by large pages when enabled.
+    // Returns false and stays on regular pages if the process lacks SeLockMemoryPrivilege.
+    bool SetLargePageEnabled(bool enabled);
+    bool IsLargePageEnabled() const;
+    void SetLargePageThreshold(UINT64 bytes);
+    UINT64 GetLargePageThreshold() const;
+
+private:
+    static constexpr int kMinClassShift = 8;
+    static constexpr int kSubClassCount = 4;
+    static constexpr int kClassCount = (sizeof(size_t) * 8 - kMinClassShift) * kSubClassCount;
+
+    static int GetSizeClass(size_t size);
+    static size_t GetClassSize(int sizeClass);
+    static Block AllocateBlock(size_t capacity, size_t alignment, bool useLargePage);
+    static void FreeBlock(const Block& block);
+    static bool EnableLockMemoryPrivilege();
+
+    bool Pop(int sizeClass, size_t alignment, Block* block);
+    bool Push(int sizeClass, const Block& block);
+    bool ShouldUseLargePage(size_t capacity) const;
+
+    std::vector<Block> freeLists_[kClassCount];
+    mutable std::mutex mutex_;
+    std::atomic<UINT64> maxCachedBytes_ = 512ull * 1024 * 1024;
+    std::atomic<UINT64> cachedBytes_ = 0;
+    std::atomic<UINT64> usedBytes_ = 0;
+    std::atomic<UINT64> budgetBytes_ = 0;
+    std::atomic<UINT64> hitCount_ = 0;
+    std::atomic<UINT64> missCount_ = 0;
+    std::atomic<bool> largePageEnabled_ = false;
+    std::atomic<UINT64> largePageThreshold_ = 8ull * 1024 * 1024;
+};
\ No newline at end of file
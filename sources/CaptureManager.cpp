@@ -42,7 +42,7 @@ CaptureManager::CaptureManager()
         {
             if (auto window = WindowManager::Get().GetWindow(id))
             {
-                window->Capture();
+                window->Capture(GetCaptureRateSettings());
             }
         }
     }, std::chrono::microseconds(kLoopMinTime));
@@ -93,4 +93,18 @@ void CaptureManager::RequestCapture(int id, CapturePriority priority)
 void CaptureManager::RequestCaptureIcon(int id)
 {
     iconQueue_.Enqueue(id);
+}
+
+
+void CaptureManager::SetCaptureRateSettings(const CaptureRateSettings& settings)
+{
+    std::lock_guard<std::mutex> lock(rateSettingsMutex_);
+    rateSettings_ = settings;
+}
+
+
+CaptureRateSettings CaptureManager::GetCaptureRateSettings() const
+{
+    std::lock_guard<std::mutex> lock(rateSettingsMutex_);
+    return rateSettings_;
 }
\ No newline at end of file
@@ -4,6 +4,7 @@
 #include <deque>
 #include <mutex>
 
+#include "CaptureRate.h"
 #include "WindowQueue.h"
 #include "Thread.h"
 
@@ -23,6 +24,10 @@ public:
     void RequestCapture(int id, CapturePriority priority);
     void RequestCaptureIcon(int id);
 
+    // Requests for a window that has not changed lately are dropped according to these.
+    void SetCaptureRateSettings(const CaptureRateSettings& settings);
+    CaptureRateSettings GetCaptureRateSettings() const;
+
 private:
     ThreadLoop windowCaptureThreadLoop_;
     ThreadLoop iconCaptureThreadLoop_;
@@ -30,4 +35,6 @@ private:
     WindowQueue middlePriorityQueue_;
     WindowQueue lowPriorityQueue_;
     WindowQueue iconQueue_;
+    CaptureRateSettings rateSettings_;
+    mutable std::mutex rateSettingsMutex_;
 };
\ No newline at end of file
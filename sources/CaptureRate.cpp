@@ -0,0 +1,120 @@
+#include "pch.h"
+#include <algorithm>
+#include <chrono>
+#include "CaptureRate.h"
+
+namespace
+{
+    // A still window goes from 60 Hz to 1 Hz in about ten captures, or three seconds.
+    constexpr double kBackoffFactor = 1.5;
+
+    // Requests come once per engine frame with some jitter, so a slightly early one is still due.
+    constexpr double kDueTolerance = 0.75;
+
+    // Weight of the latest interval in the smoothed intervals.
+    constexpr double kSmoothing = 0.125;
+
+    constexpr double kMicrosecondsPerSecond = 1000000.0;
+
+    double GetInterval(float rate)
+    {
+        return rate > 0.f ? kMicrosecondsPerSecond / rate : 0.0;
+    }
+
+    float GetRate(double interval)
+    {
+        return interval > 0.0 ? static_cast<float>(kMicrosecondsPerSecond / interval) : 0.f;
+    }
+
+    double Smooth(double average, double value, bool hasAverage)
+    {
+        return hasAverage ? average + (value - average) * kSmoothing : value;
+    }
+}
+
+
+UINT64 CaptureRateController::GetTime()
+{
+    const auto now = std::chrono::steady_clock::now().time_since_epoch();
+    return std::chrono::duration_cast<std::chrono::microseconds>(now).count();
+}
+
+
+bool CaptureRateController::IsDue(const CaptureRateSettings& settings, UINT64 now) const
+{
+    if (!settings.adaptive) return true;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stats_.capturedFrames == 0) return true;
+
+    return static_cast<double>(now - lastCaptureTime_) >= static_cast<double>(interval_) * kDueTolerance;
+}
+
+
+void CaptureRateController::OnCaptured(const CaptureRateSettings& settings, UINT64 now, bool changed)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (stats_.capturedFrames > 0)
+    {
+        captureInterval_ = Smooth(captureInterval_, static_cast<double>(now - lastCaptureTime_), stats_.capturedFrames > 1);
+    }
+    lastCaptureTime_ = now;
+    ++stats_.capturedFrames;
+
+    if (changed)
+    {
+        if (stats_.changedFrames > 0)
+        {
+            changeInterval_ = Smooth(changeInterval_, static_cast<double>(now - lastChangeTime_), stats_.changedFrames > 1);
+        }
+        lastChangeTime_ = now;
+        ++stats_.changedFrames;
+    }
+
+    if (!settings.adaptive)
+    {
+        interval_ = 0;
+        return;
+    }
+
+    const double minInterval = GetInterval(settings.maxRate);
+    const double maxInterval = std::max<double>(minInterval, GetInterval(settings.minRate));
+    if (changed)
+    {
+        interval_ = static_cast<UINT64>(minInterval);
+    }
+    else
+    {
+        // Without a maximum rate, the back-off starts from the rate of the requests.
+        const double interval = std::max<double>(static_cast<double>(interval_), std::max<double>(minInterval, captureInterval_));
+        interval_ = static_cast<UINT64>(std::min<double>(interval * kBackoffFactor, maxInterval));
+    }
+}
+
+
+void CaptureRateController::OnSkipped()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++stats_.skippedRequests;
+}
+
+
+CaptureRateStats CaptureRateController::GetStats(UINT64 now) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    // The rates fall off as the time since the last capture or change grows, so that a window
+    // that stopped changing, or stopped being requested, does not keep its old rates.
+    CaptureRateStats stats = stats_;
+    if (stats_.capturedFrames > 0)
+    {
+        stats.effectiveRate = GetRate(std::max<double>(captureInterval_, static_cast<double>(now - lastCaptureTime_)));
+    }
+    if (stats_.changedFrames > 0)
+    {
+        stats.observedRate = GetRate(std::max<double>(changeInterval_, static_cast<double>(now - lastChangeTime_)));
+    }
+    stats.targetRate = GetRate(static_cast<double>(interval_));
+    return stats;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <Windows.h>
+#include <mutex>
+
+// Bounds of the adaptive capture rate, shared by all windows. Rates are per second.
+struct CaptureRateSettings
+{
+    // Without adaptation, every requested capture runs.
+    bool adaptive = true;
+    // A window that stays the same backs off to minRate, and one that changes is captured at
+    // up to maxRate, or at every request if maxRate is 0.
+    float minRate = 1.f;
+    float maxRate = 60.f;
+};
+
+
+struct CaptureRateStats
+{
+    // How often the captured frames changed. It cannot exceed the effective rate.
+    float observedRate = 0.f;
+    // How often the window was actually captured.
+    float effectiveRate = 0.f;
+    // The rate the window is held to now, or 0 if every request is captured.
+    float targetRate = 0.f;
+    UINT64 capturedFrames = 0;
+    UINT64 changedFrames = 0;
+    // Requests dropped because the window was not due.
+    UINT64 skippedRequests = 0;
+};
+
+
+// Learns how often a window changes from the outcome of its captures. Each capture without
+// a change spaces the next one further apart, down to the minimum rate, and a change brings
+// the window back to the maximum rate at once. Times are microseconds of GetTime().
+class CaptureRateController
+{
+public:
+    static UINT64 GetTime();
+
+    bool IsDue(const CaptureRateSettings& settings, UINT64 now) const;
+    void OnCaptured(const CaptureRateSettings& settings, UINT64 now, bool changed);
+    void OnSkipped();
+
+    CaptureRateStats GetStats(UINT64 now) const;
+
+private:
+    mutable std::mutex mutex_;
+    // Spacing of captures that IsDue() asks for.
+    UINT64 interval_ = 0;
+    UINT64 lastCaptureTime_ = 0;
+    UINT64 lastChangeTime_ = 0;
+    // Smoothed time between captures and between changes.
+    double captureInterval_ = 0.0;
+    double changeInterval_ = 0.0;
+    CaptureRateStats stats_;
+};
@@ -1,5 +1,6 @@
 #include "pch.h"
 #include "Cursor.h"
+#include "Image.h"
 #include "WindowManager.h"
 #include "Unity.h"
 #include "Unreal.h"
@@ -93,6 +94,32 @@ ID3D11Texture2D* Cursor::GetUnityTexturePtr() const
 }
 
 
+void Cursor::SetCaptureMode(CursorCaptureMode mode)
+{
+    captureMode_ = mode;
+}
+
+
+CursorCaptureMode Cursor::GetCaptureMode() const
+{
+    return captureMode_;
+}
+
+
+void Cursor::SetAlphaMode(AlphaMode mode)
+{
+    // The alpha of a cursor is always meaningful.
+    if (mode == AlphaMode::Ignore) mode = AlphaMode::Straight;
+    alphaMode_ = mode;
+}
+
+
+AlphaMode Cursor::GetAlphaMode() const
+{
+    return alphaMode_;
+}
+
+
 bool Cursor::Capture()
 {
     std::lock_guard<std::mutex> lock(cursorMutex_);
@@ -124,7 +151,7 @@ bool Cursor::Capture()
         OutputApiError(__FUNCTION__, "GetIconInfo");
         return false;
     }
-    ScopedReleaser iconReleaser([&] 
+    const auto iconReleaser = MakeScopedReleaser([&] 
     { 
         if (iconInfo.hbmColor) ::DeleteObject(iconInfo.hbmColor); 
         if (iconInfo.hbmMask) ::DeleteObject(iconInfo.hbmMask); 
@@ -160,11 +187,29 @@ bool Cursor::Capture()
         }
     }
 
+    const bool result = (captureMode_ == CursorCaptureMode::Bitmap) ?
+        CaptureFromBitmaps(iconInfo, width, height) :
+        CaptureFromDesktop(cursorInfo, iconInfo, width, height);
+    if (!result) return false;
+
+    {
+        std::lock_guard<std::mutex> lock(bufferMutex_);
+        ConvertAlphaMode(ImageView<PixelFormatBGRA8>(buffer_.Get(), width_, height_), AlphaMode::Straight, alphaMode_);
+    }
+
+    hasCaptured_ = true;
+
+    return true;
+}
+
+
+bool Cursor::CaptureFromDesktop(const CURSORINFO& cursorInfo, const ICONINFO& iconInfo, UINT width, UINT height)
+{
     auto desktopDc = ::GetDC(GetDesktopWindow());
-    ScopedReleaser hDcReleaser([&] { ::DeleteDC(desktopDc); });
+    const auto hDcReleaser = MakeScopedReleaser([&] { ::DeleteDC(desktopDc); });
 
     auto hDcMem = ::CreateCompatibleDC(NULL);
-    ScopedReleaser hDcMemReleaser([&] { ::DeleteDC(hDcMem); });
+    const auto hDcMemReleaser = MakeScopedReleaser([&] { ::DeleteDC(hDcMem); });
 
     CreateBitmapIfNeeded(desktopDc, width, height);
 
@@ -177,16 +222,16 @@ bool Cursor::Capture()
     bmi.biCompression = BI_RGB;
     bmi.biSizeImage   = 0;
 
-    Buffer<BYTE> desktop(width_ * height_ * 4);
-    Buffer<BYTE> desktopWithIcon(width_ * height_ * 4);
-    Buffer<BYTE> icon(width_ * height_ * 4);
+    Image<PixelFormatBGRA8> desktop(width_, height_);
+    Image<PixelFormatBGRA8> desktopWithIcon(width_, height_);
+    Image<PixelFormatBGRA8> icon(width_, height_);
 
     HGDIOBJ preObject = ::SelectObject(hDcMem, bitmap_);
     {
         // BitBlt desktop image
         ::BitBlt(hDcMem, 0, 0, width_, height_, desktopDc, x_ - iconInfo.xHotspot, y_ - iconInfo.yHotspot, SRCCOPY);
 
-        if (!::GetDIBits(hDcMem, bitmap_, 0, height_, desktop.Get(), reinterpret_cast<BITMAPINFO*>(&bmi), DIB_RGB_COLORS))
+        if (!::GetDIBits(hDcMem, bitmap_, 0, height_, desktop.GetData(), reinterpret_cast<BITMAPINFO*>(&bmi), DIB_RGB_COLORS))
         {
             OutputApiError(__FUNCTION__, "GetDIBits");
         }
@@ -197,13 +242,13 @@ bool Cursor::Capture()
             OutputApiError(__FUNCTION__, "DrawIcon");
         }
 
-        if (!::GetDIBits(hDcMem, bitmap_, 0, height_, desktopWithIcon.Get(), reinterpret_cast<BITMAPINFO*>(&bmi), DIB_RGB_COLORS))
+        if (!::GetDIBits(hDcMem, bitmap_, 0, height_, desktopWithIcon.GetData(), reinterpret_cast<BITMAPINFO*>(&bmi), DIB_RGB_COLORS))
         {
             OutputApiError(__FUNCTION__, "GetDIBits");
         }
 
         // Icon only
-        if (!::GetDIBits(hDcMem, iconInfo.hbmColor, 0, height_, icon.Get(), reinterpret_cast<BITMAPINFO*>(&bmi), DIB_RGB_COLORS))
+        if (!::GetDIBits(hDcMem, iconInfo.hbmColor, 0, height_, icon.GetData(), reinterpret_cast<BITMAPINFO*>(&bmi), DIB_RGB_COLORS))
         {
             OutputApiError(__FUNCTION__, "GetDIBits");
         }
@@ -213,38 +258,89 @@ bool Cursor::Capture()
     {
         std::lock_guard<std::mutex> lock(bufferMutex_);
 
-        auto buffer32 = buffer_.As<UINT>();
-        const auto desktop32 = desktop.As<UINT>();
-        const auto desktopWithIcon32 = desktopWithIcon.As<UINT>();
-        const auto icon32 = icon.As<UINT>();
+        const ImageView<PixelFormatBGRA8> output(buffer_.Get(), width_, height_);
+        const auto desktopView = desktop.GetView().FlipVertical();
+        const auto desktopWithIconView = desktopWithIcon.GetView().FlipVertical();
+        const auto iconView = icon.GetView().FlipVertical();
+
+        for (UINT y = 0; y < height_; ++y)
+        {
+            PixelKernels::CompositeCursor(desktopView.GetRow(y), desktopWithIconView.GetRow(y), iconView.GetRow(y), output.GetRow(y), width_);
+        }
+    }
+
+    return true;
+}
+
+
+bool Cursor::CaptureFromBitmaps(const ICONINFO& iconInfo, UINT width, UINT height)
+{
+    ResizeBuffer(width, height);
+
+    auto hDcMem = ::CreateCompatibleDC(NULL);
+    const auto hDcMemReleaser = MakeScopedReleaser([&] { ::DeleteDC(hDcMem); });
+
+    BITMAPINFOHEADER bmi {};
+    bmi.biWidth       = static_cast<LONG>(width);
+    bmi.biHeight      = -static_cast<LONG>(height);
+    bmi.biPlanes      = 1;
+    bmi.biSize        = sizeof(BITMAPINFOHEADER);
+    bmi.biBitCount    = 32;
+    bmi.biCompression = BI_RGB;
+    bmi.biSizeImage   = 0;
+
+    // Monochrome cursors have no color bitmap; their mask holds the AND mask on top of the XOR mask.
+    const bool isMonochrome = iconInfo.hbmColor == nullptr;
+
+    Image<PixelFormatBGRA8> color;
+    bool hasAlpha = false;
+    if (!isMonochrome)
+    {
+        color.Create(width, height);
+        if (!::GetDIBits(hDcMem, iconInfo.hbmColor, 0, height, color.GetData(), reinterpret_cast<BITMAPINFO*>(&bmi), DIB_RGB_COLORS))
+        {
+            OutputApiError(__FUNCTION__, "GetDIBits");
+            return false;
+        }
+        hasAlpha = PixelKernels::HasAlpha(color.GetData(), width * height);
+    }
+
+    Image<PixelFormatBGRA8> mask;
+    if (!hasAlpha)
+    {
+        const UINT maskHeight = isMonochrome ? height * 2 : height;
+        bmi.biHeight = -static_cast<LONG>(maskHeight);
+        mask.Create(width, maskHeight);
+        if (!::GetDIBits(hDcMem, iconInfo.hbmMask, 0, maskHeight, mask.GetData(), reinterpret_cast<BITMAPINFO*>(&bmi), DIB_RGB_COLORS))
+        {
+            OutputApiError(__FUNCTION__, "GetDIBits");
+            return false;
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(bufferMutex_);
+
+        const ImageView<PixelFormatBGRA8> output(buffer_.Get(), width, height);
 
-        const auto n = width_ * height_;
-        for (UINT x = 0; x < width_; ++x) 
+        if (hasAlpha)
+        {
+            ConvertPixels(color.GetView().FlipVertical(), output);
+        }
+        else
         {
-            for (UINT y = 0; y < height_; ++y)
+            const auto maskView = mask.GetView().Crop(0, 0, width, height).FlipVertical();
+            const auto colorView = isMonochrome ?
+                mask.GetView().Crop(0, height, width, height).FlipVertical() :
+                color.GetView().FlipVertical();
+
+            for (UINT y = 0; y < height; ++y)
             {
-                const auto i = y * width_ + x;
-                const auto j = (height_ - 1 - y) * width_ + x;
-
-                if (icon[4 * j + 3] > 0)
-                {
-                    buffer32[i] = icon32[j];
-                }
-                else
-                {
-                    buffer_[4 * i + 0] = desktopWithIcon[4 * j + 0];
-                    buffer_[4 * i + 1] = desktopWithIcon[4 * j + 1];
-                    buffer_[4 * i + 2] = desktopWithIcon[4 * j + 2];
-
-                    desktop[4 * j + 3] = desktopWithIcon[4 * j + 3] = 0;
-                    buffer_[4 * i + 3] = (desktop32[j] != desktopWithIcon32[j]) ? 255 : 0;
-                }
+                PixelKernels::ApplyCursorMask(colorView.GetRow(y), maskView.GetRow(y), output.GetRow(y), width);
             }
         }
     }
 
-    hasCaptured_ = true;
-
     return true;
 }
 
@@ -341,7 +437,7 @@ bool Cursor::Render()
 }
 
 
-void Cursor::CreateBitmapIfNeeded(HDC hDc, UINT width, UINT height)
+void Cursor::ResizeBuffer(UINT width, UINT height)
 {
     std::lock_guard<std::mutex> lock(bufferMutex_);
 
@@ -351,6 +447,21 @@ void Cursor::CreateBitmapIfNeeded(HDC hDc, UINT width, UINT height)
     height_ = height;
     buffer_.ExpandIfNeeded(width * height * 4);
 
+    // Recreated with the new size by the next desktop capture.
+    DeleteBitmap();
+}
+
+
+void Cursor::CreateBitmapIfNeeded(HDC hDc, UINT width, UINT height)
+{
+    std::lock_guard<std::mutex> lock(bufferMutex_);
+
+    if (width_ == width && height_ == height && bitmap_ != nullptr) return;
+
+    width_ = width;
+    height_ = height;
+    buffer_.ExpandIfNeeded(width * height * 4);
+
     DeleteBitmap();
     bitmap_ = ::CreateCompatibleBitmap(hDc, width, height);
 }
@@ -7,8 +7,18 @@
 #include <atomic>
 
 #include "Buffer.h"
+#include "Image.h"
 #include "Thread.h"
 
+
+enum class CursorCaptureMode
+{
+    // Draws the cursor onto the desktop and recovers its shape from the difference.
+    Desktop = 0,
+    // Renders the cursor from its color and mask bitmaps without reading the desktop.
+    Bitmap = 1,
+};
+
 class Cursor
 {
 public:
@@ -26,6 +36,14 @@ public:
     void SetUnityTexturePtr(ID3D11Texture2D* ptr);
     ID3D11Texture2D* GetUnityTexturePtr() const;
 
+    void SetCaptureMode(CursorCaptureMode mode);
+    CursorCaptureMode GetCaptureMode() const;
+
+    // Alpha mode of the captured cursor image. Every capture mode produces straight alpha,
+    // which is converted once per capture if another mode is set.
+    void SetAlphaMode(AlphaMode mode);
+    AlphaMode GetAlphaMode() const;
+
     void RequestCapture();
     bool Capture();
     bool HasCaptured() const;
@@ -34,6 +52,9 @@ public:
     bool Render();
 
 private:
+    bool CaptureFromDesktop(const CURSORINFO& cursorInfo, const ICONINFO& iconInfo, UINT width, UINT height);
+    bool CaptureFromBitmaps(const ICONINFO& iconInfo, UINT width, UINT height);
+    void ResizeBuffer(UINT width, UINT height);
     void CreateBitmapIfNeeded(HDC hDc, UINT width, UINT height);
     void DeleteBitmap();
 
@@ -53,6 +74,8 @@ private:
     std::atomic<UINT> x_ = 0;
     std::atomic<UINT> y_ = 0;
     std::mutex cursorMutex_;
+    std::atomic<CursorCaptureMode> captureMode_ = CursorCaptureMode::Desktop;
+    std::atomic<AlphaMode> alphaMode_ = AlphaMode::Straight;
 
     std::atomic<bool> isCaptureRequested_ = false;
     std::atomic<bool> hasCaptured_ = false;
@@ -151,14 +151,18 @@ private:
     static std::mutex _mutex;
 };
 
+// Pastes after expanding its arguments, so that __COUNTER__ gives every scope variable its own name.
+#define CONCAT_IMPL(A, B) A##B
+#define CONCAT(A, B) CONCAT_IMPL(A, B)
+
 #ifdef _DEBUG
 #define FUNCTION_SCOPE_TIMER \
-    ScopedTimer _timer_##__COUNTER__([](std::chrono::microseconds us) \
+    const auto CONCAT(_timer_, __COUNTER__) = MakeScopedTimer([](std::chrono::microseconds us) \
     { \
         DebugLog::Log(__FUNCTION__, "@", __FILE__, ":", __LINE__, " => ", us.count(), " [us]"); \
     });
 #define SCOPE_TIMER(Name) \
-    ScopedTimer _timer_##__COUNTER__([](std::chrono::microseconds us) \
+    const auto CONCAT(_timer_, __COUNTER__) = MakeScopedTimer([](std::chrono::microseconds us) \
     { \
         DebugLog::Log(#Name, " => ", us.count(), " [us]"); \
     });
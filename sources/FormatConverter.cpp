@@ -0,0 +1,166 @@
+#include "pch.h"
+#include "FormatConverter.h"
+#include "ImagePipeline.h"
+#include "PixelKernels.h"
+
+namespace
+{
+    // BT.709 coefficients scaled by 256. Luma and chroma are scaled to 219 and 224 levels
+    // (limited range), and the offsets move them to [16, 235] and [16, 240]. The chroma weights
+    // and the full-range gray weights are rounded so that they sum to 0 and 256 respectively.
+    constexpr ColorWeights kLumaWeights = { 16, 157, 47, 16 };
+    constexpr ColorWeights kBlueDifferenceWeights = { 112, -86, -26, 128 };
+    constexpr ColorWeights kRedDifferenceWeights = { -10, -102, 112, 128 };
+    constexpr ColorWeights kGrayWeights = { 19, 183, 54, 0 };
+
+    UINT GetBytesPerPixel(OutputFormat format)
+    {
+        switch (format)
+        {
+            case OutputFormat::BGRA8: return 4;
+            case OutputFormat::RGBA8: return 4;
+            case OutputFormat::RGB565: return 2;
+            case OutputFormat::Gray8: return 1;
+            case OutputFormat::RGBA16F: return 8;
+            default: return 0;
+        }
+    }
+}
+
+
+UINT FormatConverter::GetSize(OutputFormat format, UINT width, UINT height)
+{
+    switch (format)
+    {
+        case OutputFormat::NV12:
+        case OutputFormat::I420:
+        {
+            const UINT chromaWidth = (width + 1) / 2;
+            const UINT chromaHeight = (height + 1) / 2;
+            return width * height + chromaWidth * chromaHeight * 2;
+        }
+        default:
+        {
+            return width * height * GetBytesPerPixel(format);
+        }
+    }
+}
+
+
+bool FormatConverter::Convert(const ConstImageView<PixelFormatBGRA8>& src, OutputFormat format, BYTE* output, UINT outputSize, UINT maxThreadCount, Buffer<BYTE>* scratch)
+{
+    const UINT width = src.GetWidth();
+    const UINT height = src.GetHeight();
+    const UINT size = GetSize(format, width, height);
+    if (src.Empty() || size == 0)
+    {
+        DebugLog::Error(__FUNCTION__, " => The source is empty or the format is unknown: format=", static_cast<int>(format));
+        return false;
+    }
+    if (!output || outputSize < size)
+    {
+        DebugLog::Error(__FUNCTION__, " => The output needs ", size, " bytes but has ", outputSize, ".");
+        return false;
+    }
+
+    if (format == OutputFormat::NV12 || format == OutputFormat::I420)
+    {
+        Buffer<BYTE> localScratch;
+        ConvertYuv420(src, format == OutputFormat::NV12, output, maxThreadCount, scratch ? scratch : &localScratch);
+        return true;
+    }
+
+    const UINT rowBytes = width * GetBytesPerPixel(format);
+    RunRowBands(height, width, maxThreadCount, [&](UINT begin, UINT end)
+    {
+        for (UINT y = begin; y < end; ++y)
+        {
+            const BYTE* in = src.GetRow(y);
+            BYTE* out = output + static_cast<size_t>(y) * rowBytes;
+            switch (format)
+            {
+                case OutputFormat::BGRA8:
+                    ConvertRow<PixelFormatBGRA8, PixelFormatBGRA8>(in, out, width);
+                    break;
+                case OutputFormat::RGBA8:
+                    ConvertRow<PixelFormatBGRA8, PixelFormatRGBA8>(in, out, width);
+                    break;
+                case OutputFormat::RGB565:
+                    PixelKernels::ToRGB565(in, out, width);
+                    break;
+                case OutputFormat::Gray8:
+                    PixelKernels::WeightedSum(in, out, 1, width, kGrayWeights);
+                    break;
+                case OutputFormat::RGBA16F:
+                    PixelKernels::ToRGBA16F(in, out, width);
+                    break;
+                default:
+                    break;
+            }
+        }
+    });
+
+    return true;
+}
+
+
+void FormatConverter::ConvertYuv420(const ConstImageView<PixelFormatBGRA8>& src, bool interleaveChroma, BYTE* output, UINT maxThreadCount, Buffer<BYTE>* scratch)
+{
+    const UINT width = src.GetWidth();
+    const UINT height = src.GetHeight();
+    const UINT chromaWidth = (width + 1) / 2;
+    const UINT chromaHeight = (height + 1) / 2;
+
+    BYTE* const lumaPlane = output;
+    BYTE* const chromaPlane = output + static_cast<size_t>(width) * height;
+    const size_t chromaPlaneSize = static_cast<size_t>(chromaWidth) * chromaHeight;
+
+    // Each band owns pairs of luma rows and the chroma row between them, and a row of averages.
+    const UINT bandCount = GetRowBandCount(chromaHeight, width * 2, maxThreadCount);
+    const UINT averagesSize = chromaWidth * 4;
+    scratch->ExpandIfNeeded(averagesSize * bandCount);
+
+    RunIndexedRowBands(chromaHeight, bandCount, [&](UINT band, UINT begin, UINT end)
+    {
+        BYTE* const averages = scratch->Get() + static_cast<size_t>(band) * averagesSize;
+        for (UINT cy = begin; cy < end; ++cy)
+        {
+            const UINT y0 = cy * 2;
+            const UINT y1 = std::min<UINT>(y0 + 1, height - 1);
+            const BYTE* row0 = src.GetRow(y0);
+            const BYTE* row1 = src.GetRow(y1);
+
+            PixelKernels::WeightedSum(row0, lumaPlane + static_cast<size_t>(y0) * width, 1, width, kLumaWeights);
+            if (y1 != y0)
+            {
+                PixelKernels::WeightedSum(row1, lumaPlane + static_cast<size_t>(y1) * width, 1, width, kLumaWeights);
+            }
+
+            // Average each 2x2 block once and derive both chroma values from it.
+            // A last odd column is averaged with itself.
+            PixelKernels::Downsample2x(row0, row1, averages, width / 2);
+            if (width % 2 != 0)
+            {
+                BYTE last[2][8];
+                memcpy(last[0], row0 + (width - 1) * 4, 4);
+                memcpy(last[0] + 4, row0 + (width - 1) * 4, 4);
+                memcpy(last[1], row1 + (width - 1) * 4, 4);
+                memcpy(last[1] + 4, row1 + (width - 1) * 4, 4);
+                PixelKernels::Downsample2x(last[0], last[1], averages + (chromaWidth - 1) * 4, 1);
+            }
+
+            if (interleaveChroma)
+            {
+                BYTE* uv = chromaPlane + static_cast<size_t>(cy) * chromaWidth * 2;
+                PixelKernels::WeightedSum(averages, uv, 2, chromaWidth, kBlueDifferenceWeights);
+                PixelKernels::WeightedSum(averages, uv + 1, 2, chromaWidth, kRedDifferenceWeights);
+            }
+            else
+            {
+                BYTE* u = chromaPlane + static_cast<size_t>(cy) * chromaWidth;
+                PixelKernels::WeightedSum(averages, u, 1, chromaWidth, kBlueDifferenceWeights);
+                PixelKernels::WeightedSum(averages, u + chromaPlaneSize, 1, chromaWidth, kRedDifferenceWeights);
+            }
+        }
+    });
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <Windows.h>
+
+#include "Buffer.h"
+#include "Image.h"
+
+enum class OutputFormat
+{
+    BGRA8 = 0,
+    RGBA8 = 1,
+    NV12 = 2,
+    I420 = 3,
+    RGB565 = 4,
+    Gray8 = 5,
+    RGBA16F = 6,
+};
+
+
+// Converts BGRA frames to the formats consumers such as video encoders and ML models expect.
+// The output is top-down and tightly packed. NV12 and I420 use limited-range BT.709 with
+// 4:2:0 chroma planes of ((width + 1) / 2) x ((height + 1) / 2) after the luma plane.
+// Gray8 is full-range BT.709 luma.
+class FormatConverter
+{
+public:
+    static constexpr UINT kFormatCount = 7;
+
+    // Returns 0 for an unknown format.
+    static UINT GetSize(OutputFormat format, UINT width, UINT height);
+
+    // NV12 and I420 need a row of 2x2 averages per band; passing a scratch buffer the caller keeps
+    // across frames avoids allocating them on every call.
+    static bool Convert(const ConstImageView<PixelFormatBGRA8>& src, OutputFormat format, BYTE* output, UINT outputSize, UINT maxThreadCount, Buffer<BYTE>* scratch = nullptr);
+
+private:
+    static void ConvertYuv420(const ConstImageView<PixelFormatBGRA8>& src, bool interleaveChroma, BYTE* output, UINT maxThreadCount, Buffer<BYTE>* scratch);
+};
@@ -0,0 +1,192 @@
+#include "pch.h"
+#include "FrameCodec.h"
+
+namespace
+{
+    constexpr BYTE kLiteral = 0x00;
+    constexpr BYTE kRepeat = 0x40;
+    constexpr BYTE kAbove = 0x80;
+    constexpr BYTE kOpMask = 0xC0;
+    constexpr UINT kShortLength = 0x3F;
+    constexpr size_t kMinRun = 2;
+    constexpr size_t kMaxHeaderSize = 6;
+
+    BYTE* WriteHeader(BYTE* out, BYTE op, size_t length)
+    {
+        const auto value = static_cast<UINT>(length - 1);
+        if (value < kShortLength)
+        {
+            *out++ = op | static_cast<BYTE>(value);
+            return out;
+        }
+
+        *out++ = op | kShortLength;
+        UINT rest = value - kShortLength;
+        while (rest >= 0x80)
+        {
+            *out++ = static_cast<BYTE>(rest | 0x80);
+            rest >>= 7;
+        }
+        *out++ = static_cast<BYTE>(rest);
+        return out;
+    }
+
+    const BYTE* ReadHeader(const BYTE* in, const BYTE* end, BYTE* op, size_t* length)
+    {
+        *op = *in & kOpMask;
+        UINT value = *in++ & kShortLength;
+
+        if (value == kShortLength)
+        {
+            UINT rest = 0;
+            for (int shift = 0; ; shift += 7)
+            {
+                if (in >= end || shift > 28) return nullptr;
+                const BYTE b = *in++;
+                rest |= static_cast<UINT>(b & 0x7F) << shift;
+                if (!(b & 0x80)) break;
+            }
+            value += rest;
+        }
+
+        *length = static_cast<size_t>(value) + 1;
+        return in;
+    }
+}
+
+
+size_t FrameCodec::GetMaxEncodedSize(UINT width, UINT height)
+{
+    // The worst case is a literal pixel followed by a 2-pixel run, which never exceeds 5 bytes per pixel.
+    return static_cast<size_t>(width) * height * 5 + kMaxHeaderSize;
+}
+
+
+size_t FrameCodec::Encode(const BYTE* pixels, UINT width, UINT height, BYTE* output, size_t outputSize)
+{
+    if (!pixels || !output || width == 0 || height == 0) return 0;
+
+    const auto* src = reinterpret_cast<const UINT*>(pixels);
+    const size_t count = static_cast<size_t>(width) * height;
+
+    BYTE* out = output;
+    const BYTE* outEnd = output + outputSize;
+    size_t literalStart = 0;
+
+    const auto fits = [&](size_t bytes)
+    {
+        return static_cast<size_t>(outEnd - out) >= kMaxHeaderSize + bytes;
+    };
+
+    const auto flushLiteral = [&](size_t end)
+    {
+        if (end <= literalStart) return true;
+        const size_t length = end - literalStart;
+        if (!fits(length * 4)) return false;
+        out = WriteHeader(out, kLiteral, length);
+        memcpy(out, src + literalStart, length * 4);
+        out += length * 4;
+        return true;
+    };
+
+    size_t i = 0;
+    while (i < count)
+    {
+        size_t above = 0;
+        if (i >= width)
+        {
+            while (i + above < count && src[i + above] == src[i + above - width]) ++above;
+        }
+
+        size_t repeat = 1;
+        while (i + repeat < count && src[i + repeat] == src[i]) ++repeat;
+
+        if (above >= kMinRun && above >= repeat)
+        {
+            if (!flushLiteral(i) || !fits(0)) return 0;
+            out = WriteHeader(out, kAbove, above);
+            i += above;
+            literalStart = i;
+        }
+        else if (repeat >= kMinRun)
+        {
+            if (!flushLiteral(i) || !fits(4)) return 0;
+            out = WriteHeader(out, kRepeat, repeat);
+            memcpy(out, src + i, 4);
+            out += 4;
+            i += repeat;
+            literalStart = i;
+        }
+        else
+        {
+            ++i;
+        }
+    }
+
+    if (!flushLiteral(count)) return 0;
+
+    return static_cast<size_t>(out - output);
+}
+
+
+bool FrameCodec::Decode(const BYTE* input, size_t inputSize, UINT width, UINT height, BYTE* pixels)
+{
+    if (!input || !pixels || width == 0 || height == 0) return false;
+
+    auto* dst = reinterpret_cast<UINT*>(pixels);
+    const size_t count = static_cast<size_t>(width) * height;
+
+    const BYTE* in = input;
+    const BYTE* end = input + inputSize;
+    size_t i = 0;
+
+    while (in < end)
+    {
+        BYTE op;
+        size_t length;
+        in = ReadHeader(in, end, &op, &length);
+        if (!in || length > count - i) return false;
+
+        switch (op)
+        {
+            case kLiteral:
+            {
+                if (static_cast<size_t>(end - in) < length * 4) return false;
+                memcpy(dst + i, in, length * 4);
+                in += length * 4;
+                break;
+            }
+            case kRepeat:
+            {
+                if (end - in < 4) return false;
+                UINT pixel;
+                memcpy(&pixel, in, 4);
+                in += 4;
+                for (size_t k = 0; k < length; ++k) dst[i + k] = pixel;
+                break;
+            }
+            case kAbove:
+            {
+                if (i < width) return false;
+                if (length <= width)
+                {
+                    memcpy(dst + i, dst + i - width, length * 4);
+                }
+                else
+                {
+                    // The source overlaps the output, so copy forward pixel by pixel.
+                    for (size_t k = 0; k < length; ++k) dst[i + k] = dst[i + k - width];
+                }
+                break;
+            }
+            default:
+            {
+                return false;
+            }
+        }
+
+        i += length;
+    }
+
+    return i == count;
+}
\ No newline at end of file
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <Windows.h>
+
+// Fast lossless codec for 32-bit frames kept in memory while a window is idle.
+// Each token starts with one byte: the upper 2 bits select the op and the lower 6 bits
+// hold (length - 1), extended by a varint when they are all set.
+//   Literal : followed by length pixels
+//   Repeat  : followed by one pixel repeated length times
+//   Above   : copy length pixels from one row above
+class FrameCodec
+{
+public:
+    static size_t GetMaxEncodedSize(UINT width, UINT height);
+
+    // Returns the encoded size, or 0 if the output does not fit.
+    // Passing the raw frame size as outputSize rejects frames that would not get smaller.
+    static size_t Encode(const BYTE* pixels, UINT width, UINT height, BYTE* output, size_t outputSize);
+
+    static bool Decode(const BYTE* input, size_t inputSize, UINT width, UINT height, BYTE* pixels);
+};
\ No newline at end of file
@@ -0,0 +1,490 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <thread>
+
+#include "Buffer.h"
+#include "FrameCodec.h"
+#include "Image.h"
+#include "MipChain.h"
+#include "TileDiff.h"
+
+class FrameRing;
+
+// Owns one pin of a slot and keeps the ring alive even if the window is removed meanwhile.
+struct FrameLease
+{
+    std::shared_ptr<const FrameRing> ring;
+    int index = -1;
+    // The slot of the lease in the pool of its ring, or -1 if it was allocated on its own.
+    int poolIndex = -1;
+};
+
+// Lock-free triple buffer between one capture thread (writer) and any number of readers.
+// The writer fills a slot that is neither published nor pinned, then publishes it by index.
+// Readers pin the published slot so that the writer never reuses it while it is being read.
+// The published slot of an idle window can be compressed; the first reader restores it.
+class FrameRing
+{
+public:
+    static constexpr int kSlotCount = 3;
+    // Snapshot leases held at once before further ones are allocated.
+    static constexpr int kLeaseCount = 16;
+
+    struct Frame
+    {
+        Buffer<BYTE> buffer;
+        Buffer<BYTE> compressed;
+        MipChain mips;
+        // Tiles changed since the frame published before this one.
+        DirtyTiles dirtyTiles;
+        // The same change as a scroll plus remaining tiles, if scroll detection found one.
+        FrameMotion motion;
+        UINT width = 0;
+        UINT height = 0;
+        // The texture region the frame was captured with. Readers crop with it rather than with
+        // the window's current region, which the next capture may already have changed.
+        UINT regionX = 0;
+        UINT regionY = 0;
+        UINT regionWidth = 0;
+        UINT regionHeight = 0;
+        UINT64 sequence = 0;
+        AlphaMode alphaMode = AlphaMode::Ignore;
+        // Published on request, e.g. for a new texture or output filter, so it is uploaded whole.
+        bool isForced = false;
+
+        ConstImageView<PixelFormatBGRA8> GetView() const
+        {
+            if (buffer.Empty()) return ConstImageView<PixelFormatBGRA8>();
+            return ConstImageView<PixelFormatBGRA8>(buffer.Get(), width, height);
+        }
+
+        ConstImageView<PixelFormatBGRA8> GetRegionView() const
+        {
+            return GetView().Crop(regionX, regionY, regionWidth, regionHeight);
+        }
+
+        ConstImageView<PixelFormatBGRA8> GetMipView(UINT level) const
+        {
+            return mips.GetLevel(GetView(), level);
+        }
+    };
+
+    FrameRing()
+    {
+        for (auto& state : states_) state = 0;
+        for (auto& isUsed : leaseUsed_) isUsed = false;
+    }
+
+    ~FrameRing() = default;
+
+    FrameRing(const FrameRing&) = delete;
+    FrameRing& operator=(const FrameRing&) = delete;
+
+    // Called only from the capture thread.
+    // Returns nullptr if every free slot is pinned by readers; the caller should drop the frame.
+    Frame* BeginWrite()
+    {
+        if (writeIndex_ >= 0) return &frames_[writeIndex_];
+
+        const int published = published_.load();
+        for (int i = 0; i < kSlotCount; ++i)
+        {
+            if (i == published) continue;
+
+            if (Lock(i))
+            {
+                frames_[i].compressed.Reset();
+                writeIndex_ = i;
+                return &frames_[i];
+            }
+        }
+
+        return nullptr;
+    }
+
+    void EndWrite(bool publish)
+    {
+        if (writeIndex_ < 0) return;
+
+        const int index = writeIndex_;
+        writeIndex_ = -1;
+
+        // Publish before unlocking so that Evict() or Compress() never sees a published slot as stale.
+        if (publish)
+        {
+            frames_[index].sequence = ++sequence_;
+            published_ = index;
+        }
+
+        states_[index] = 0;
+    }
+
+    // Pins the latest published slot and returns its index, or -1 if nothing has been published yet.
+    int AcquireRead() const
+    {
+        for (;;)
+        {
+            const int index = published_.load();
+            if (index < 0) return -1;
+
+            auto& state = states_[index];
+            int readers = state.load();
+            if (readers == kCompressed)
+            {
+                Restore(index);
+                continue;
+            }
+            if (readers < 0)
+            {
+                // Another thread is writing or restoring this slot.
+                std::this_thread::yield();
+                continue;
+            }
+            if (!state.compare_exchange_weak(readers, readers + 1)) continue;
+
+            // The writer may have published another slot and reclaimed this one in the meantime.
+            if (published_.load() == index) return index;
+
+            state.fetch_sub(1);
+        }
+    }
+
+    void ReleaseRead(int index) const
+    {
+        if (index < 0 || index >= kSlotCount) return;
+        states_[index].fetch_sub(1);
+    }
+
+    const Frame& GetFrame(int index) const
+    {
+        return frames_[index];
+    }
+
+    bool HasFrame() const
+    {
+        return published_.load() >= 0;
+    }
+
+    bool IsCompressed() const
+    {
+        const int index = published_.load();
+        return index >= 0 && states_[index].load() == kCompressed;
+    }
+
+    UINT64 GetSequence() const
+    {
+        return sequence_.load();
+    }
+
+    // Frees every slot that is neither pinned by a reader nor being written, and returns the freed bytes.
+    // Evicting the published slot leaves the ring empty until the next capture.
+    size_t Evict()
+    {
+        size_t freed = 0;
+
+        for (int i = 0; i < kSlotCount; ++i)
+        {
+            if (!Lock(i)) continue;
+
+            auto& frame = frames_[i];
+            freed += frame.buffer.Capacity() + frame.compressed.Capacity() + frame.mips.GetCapacity() + frame.dirtyTiles.GetCapacity() + frame.motion.remainder.GetCapacity();
+            frame.buffer.Reset();
+            frame.compressed.Reset();
+            frame.mips.Reset();
+            frame.dirtyTiles.Reset();
+            frame.motion.Reset();
+            frame.width = 0;
+            frame.height = 0;
+
+            int published = i;
+            published_.compare_exchange_strong(published, -1);
+
+            states_[i] = 0;
+        }
+
+        return freed;
+    }
+
+    // Compresses the published slot and frees the other unpinned slots, and returns the saved bytes.
+    // Pinned slots are skipped, and so is a frame that would not get smaller.
+    // The mips, dirty tiles and motion of the published slot are kept, since they are small and cannot be restored.
+    // The scratch buffer receives the encoded data before it is copied into an exact-size block.
+    size_t Compress(Buffer<BYTE>* scratch)
+    {
+        size_t saved = 0;
+
+        for (int i = 0; i < kSlotCount; ++i)
+        {
+            int previous = 0;
+            if (!Lock(i, &previous)) continue;
+
+            auto& frame = frames_[i];
+
+            if (published_.load() != i)
+            {
+                saved += frame.buffer.Capacity() + frame.compressed.Capacity() + frame.mips.GetCapacity() + frame.dirtyTiles.GetCapacity() + frame.motion.remainder.GetCapacity();
+                frame.buffer.Reset();
+                frame.compressed.Reset();
+                frame.mips.Reset();
+                frame.dirtyTiles.Reset();
+                frame.motion.Reset();
+                states_[i] = 0;
+                continue;
+            }
+
+            const UINT rawSize = frame.buffer.Size();
+            if (previous == kCompressed || rawSize == 0)
+            {
+                states_[i] = previous;
+                continue;
+            }
+
+            scratch->ExpandIfNeeded(rawSize);
+            const size_t size = FrameCodec::Encode(frame.buffer.Get(), frame.width, frame.height, scratch->Get(), rawSize);
+            if (size == 0)
+            {
+                states_[i] = 0;
+                continue;
+            }
+
+            frame.compressed.ExpandIfNeeded(static_cast<UINT>(size));
+            memcpy(frame.compressed.Get(), scratch->Get(), size);
+            saved += frame.buffer.Capacity() - frame.compressed.Capacity();
+            frame.buffer.Reset();
+
+            states_[i] = kCompressed;
+        }
+
+        return saved;
+    }
+
+    // Snapshots are acquired every frame, so their leases come from a pool instead of the heap.
+    // The caller fills in the lease; an exhausted pool falls back to allocating one.
+    FrameLease* TakeLease() const
+    {
+        for (int i = 0; i < kLeaseCount; ++i)
+        {
+            bool expected = false;
+            if (leaseUsed_[i].compare_exchange_strong(expected, true))
+            {
+                leases_[i].poolIndex = i;
+                return &leases_[i];
+            }
+        }
+
+        return new FrameLease();
+    }
+
+    // The lease must no longer hold the ring, since a pooled one lives in it.
+    void ReturnLease(FrameLease* lease) const
+    {
+        const int poolIndex = lease->poolIndex;
+        if (poolIndex < 0)
+        {
+            delete lease;
+            return;
+        }
+
+        lease->index = -1;
+        leaseUsed_[poolIndex] = false;
+    }
+
+    // Call this from the capture thread. A concurrent Evict() may make the totals momentarily stale.
+    BufferStats GetStats() const
+    {
+        BufferStats total;
+        for (const auto& frame : frames_)
+        {
+            const auto& stats = frame.buffer.GetStats();
+            total.allocations += stats.allocations;
+            total.shrinks += stats.shrinks;
+            total.inPlaceGrowths += stats.inPlaceGrowths;
+            total.preservedBytes += stats.preservedBytes;
+            total.currentBytes += stats.currentBytes;
+            total.peakBytes += stats.peakBytes;
+        }
+        return total;
+    }
+
+private:
+    static constexpr int kWriting = -1;
+    static constexpr int kCompressed = -2;
+
+    // Takes a slot that is neither pinned nor being written. The caller owns its compressed data too.
+    bool Lock(int index, int* previous = nullptr)
+    {
+        int expected = 0;
+        if (!states_[index].compare_exchange_strong(expected, kWriting))
+        {
+            expected = kCompressed;
+            if (!states_[index].compare_exchange_strong(expected, kWriting)) return false;
+        }
+
+        if (previous) *previous = expected;
+        return true;
+    }
+
+    void Restore(int index) const
+    {
+        int expected = kCompressed;
+        if (!states_[index].compare_exchange_strong(expected, kWriting)) return;
+
+        // A failed decode leaves the buffer empty, which readers treat as no frame.
+        auto& frame = frames_[index];
+        frame.buffer.ExpandIfNeeded(frame.width * frame.height * 4);
+        if (!FrameCodec::Decode(frame.compressed.Get(), frame.compressed.Size(), frame.width, frame.height, frame.buffer.Get()))
+        {
+            frame.buffer.Reset();
+        }
+        frame.compressed.Reset();
+
+        states_[index] = 0;
+    }
+
+    mutable Frame frames_[kSlotCount];
+    mutable std::atomic<int> states_[kSlotCount];
+    mutable FrameLease leases_[kLeaseCount];
+    mutable std::atomic<bool> leaseUsed_[kLeaseCount];
+    std::atomic<int> published_ = -1;
+    std::atomic<UINT64> sequence_ = 0;
+    int writeIndex_ = -1;
+};
+
+
+// Read-only, refcounted view of a published frame handed out through the DLL interface.
+// The slot stays pinned until ReleaseFrameSnapshot() is called, so the pointer is never overwritten.
+struct FrameSnapshot
+{
+    const BYTE* pixels = nullptr;
+    UINT stride = 0;
+    UINT width = 0;
+    UINT height = 0;
+    UINT64 sequence = 0;
+    AlphaMode alphaMode = AlphaMode::Ignore;
+    void* handle = nullptr;
+};
+
+
+// Hands the pin of the slot over to a lease for the snapshot handle.
+inline FrameLease* MakeFrameLease(const std::shared_ptr<const FrameRing>& ring, int index)
+{
+    auto lease = ring->TakeLease();
+    lease->ring = ring;
+    lease->index = index;
+    return lease;
+}
+
+
+inline bool AcquireFrameSnapshot(const std::shared_ptr<const FrameRing>& ring, FrameSnapshot* snapshot)
+{
+    if (!ring || !snapshot) return false;
+
+    const int index = ring->AcquireRead();
+    if (index < 0) return false;
+
+    const auto& frame = ring->GetFrame(index);
+    if (frame.buffer.Empty())
+    {
+        ring->ReleaseRead(index);
+        return false;
+    }
+
+    snapshot->pixels = frame.buffer.Get();
+    snapshot->stride = frame.width * 4;
+    snapshot->width = frame.width;
+    snapshot->height = frame.height;
+    snapshot->sequence = frame.sequence;
+    snapshot->alphaMode = frame.alphaMode;
+    snapshot->handle = MakeFrameLease(ring, index);
+
+    return true;
+}
+
+
+// Same as AcquireFrameSnapshot() but for one mip level; level 0 is the captured region of the frame.
+inline bool AcquireMipSnapshot(const std::shared_ptr<const FrameRing>& ring, UINT level, FrameSnapshot* snapshot)
+{
+    if (!ring || !snapshot) return false;
+
+    const int index = ring->AcquireRead();
+    if (index < 0) return false;
+
+    const auto& frame = ring->GetFrame(index);
+    const auto view = frame.GetMipView(level);
+    if (view.Empty())
+    {
+        ring->ReleaseRead(index);
+        return false;
+    }
+
+    snapshot->pixels = view.GetData();
+    snapshot->stride = static_cast<UINT>(view.GetStride());
+    snapshot->width = view.GetWidth();
+    snapshot->height = view.GetHeight();
+    snapshot->sequence = frame.sequence;
+    snapshot->alphaMode = frame.alphaMode;
+    snapshot->handle = MakeFrameLease(ring, index);
+
+    return true;
+}
+
+
+// Writes the rectangles of up to maxCount tiles of the frame that changed since the previous
+// sequence, and returns the number of changed tiles, or -1 if the whole frame has to be taken as changed.
+inline int GetFrameSnapshotDirtyRects(const FrameSnapshot* snapshot, RECT* rects, UINT maxCount)
+{
+    if (!snapshot || !snapshot->handle) return -1;
+
+    const auto lease = static_cast<const FrameLease*>(snapshot->handle);
+    const auto& dirtyTiles = lease->ring->GetFrame(lease->index).dirtyTiles;
+    if (dirtyTiles.Empty()) return -1;
+
+    return static_cast<int>(dirtyTiles.GetRects(rects, rects ? maxCount : 0));
+}
+
+
+// Gets the scroll found in the frame since the previous sequence: the pixels at rect were at
+// rect offset by (-dx, -dy). Returns false if no scroll was found.
+inline bool GetFrameSnapshotMotion(const FrameSnapshot* snapshot, RECT* rect, int* dx, int* dy)
+{
+    if (!snapshot || !snapshot->handle) return false;
+
+    const auto lease = static_cast<const FrameLease*>(snapshot->handle);
+    const auto& motion = lease->ring->GetFrame(lease->index).motion;
+    if (motion.Empty()) return false;
+
+    if (rect) *rect = motion.rect;
+    if (dx) *dx = motion.dx;
+    if (dy) *dy = motion.dy;
+    return true;
+}
+
+
+// Like GetFrameSnapshotDirtyRects(), but for the tiles left to update after the scroll
+// from GetFrameSnapshotMotion(). Returns -1 if no scroll was found.
+inline int GetFrameSnapshotMotionRemainderRects(const FrameSnapshot* snapshot, RECT* rects, UINT maxCount)
+{
+    if (!snapshot || !snapshot->handle) return -1;
+
+    const auto lease = static_cast<const FrameLease*>(snapshot->handle);
+    const auto& motion = lease->ring->GetFrame(lease->index).motion;
+    if (motion.Empty()) return -1;
+
+    return static_cast<int>(motion.remainder.GetRects(rects, rects ? maxCount : 0));
+}
+
+
+inline void ReleaseFrameSnapshot(FrameSnapshot* snapshot)
+{
+    if (!snapshot || !snapshot->handle) return;
+
+    // The lease may hold the last reference to the ring, which owns the pooled leases.
+    auto lease = static_cast<FrameLease*>(snapshot->handle);
+    const auto ring = std::move(lease->ring);
+    ring->ReleaseRead(lease->index);
+    ring->ReturnLease(lease);
+
+    *snapshot = FrameSnapshot();
+}
\ No newline at end of file
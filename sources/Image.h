@@ -0,0 +1,295 @@
+#pragma once
+
+#include <Windows.h>
+#include <type_traits>
+
+#include "Buffer.h"
+#include "PixelKernels.h"
+
+// Pixel formats are compile-time traits. Channel values are byte offsets within a pixel.
+struct PixelFormatBGRA8
+{
+    using Pixel = UINT;
+    static constexpr UINT kBytesPerPixel = 4;
+    static constexpr int kR = 2;
+    static constexpr int kG = 1;
+    static constexpr int kB = 0;
+    static constexpr int kA = 3;
+};
+
+struct PixelFormatRGBA8
+{
+    using Pixel = UINT;
+    static constexpr UINT kBytesPerPixel = 4;
+    static constexpr int kR = 0;
+    static constexpr int kG = 1;
+    static constexpr int kB = 2;
+    static constexpr int kA = 3;
+};
+
+
+// How the alpha channel of a frame is to be read.
+enum class AlphaMode
+{
+    // The alpha channel carries no meaning, as with most GDI captures of windows.
+    Ignore = 0,
+    Straight = 1,
+    Premultiplied = 2,
+};
+
+
+// Non-owning view of a rectangle of pixels. The stride is in bytes and may be negative,
+// so cropping and vertical flipping only adjust the view and never touch the pixels.
+template <class Format, class Byte>
+class BasicImageView
+{
+public:
+    using Pixel = typename Format::Pixel;
+    using PixelPtr = typename std::conditional<std::is_const<Byte>::value, const Pixel*, Pixel*>::type;
+
+    static constexpr UINT kBytesPerPixel = Format::kBytesPerPixel;
+
+    BasicImageView() = default;
+
+    BasicImageView(Byte* data, UINT width, UINT height, int stride)
+        : data_(data)
+        , width_(width)
+        , height_(height)
+        , stride_(stride)
+    {
+    }
+
+    BasicImageView(Byte* data, UINT width, UINT height)
+        : BasicImageView(data, width, height, static_cast<int>(width * kBytesPerPixel))
+    {
+    }
+
+    // Allows an ImageView to be passed where a ConstImageView is expected.
+    template <class OtherByte, class = typename std::enable_if<std::is_convertible<OtherByte*, Byte*>::value>::type>
+    BasicImageView(const BasicImageView<Format, OtherByte>& other)
+        : BasicImageView(other.GetData(), other.GetWidth(), other.GetHeight(), other.GetStride())
+    {
+    }
+
+    bool Empty() const
+    {
+        return !data_ || width_ == 0 || height_ == 0;
+    }
+
+    Byte* GetData() const
+    {
+        return data_;
+    }
+
+    UINT GetWidth() const
+    {
+        return width_;
+    }
+
+    UINT GetHeight() const
+    {
+        return height_;
+    }
+
+    int GetStride() const
+    {
+        return stride_;
+    }
+
+    UINT GetRowBytes() const
+    {
+        return width_ * kBytesPerPixel;
+    }
+
+    bool IsContiguous() const
+    {
+        return stride_ == static_cast<int>(GetRowBytes());
+    }
+
+    Byte* GetRow(UINT y) const
+    {
+        return data_ + static_cast<ptrdiff_t>(y) * stride_;
+    }
+
+    PixelPtr GetRowPixels(UINT y) const
+    {
+        return reinterpret_cast<PixelPtr>(GetRow(y));
+    }
+
+    // Returns an empty view if the rectangle does not fit in this view.
+    BasicImageView Crop(UINT x, UINT y, UINT width, UINT height) const
+    {
+        if (x > width_ || y > height_ || width > width_ - x || height > height_ - y)
+        {
+            return BasicImageView();
+        }
+        return BasicImageView(GetRow(y) + x * kBytesPerPixel, width, height, stride_);
+    }
+
+    BasicImageView FlipVertical() const
+    {
+        if (Empty()) return *this;
+        return BasicImageView(GetRow(height_ - 1), width_, height_, -stride_);
+    }
+
+private:
+    Byte* data_ = nullptr;
+    UINT width_ = 0;
+    UINT height_ = 0;
+    int stride_ = 0;
+};
+
+template <class Format>
+using ImageView = BasicImageView<Format, BYTE>;
+
+template <class Format>
+using ConstImageView = BasicImageView<Format, const BYTE>;
+
+
+// Image that owns tightly packed storage allocated from the buffer pool.
+template <class Format>
+class Image
+{
+public:
+    static constexpr UINT kBytesPerPixel = Format::kBytesPerPixel;
+
+    Image() = default;
+
+    Image(UINT width, UINT height)
+    {
+        Create(width, height);
+    }
+
+    void Create(UINT width, UINT height)
+    {
+        buffer_.ExpandIfNeeded(width * height * kBytesPerPixel);
+        width_ = width;
+        height_ = height;
+    }
+
+    void Reset()
+    {
+        buffer_.Reset();
+        width_ = 0;
+        height_ = 0;
+    }
+
+    bool Empty() const
+    {
+        return buffer_.Empty();
+    }
+
+    UINT GetWidth() const
+    {
+        return width_;
+    }
+
+    UINT GetHeight() const
+    {
+        return height_;
+    }
+
+    BYTE* GetData() const
+    {
+        return buffer_.Get();
+    }
+
+    ImageView<Format> GetView()
+    {
+        return ImageView<Format>(buffer_.Get(), width_, height_);
+    }
+
+    ConstImageView<Format> GetView() const
+    {
+        return ConstImageView<Format>(buffer_.Get(), width_, height_);
+    }
+
+    Buffer<BYTE>& GetBuffer()
+    {
+        return buffer_;
+    }
+
+private:
+    Buffer<BYTE> buffer_;
+    UINT width_ = 0;
+    UINT height_ = 0;
+};
+
+
+// Copies one row of pixels, reordering the channels if the formats differ.
+template <class SrcFormat, class DstFormat>
+void ConvertRow(const BYTE* in, BYTE* out, UINT width)
+{
+    static_assert(SrcFormat::kBytesPerPixel == 4 && DstFormat::kBytesPerPixel == 4, "Only 32-bit formats are supported.");
+
+    constexpr bool isSameOrder =
+        SrcFormat::kR == DstFormat::kR && SrcFormat::kG == DstFormat::kG &&
+        SrcFormat::kB == DstFormat::kB && SrcFormat::kA == DstFormat::kA;
+    constexpr bool isRedBlueSwapped =
+        SrcFormat::kR == DstFormat::kB && SrcFormat::kB == DstFormat::kR &&
+        SrcFormat::kG == DstFormat::kG && SrcFormat::kA == DstFormat::kA;
+
+    if (isSameOrder)
+    {
+        // The pipeline converts rows in place after resampling.
+        if (in != out) memcpy(out, in, width * 4);
+        return;
+    }
+
+    if (isRedBlueSwapped)
+    {
+        PixelKernels::SwapRedBlue(in, out, width);
+        return;
+    }
+
+    for (UINT x = 0; x < width; ++x, in += 4, out += 4)
+    {
+        const BYTE r = in[SrcFormat::kR];
+        const BYTE g = in[SrcFormat::kG];
+        const BYTE b = in[SrcFormat::kB];
+        const BYTE a = in[SrcFormat::kA];
+        out[DstFormat::kR] = r;
+        out[DstFormat::kG] = g;
+        out[DstFormat::kB] = b;
+        out[DstFormat::kA] = a;
+    }
+}
+
+
+// Copies pixels between views of the same size, reordering the channels if the formats differ.
+// Flipping or cropping is done by passing a flipped or cropped view.
+template <class SrcFormat, class DstFormat>
+bool ConvertPixels(const ConstImageView<SrcFormat>& src, const ImageView<DstFormat>& dst)
+{
+    if (src.GetWidth() != dst.GetWidth() || src.GetHeight() != dst.GetHeight()) return false;
+
+    for (UINT y = 0; y < src.GetHeight(); ++y)
+    {
+        ConvertRow<SrcFormat, DstFormat>(src.GetRow(y), dst.GetRow(y), src.GetWidth());
+    }
+
+    return true;
+}
+
+
+// Converts the alpha mode of the pixels in place. Nothing is done if either mode is Ignore.
+template <class Format>
+void ConvertAlphaMode(const ImageView<Format>& image, AlphaMode from, AlphaMode to)
+{
+    static_assert(Format::kA == 3, "The kernels expect alpha in the 4th byte.");
+
+    if (from == to || from == AlphaMode::Ignore || to == AlphaMode::Ignore) return;
+
+    for (UINT y = 0; y < image.GetHeight(); ++y)
+    {
+        BYTE* row = image.GetRow(y);
+        if (to == AlphaMode::Premultiplied)
+        {
+            PixelKernels::Premultiply(row, row, image.GetWidth());
+        }
+        else
+        {
+            PixelKernels::Unpremultiply(row, row, image.GetWidth());
+        }
+    }
+}
@@ -0,0 +1,263 @@
+#pragma once
+
+#include <Windows.h>
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+#include "Image.h"
+#include "Resampler.h"
+
+
+// Number of bands RunRowBands() splits the rows into. Small images stay on one thread,
+// since starting a thread costs more than converting a few hundred thousand pixels.
+inline UINT GetRowBandCount(UINT rows, UINT rowPixels, UINT maxThreadCount)
+{
+    constexpr UINT kMinPixelsPerBand = 256 * 1024;
+    constexpr UINT kMinRowsPerBand = 16;
+
+    const UINT64 pixels = static_cast<UINT64>(rows) * rowPixels;
+    const UINT bandCount = static_cast<UINT>(std::min<UINT64>(pixels / kMinPixelsPerBand, rows / kMinRowsPerBand));
+    return std::max<UINT>(1, std::min<UINT>(bandCount, maxThreadCount));
+}
+
+
+// Splits the rows [0, rows) into bandCount bands and calls func(band, begin, end) for each,
+// running band 0 on the calling thread. The band index lets each band use its own slice of
+// a scratch buffer that the caller keeps across calls.
+template <class Func>
+void RunIndexedRowBands(UINT rows, UINT bandCount, Func&& func)
+{
+    if (bandCount <= 1)
+    {
+        func(0u, 0u, rows);
+        return;
+    }
+
+    std::vector<std::thread> threads;
+    threads.reserve(bandCount - 1);
+    for (UINT i = 1; i < bandCount; ++i)
+    {
+        const UINT begin = static_cast<UINT>(static_cast<UINT64>(rows) * i / bandCount);
+        const UINT end = static_cast<UINT>(static_cast<UINT64>(rows) * (i + 1) / bandCount);
+        threads.emplace_back([&func, i, begin, end] { func(i, begin, end); });
+    }
+
+    func(0u, 0u, static_cast<UINT>(rows / bandCount));
+
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+}
+
+
+// Splits the rows [0, rows) into bands and calls func(begin, end) for each band,
+// running the first band on the calling thread.
+template <class Func>
+void RunRowBands(UINT rows, UINT rowPixels, UINT maxThreadCount, Func&& func)
+{
+    RunIndexedRowBands(rows, GetRowBandCount(rows, rowPixels, maxThreadCount), [&func](UINT, UINT begin, UINT end)
+    {
+        func(begin, end);
+    });
+}
+
+
+// Copies a source view into a destination view in a single pass over memory.
+// Crop and flip are planned as an op list that only moves the source view, and
+// resampling to the destination size and channel reordering are fused per output
+// row, so the source is read once per output pixel instead of once per stage.
+template <class SrcFormat, class DstFormat>
+class ImagePipeline
+{
+public:
+    // Crops relative to the region left by the previous ops.
+    ImagePipeline& Crop(UINT x, UINT y, UINT width, UINT height)
+    {
+        return AddOp({ OpType::Crop, x, y, width, height });
+    }
+
+    ImagePipeline& FlipVertical()
+    {
+        return AddOp({ OpType::FlipVertical });
+    }
+
+    // Used when the destination size differs from the source region. Passing a resampler
+    // that outlives the pipeline keeps its weights while the sizes stay the same.
+    ImagePipeline& Resample(ResampleFilter filter, Resampler* cache = nullptr)
+    {
+        filter_ = filter;
+        resampler_ = cache;
+        return *this;
+    }
+
+    ImagePipeline& SetMaxThreadCount(UINT count)
+    {
+        maxThreadCount_ = std::max<UINT>(count, 1);
+        return *this;
+    }
+
+    // Returns the source region after the crop and flip ops, or an empty view if a crop does not fit.
+    ConstImageView<SrcFormat> GetRegion(const ConstImageView<SrcFormat>& src) const
+    {
+        if (isInvalid_) return ConstImageView<SrcFormat>();
+
+        auto view = src;
+        for (UINT i = 0; i < opCount_; ++i)
+        {
+            const auto& op = ops_[i];
+            switch (op.type)
+            {
+                case OpType::Crop:
+                    view = view.Crop(op.x, op.y, op.width, op.height);
+                    break;
+                case OpType::FlipVertical:
+                    view = view.FlipVertical();
+                    break;
+            }
+        }
+        return view;
+    }
+
+    bool Run(const ConstImageView<SrcFormat>& src, const ImageView<DstFormat>& dst) const
+    {
+        const auto region = GetRegion(src);
+        if (region.Empty() || dst.Empty())
+        {
+            DebugLog::Error(__FUNCTION__, " => The source region or the destination is empty.");
+            return false;
+        }
+
+        if (region.GetWidth() == dst.GetWidth() && region.GetHeight() == dst.GetHeight())
+        {
+            RunRowBands(dst.GetHeight(), dst.GetWidth(), maxThreadCount_, [&](UINT begin, UINT end)
+            {
+                for (UINT y = begin; y < end; ++y)
+                {
+                    ConvertRow<SrcFormat, DstFormat>(region.GetRow(y), dst.GetRow(y), dst.GetWidth());
+                }
+            });
+            return true;
+        }
+
+        if (filter_ == ResampleFilter::Nearest)
+        {
+            return ResampleNearest(region, dst);
+        }
+        return ResampleFiltered(region, dst);
+    }
+
+private:
+    enum class OpType
+    {
+        Crop,
+        FlipVertical,
+    };
+
+    struct Op
+    {
+        OpType type;
+        UINT x;
+        UINT y;
+        UINT width;
+        UINT height;
+    };
+
+    static constexpr UINT kMaxOpCount = 8;
+
+    ImagePipeline& AddOp(const Op& op)
+    {
+        if (opCount_ >= kMaxOpCount)
+        {
+            DebugLog::Error(__FUNCTION__, " => Too many ops.");
+            isInvalid_ = true;
+            return *this;
+        }
+        ops_[opCount_++] = op;
+        return *this;
+    }
+
+    // Samples the source pixel under the center of each destination pixel.
+    bool ResampleNearest(const ConstImageView<SrcFormat>& src, const ImageView<DstFormat>& dst) const
+    {
+        const UINT srcWidth = src.GetWidth();
+        const UINT srcHeight = src.GetHeight();
+        const UINT dstWidth = dst.GetWidth();
+        const UINT dstHeight = dst.GetHeight();
+
+        // The source column of x is (2x + 1) * srcWidth / (2 * dstWidth), stepped as a quotient and a
+        // remainder so that neither a column table nor a division per pixel is needed.
+        const UINT64 denominator = static_cast<UINT64>(dstWidth) * 2;
+        const UINT64 step = static_cast<UINT64>(srcWidth) * 2;
+        const UINT stepColumns = static_cast<UINT>(step / denominator);
+        const UINT64 stepRemainder = step % denominator;
+        const UINT firstColumn = static_cast<UINT>(srcWidth / denominator);
+        const UINT64 firstRemainder = srcWidth % denominator;
+
+        RunRowBands(dstHeight, dstWidth, maxThreadCount_, [&](UINT begin, UINT end)
+        {
+            for (UINT y = begin; y < end; ++y)
+            {
+                const UINT srcY = static_cast<UINT>((static_cast<UINT64>(y) * 2 + 1) * srcHeight / (static_cast<UINT64>(dstHeight) * 2));
+                const auto in = src.GetRowPixels(srcY);
+                const auto out = dst.GetRowPixels(y);
+                UINT column = firstColumn;
+                UINT64 remainder = firstRemainder;
+                for (UINT x = 0; x < dstWidth; ++x)
+                {
+                    out[x] = in[column];
+                    column += stepColumns;
+                    remainder += stepRemainder;
+                    if (remainder >= denominator)
+                    {
+                        remainder -= denominator;
+                        ++column;
+                    }
+                }
+
+                // The row is still in the cache, so reorder the channels in place.
+                ConvertRow<SrcFormat, DstFormat>(dst.GetRow(y), dst.GetRow(y), dstWidth);
+            }
+        });
+
+        return true;
+    }
+
+    bool ResampleFiltered(const ConstImageView<SrcFormat>& src, const ImageView<DstFormat>& dst) const
+    {
+        Resampler localResampler;
+        Resampler& resampler = resampler_ ? *resampler_ : localResampler;
+        if (!resampler.IsCreatedFor(src.GetWidth(), src.GetHeight(), dst.GetWidth(), dst.GetHeight(), filter_))
+        {
+            if (!resampler.Create(src.GetWidth(), src.GetHeight(), dst.GetWidth(), dst.GetHeight(), filter_)) return false;
+        }
+
+        // A downscaled row reads many source rows, so split the bands by the source size.
+        const UINT64 srcPixelsPerRow = static_cast<UINT64>(src.GetWidth()) * src.GetHeight() / dst.GetHeight();
+        const UINT rowPixels = static_cast<UINT>(std::max<UINT64>(srcPixelsPerRow, dst.GetWidth()));
+
+        const UINT bandCount = GetRowBandCount(dst.GetHeight(), rowPixels, maxThreadCount_);
+        const UINT rowBufferSize = resampler.GetRowBufferSize();
+        float* const rowBuffers = resampler.GetRowBuffers(bandCount);
+
+        RunIndexedRowBands(dst.GetHeight(), bandCount, [&](UINT band, UINT begin, UINT end)
+        {
+            float* const rowBuffer = rowBuffers + static_cast<size_t>(band) * rowBufferSize;
+            for (UINT y = begin; y < end; ++y)
+            {
+                resampler.ResampleRow(src.GetData(), src.GetStride(), y, dst.GetRow(y), rowBuffer);
+                ConvertRow<SrcFormat, DstFormat>(dst.GetRow(y), dst.GetRow(y), dst.GetWidth());
+            }
+        });
+
+        return true;
+    }
+
+    Op ops_[kMaxOpCount] {};
+    UINT opCount_ = 0;
+    bool isInvalid_ = false;
+    ResampleFilter filter_ = ResampleFilter::Nearest;
+    Resampler* resampler_ = nullptr;
+    UINT maxThreadCount_ = std::max<UINT>(std::thread::hardware_concurrency(), 1);
+};
@@ -0,0 +1,114 @@
+#include "pch.h"
+#include "ImageRotation.h"
+#include "ImagePipeline.h"
+#include "PixelKernels.h"
+
+
+void ImageRotation::GetRotatedSize(FrameRotation rotation, UINT width, UINT height, UINT* rotatedWidth, UINT* rotatedHeight)
+{
+    const bool isSwapped = rotation == FrameRotation::Clockwise90 || rotation == FrameRotation::Clockwise270;
+    *rotatedWidth = isSwapped ? height : width;
+    *rotatedHeight = isSwapped ? width : height;
+}
+
+
+bool ImageRotation::RotateRegion(FrameRotation rotation, bool mirror, UINT width, UINT height, UINT* x, UINT* y, UINT* regionWidth, UINT* regionHeight)
+{
+    const UINT rx = *x;
+    const UINT ry = *y;
+    const UINT rw = *regionWidth;
+    const UINT rh = *regionHeight;
+    if (rx > width || ry > height || rw > width - rx || rh > height - ry) return false;
+
+    // Pixel (x, y) moves to (H - 1 - y, x) at 90 degrees, (W - 1 - x, H - 1 - y) at 180 and (y, W - 1 - x) at 270.
+    switch (rotation)
+    {
+        case FrameRotation::Clockwise90:
+            *x = height - ry - rh;
+            *y = rx;
+            *regionWidth = rh;
+            *regionHeight = rw;
+            break;
+        case FrameRotation::Clockwise180:
+            *x = width - rx - rw;
+            *y = height - ry - rh;
+            break;
+        case FrameRotation::Clockwise270:
+            *x = ry;
+            *y = width - rx - rw;
+            *regionWidth = rh;
+            *regionHeight = rw;
+            break;
+        default:
+            break;
+    }
+
+    if (mirror)
+    {
+        UINT rotatedWidth, rotatedHeight;
+        GetRotatedSize(rotation, width, height, &rotatedWidth, &rotatedHeight);
+        *x = rotatedWidth - *x - *regionWidth;
+    }
+
+    return true;
+}
+
+
+bool ImageRotation::Rotate(const ConstImageView<PixelFormatBGRA8>& src, const ImageView<PixelFormatBGRA8>& dst, FrameRotation rotation, bool mirror, UINT maxThreadCount)
+{
+    UINT rotatedWidth, rotatedHeight;
+    GetRotatedSize(rotation, src.GetWidth(), src.GetHeight(), &rotatedWidth, &rotatedHeight);
+    if (src.Empty() || dst.GetWidth() != rotatedWidth || dst.GetHeight() != rotatedHeight)
+    {
+        DebugLog::Error(__FUNCTION__, " => The source is empty or the destination has the wrong size.");
+        return false;
+    }
+
+    // Transposing mirrors along the diagonal, so each case flips the views to turn that into its rotation.
+    switch (rotation)
+    {
+        case FrameRotation::Clockwise90:
+            Transpose(mirror ? src : src.FlipVertical(), dst, maxThreadCount);
+            break;
+        case FrameRotation::Clockwise180:
+            CopyRows(src.FlipVertical(), dst, !mirror, maxThreadCount);
+            break;
+        case FrameRotation::Clockwise270:
+            Transpose(mirror ? src.FlipVertical() : src, dst.FlipVertical(), maxThreadCount);
+            break;
+        default:
+            CopyRows(src, dst, mirror, maxThreadCount);
+            break;
+    }
+
+    return true;
+}
+
+
+void ImageRotation::Transpose(const ConstImageView<PixelFormatBGRA8>& src, const ImageView<PixelFormatBGRA8>& dst, UINT maxThreadCount)
+{
+    // Each band writes the destination rows that come from one range of source columns.
+    RunRowBands(dst.GetHeight(), dst.GetWidth(), maxThreadCount, [&](UINT begin, UINT end)
+    {
+        PixelKernels::Transpose(src.GetRow(0) + begin * 4, src.GetStride(), dst.GetRow(begin), dst.GetStride(), end - begin, src.GetHeight());
+    });
+}
+
+
+void ImageRotation::CopyRows(const ConstImageView<PixelFormatBGRA8>& src, const ImageView<PixelFormatBGRA8>& dst, bool reverse, UINT maxThreadCount)
+{
+    RunRowBands(dst.GetHeight(), dst.GetWidth(), maxThreadCount, [&](UINT begin, UINT end)
+    {
+        for (UINT y = begin; y < end; ++y)
+        {
+            if (reverse)
+            {
+                PixelKernels::ReverseRow(src.GetRow(y), dst.GetRow(y), dst.GetWidth());
+            }
+            else
+            {
+                memcpy(dst.GetRow(y), src.GetRow(y), dst.GetRowBytes());
+            }
+        }
+    });
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <Windows.h>
+
+#include "Image.h"
+
+enum class FrameRotation
+{
+    // Desktop windows follow the orientation of their monitor; other windows are not rotated.
+    Auto = -1,
+    None = 0,
+    Clockwise90 = 1,
+    Clockwise180 = 2,
+    Clockwise270 = 3,
+};
+
+
+// Rotates and mirrors frames. Rotations by 90 and 270 degrees are tiled transposes of a
+// source view that is flipped as needed, and the rest are row copies, so every pixel is
+// read and written once. The mirror is horizontal and is applied after the rotation.
+class ImageRotation
+{
+public:
+    static void GetRotatedSize(FrameRotation rotation, UINT width, UINT height, UINT* rotatedWidth, UINT* rotatedHeight);
+
+    // Maps a region of a width x height image to the same pixels in the rotated image.
+    // Returns false and leaves the region as it is if it does not fit in the image.
+    static bool RotateRegion(FrameRotation rotation, bool mirror, UINT width, UINT height, UINT* x, UINT* y, UINT* regionWidth, UINT* regionHeight);
+
+    // dst must have the rotated size and must not overlap src.
+    static bool Rotate(const ConstImageView<PixelFormatBGRA8>& src, const ImageView<PixelFormatBGRA8>& dst, FrameRotation rotation, bool mirror, UINT maxThreadCount);
+
+private:
+    static void Transpose(const ConstImageView<PixelFormatBGRA8>& src, const ImageView<PixelFormatBGRA8>& dst, UINT maxThreadCount);
+    static void CopyRows(const ConstImageView<PixelFormatBGRA8>& src, const ImageView<PixelFormatBGRA8>& dst, bool reverse, UINT maxThreadCount);
+};
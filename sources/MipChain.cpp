@@ -0,0 +1,123 @@
+#include "pch.h"
+#include <algorithm>
+#include "MipChain.h"
+#include "PixelKernels.h"
+
+namespace
+{
+    constexpr UINT kLevelAlignment = 64;
+
+    UINT GetNextSize(UINT size)
+    {
+        return size > 1 ? size / 2 : 1;
+    }
+}
+
+
+UINT MipChain::GetLevelCount(UINT width, UINT height)
+{
+    if (width == 0 || height == 0) return 0;
+
+    UINT count = 1;
+    while (width > 1 || height > 1)
+    {
+        width = GetNextSize(width);
+        height = GetNextSize(height);
+        ++count;
+    }
+    return count;
+}
+
+
+bool MipChain::Generate(const ConstImageView<PixelFormatBGRA8>& frame, UINT x, UINT y, UINT width, UINT height)
+{
+    const auto base = frame.Crop(x, y, width, height);
+    if (base.Empty())
+    {
+        Reset();
+        return false;
+    }
+
+    levelCount_ = GetLevelCount(width, height);
+    levels_[0].width = width;
+    levels_[0].height = height;
+    baseX_ = x;
+    baseY_ = y;
+
+    // Lay out every level first so that the buffer is allocated once.
+    UINT size = 0;
+    for (UINT i = 1; i < levelCount_; ++i)
+    {
+        width = GetNextSize(width);
+        height = GetNextSize(height);
+        levels_[i].offset = size;
+        levels_[i].width = width;
+        levels_[i].height = height;
+        size += (width * height * 4 + kLevelAlignment - 1) / kLevelAlignment * kLevelAlignment;
+    }
+    buffer_.ExpandIfNeeded(size);
+
+    auto src = base;
+    for (UINT i = 1; i < levelCount_; ++i)
+    {
+        const auto dst = ImageView<PixelFormatBGRA8>(buffer_.Get() + levels_[i].offset, levels_[i].width, levels_[i].height);
+
+        // Odd sizes drop the last row or column like D3D does; a size of 1 repeats its only row or column.
+        const bool isSingleColumn = src.GetWidth() == 1;
+        for (UINT y = 0; y < dst.GetHeight(); ++y)
+        {
+            const BYTE* row0 = src.GetRow(std::min<UINT>(y * 2, src.GetHeight() - 1));
+            const BYTE* row1 = src.GetRow(std::min<UINT>(y * 2 + 1, src.GetHeight() - 1));
+            if (isSingleColumn)
+            {
+                BYTE pixels0[8], pixels1[8];
+                memcpy(pixels0, row0, 4);
+                memcpy(pixels0 + 4, row0, 4);
+                memcpy(pixels1, row1, 4);
+                memcpy(pixels1 + 4, row1, 4);
+                PixelKernels::Downsample2x(pixels0, pixels1, dst.GetRow(y), 1);
+            }
+            else
+            {
+                PixelKernels::Downsample2x(row0, row1, dst.GetRow(y), dst.GetWidth());
+            }
+        }
+
+        src = dst;
+    }
+
+    return true;
+}
+
+
+void MipChain::Reset()
+{
+    buffer_.Reset();
+    levelCount_ = 0;
+}
+
+
+UINT MipChain::GetLevelCount() const
+{
+    return levelCount_;
+}
+
+
+size_t MipChain::GetCapacity() const
+{
+    return buffer_.Capacity();
+}
+
+
+ConstImageView<PixelFormatBGRA8> MipChain::GetLevel(const ConstImageView<PixelFormatBGRA8>& frame, UINT level) const
+{
+    if (level >= levelCount_) return ConstImageView<PixelFormatBGRA8>();
+
+    if (level == 0)
+    {
+        return frame.Crop(baseX_, baseY_, levels_[0].width, levels_[0].height);
+    }
+
+    const auto& info = levels_[level];
+    return ConstImageView<PixelFormatBGRA8>(buffer_.Get() + info.offset, info.width, info.height);
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <Windows.h>
+
+#include "Buffer.h"
+#include "Image.h"
+
+// Mip levels of a frame region, each a 2x2 box downsample of the previous one down to 1x1.
+// Level 0 is the region of the frame itself and is not copied, so the frame is passed in
+// to read it. The other levels live in one buffer, each starting on its own cache line,
+// so reading a small level touches only that level.
+class MipChain
+{
+public:
+    static constexpr UINT kMaxLevelCount = 32;
+
+    // Number of levels including level 0, e.g. 3 for 4x4 (4x4, 2x2, 1x1).
+    static UINT GetLevelCount(UINT width, UINT height);
+
+    bool Generate(const ConstImageView<PixelFormatBGRA8>& frame, UINT x, UINT y, UINT width, UINT height);
+    void Reset();
+
+    UINT GetLevelCount() const;
+    size_t GetCapacity() const;
+
+    // Returns an empty view if the level has not been generated.
+    ConstImageView<PixelFormatBGRA8> GetLevel(const ConstImageView<PixelFormatBGRA8>& frame, UINT level) const;
+
+private:
+    struct Level
+    {
+        UINT offset = 0;
+        UINT width = 0;
+        UINT height = 0;
+    };
+
+    Buffer<BYTE> buffer_;
+    // The offset of level 0 is unused; its position in the frame is kept separately.
+    Level levels_[kMaxLevelCount];
+    UINT baseX_ = 0;
+    UINT baseY_ = 0;
+    UINT levelCount_ = 0;
+};
@@ -0,0 +1,331 @@
+#include "pch.h"
+#include <algorithm>
+#include "PartialUpload.h"
+
+namespace
+{
+    // A copy call costs about as much as copying this many pixels, going by the driver overhead
+    // of UpdateSubresource against its copy rate.
+    constexpr UINT64 kBoxOverheadPixels = 16 * 1024;
+
+    UINT64 GetImageBytes(const ConstImageView<PixelFormatBGRA8>& image)
+    {
+        return static_cast<UINT64>(image.GetRowBytes()) * image.GetHeight();
+    }
+
+    UINT64 GetBoxBytes(const RECT& box)
+    {
+        return static_cast<UINT64>(box.right - box.left) * (box.bottom - box.top) * PixelFormatBGRA8::kBytesPerPixel;
+    }
+
+    UINT64 GetUploadCost(UINT boxCount, UINT64 pixels)
+    {
+        return pixels + boxCount * kBoxOverheadPixels;
+    }
+
+    bool IsSameRect(const RECT& a, const RECT& b)
+    {
+        return a.left == b.left && a.top == b.top && a.right == b.right && a.bottom == b.bottom;
+    }
+}
+
+
+D3D11UploadTarget::D3D11UploadTarget(ID3D11DeviceContext* context, ID3D11Texture2D* texture, Microsoft::WRL::ComPtr<ID3D11Texture2D>* scratch)
+    : context_(context)
+    , texture_(texture)
+    , scratch_(scratch)
+{
+}
+
+
+bool D3D11UploadTarget::Upload(const ConstImageView<PixelFormatBGRA8>& image)
+{
+    context_->UpdateSubresource(texture_, 0, nullptr, image.GetData(), image.GetStride(), 0);
+    return true;
+}
+
+
+bool D3D11UploadTarget::Upload(const ConstImageView<PixelFormatBGRA8>& image, const RECT& box)
+{
+    const auto region = image.Crop(box.left, box.top, box.right - box.left, box.bottom - box.top);
+    if (region.Empty()) return false;
+
+    const D3D11_BOX destination =
+    {
+        static_cast<UINT>(box.left), static_cast<UINT>(box.top), 0,
+        static_cast<UINT>(box.right), static_cast<UINT>(box.bottom), 1,
+    };
+    context_->UpdateSubresource(texture_, 0, &destination, region.GetData(), region.GetStride(), 0);
+    return true;
+}
+
+
+bool D3D11UploadTarget::Move(const RECT& rect, int dx, int dy)
+{
+    if (!scratch_ || rect.left >= rect.right || rect.top >= rect.bottom) return false;
+
+    D3D11_TEXTURE2D_DESC desc;
+    texture_->GetDesc(&desc);
+
+    const RECT source = { rect.left - dx, rect.top - dy, rect.right - dx, rect.bottom - dy };
+    const LONG width = static_cast<LONG>(desc.Width);
+    const LONG height = static_cast<LONG>(desc.Height);
+    if (std::min<LONG>(rect.left, source.left) < 0 || std::min<LONG>(rect.top, source.top) < 0 ||
+        std::max<LONG>(rect.right, source.right) > width || std::max<LONG>(rect.bottom, source.bottom) > height)
+    {
+        return false;
+    }
+
+    if (!PrepareScratch(desc)) return false;
+
+    const D3D11_BOX sourceBox =
+    {
+        static_cast<UINT>(source.left), static_cast<UINT>(source.top), 0,
+        static_cast<UINT>(source.right), static_cast<UINT>(source.bottom), 1,
+    };
+    context_->CopySubresourceRegion(scratch_->Get(), 0, 0, 0, 0, texture_, 0, &sourceBox);
+
+    const D3D11_BOX scratchBox =
+    {
+        0, 0, 0,
+        static_cast<UINT>(rect.right - rect.left), static_cast<UINT>(rect.bottom - rect.top), 1,
+    };
+    context_->CopySubresourceRegion(texture_, 0, rect.left, rect.top, 0, scratch_->Get(), 0, &scratchBox);
+
+    return true;
+}
+
+
+bool D3D11UploadTarget::PrepareScratch(const D3D11_TEXTURE2D_DESC& desc)
+{
+    if (*scratch_)
+    {
+        D3D11_TEXTURE2D_DESC scratchDesc;
+        (*scratch_)->GetDesc(&scratchDesc);
+        if (scratchDesc.Width == desc.Width && scratchDesc.Height == desc.Height && scratchDesc.Format == desc.Format)
+        {
+            return true;
+        }
+        scratch_->Reset();
+    }
+
+    D3D11_TEXTURE2D_DESC scratchDesc = desc;
+    scratchDesc.MipLevels = 1;
+    scratchDesc.ArraySize = 1;
+    scratchDesc.Usage = D3D11_USAGE_DEFAULT;
+    scratchDesc.BindFlags = 0;
+    scratchDesc.CPUAccessFlags = 0;
+    scratchDesc.MiscFlags = 0;
+
+    Microsoft::WRL::ComPtr<ID3D11Device> device;
+    texture_->GetDevice(&device);
+    if (FAILED(device->CreateTexture2D(&scratchDesc, nullptr, scratch_->GetAddressOf())))
+    {
+        DebugLog::Error(__FUNCTION__, " => CreateTexture2D() failed.");
+        return false;
+    }
+
+    return true;
+}
+
+
+void D3D11UploadTarget::Flush()
+{
+    context_->Flush();
+}
+
+
+bool MemoryUploadTarget::Upload(const ConstImageView<PixelFormatBGRA8>& image)
+{
+    image_.Create(image.GetWidth(), image.GetHeight());
+
+    const auto dst = image_.GetView();
+    for (UINT y = 0; y < image.GetHeight(); ++y)
+    {
+        memcpy(dst.GetRow(y), image.GetRow(y), image.GetRowBytes());
+    }
+
+    uploadedBytes_ += GetImageBytes(image);
+    ++callCount_;
+    return true;
+}
+
+
+bool MemoryUploadTarget::Upload(const ConstImageView<PixelFormatBGRA8>& image, const RECT& box)
+{
+    const UINT width = box.right - box.left;
+    const UINT height = box.bottom - box.top;
+    const auto src = image.Crop(box.left, box.top, width, height);
+    const auto dst = image_.GetView().Crop(box.left, box.top, width, height);
+    if (src.Empty() || dst.Empty()) return false;
+
+    for (UINT y = 0; y < height; ++y)
+    {
+        memcpy(dst.GetRow(y), src.GetRow(y), src.GetRowBytes());
+    }
+
+    uploadedBytes_ += GetBoxBytes(box);
+    ++callCount_;
+    return true;
+}
+
+
+bool MemoryUploadTarget::Move(const RECT& rect, int dx, int dy)
+{
+    const UINT width = rect.right - rect.left;
+    const UINT height = rect.bottom - rect.top;
+    const auto view = image_.GetView();
+    const auto src = view.Crop(rect.left - dx, rect.top - dy, width, height);
+    const auto dst = view.Crop(rect.left, rect.top, width, height);
+    if (rect.left - dx < 0 || rect.top - dy < 0 || src.Empty() || dst.Empty()) return false;
+
+    moveImage_.Create(width, height);
+    const auto scratch = moveImage_.GetView();
+    for (UINT y = 0; y < height; ++y)
+    {
+        memcpy(scratch.GetRow(y), src.GetRow(y), src.GetRowBytes());
+    }
+    for (UINT y = 0; y < height; ++y)
+    {
+        memcpy(dst.GetRow(y), scratch.GetRow(y), scratch.GetRowBytes());
+    }
+
+    ++callCount_;
+    return true;
+}
+
+
+ConstImageView<PixelFormatBGRA8> MemoryUploadTarget::GetImage() const
+{
+    return image_.GetView();
+}
+
+
+UINT64 MemoryUploadTarget::GetUploadedBytes() const
+{
+    return uploadedBytes_;
+}
+
+
+UINT64 MemoryUploadTarget::GetCallCount() const
+{
+    return callCount_;
+}
+
+
+void PartialUploader::SetMaxDirtyRatio(float ratio)
+{
+    maxDirtyRatio_ = ratio;
+}
+
+
+float PartialUploader::GetMaxDirtyRatio() const
+{
+    return maxDirtyRatio_;
+}
+
+
+bool PartialUploader::ShouldUploadPartially(UINT boxCount, UINT64 dirtyPixels, UINT64 totalPixels) const
+{
+    if (boxCount == 0 || totalPixels == 0) return false;
+
+    const UINT64 cost = GetUploadCost(boxCount, dirtyPixels);
+    return static_cast<double>(cost) <= static_cast<double>(totalPixels) * maxDirtyRatio_.load();
+}
+
+
+bool PartialUploader::Upload(IUploadTarget* target, const ConstImageView<PixelFormatBGRA8>& image, const DirtyTiles* dirtyTiles, const FrameMotion* motion)
+{
+    if (!target || image.Empty()) return false;
+
+    UINT boxCount = 0;
+    RECT region = {};
+    const DirtyRectMerger* boxes = &merger_;
+    bool isMove = false;
+    if (dirtyTiles)
+    {
+        region = dirtyTiles->GetRegion();
+        if (region.right - region.left == static_cast<LONG>(image.GetWidth()) &&
+            region.bottom - region.top == static_cast<LONG>(image.GetHeight()))
+        {
+            boxCount = merger_.Merge(*dirtyTiles);
+
+            if (motion && !motion->Empty() && IsSameRect(motion->remainder.GetRegion(), region))
+            {
+                const UINT moveBoxCount = motionMerger_.Merge(motion->remainder) + 1;
+                isMove =
+                    GetUploadCost(moveBoxCount, motionMerger_.GetPixelCount()) <
+                    GetUploadCost(boxCount, merger_.GetPixelCount());
+                if (isMove)
+                {
+                    boxes = &motionMerger_;
+                    boxCount = moveBoxCount;
+                }
+            }
+        }
+    }
+
+    const UINT64 totalPixels = static_cast<UINT64>(image.GetWidth()) * image.GetHeight();
+    bool isPartial = ShouldUploadPartially(boxCount, boxes->GetPixelCount(), totalPixels);
+
+    if (isPartial && isMove)
+    {
+        RECT rect = motion->rect;
+        ::OffsetRect(&rect, -region.left, -region.top);
+        if (!target->Move(rect, motion->dx, motion->dy))
+        {
+            isPartial = false;
+            isMove = false;
+        }
+    }
+
+    UINT64 uploadedBytes = 0;
+    if (isPartial)
+    {
+        const RECT* rects = boxes->GetRects();
+        for (UINT i = 0; i < boxes->GetCount(); ++i)
+        {
+            RECT box = rects[i];
+            ::OffsetRect(&box, -region.left, -region.top);
+            if (!target->Upload(image, box)) return false;
+            uploadedBytes += GetBoxBytes(box);
+        }
+    }
+    else
+    {
+        if (!target->Upload(image)) return false;
+        uploadedBytes = GetImageBytes(image);
+    }
+    target->Flush();
+
+    std::lock_guard<std::mutex> lock(statsMutex_);
+    if (isPartial)
+    {
+        ++stats_.partialUploads;
+        stats_.boxes += boxes->GetCount();
+        if (isMove) ++stats_.moves;
+    }
+    else
+    {
+        ++stats_.fullUploads;
+    }
+    stats_.uploadedBytes += uploadedBytes;
+    stats_.frameBytes += GetImageBytes(image);
+
+    return true;
+}
+
+
+void PartialUploader::Skip(const ConstImageView<PixelFormatBGRA8>& image)
+{
+    std::lock_guard<std::mutex> lock(statsMutex_);
+    ++stats_.skippedUploads;
+    stats_.frameBytes += GetImageBytes(image);
+}
+
+
+UploadStats PartialUploader::GetStats() const
+{
+    std::lock_guard<std::mutex> lock(statsMutex_);
+    return stats_;
+}
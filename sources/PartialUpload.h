@@ -0,0 +1,113 @@
+#pragma once
+
+#include <Windows.h>
+#include <d3d11.h>
+#include <wrl/client.h>
+#include <mutex>
+#include <atomic>
+
+#include "Image.h"
+#include "TileDiff.h"
+
+struct UploadStats
+{
+    UINT64 fullUploads = 0;
+    UINT64 partialUploads = 0;
+    UINT64 skippedUploads = 0;
+    UINT64 boxes = 0;
+    // Partial uploads that moved a scroll within the target before uploading the boxes.
+    UINT64 moves = 0;
+    UINT64 uploadedBytes = 0;
+    // What uploading every frame in full would have taken.
+    UINT64 frameBytes = 0;
+};
+
+
+// Where the pixels of a frame go. The target has the size of the image, and a box is copied
+// to the same place in the target.
+class IUploadTarget
+{
+public:
+    virtual ~IUploadTarget() = default;
+
+    virtual bool Upload(const ConstImageView<PixelFormatBGRA8>& image) = 0;
+    virtual bool Upload(const ConstImageView<PixelFormatBGRA8>& image, const RECT& box) = 0;
+    // Copies the pixels at rect offset by (-dx, -dy) to rect within the target.
+    // A target that cannot returns false, and gets the boxes of the frame instead.
+    virtual bool Move(const RECT& rect, int dx, int dy) { return false; }
+    virtual void Flush() {}
+};
+
+
+// A move goes through the scratch texture, created on demand and kept by the caller across
+// frames, since a copy within one texture must not overlap. Without scratch, nothing is moved.
+class D3D11UploadTarget : public IUploadTarget
+{
+public:
+    D3D11UploadTarget(ID3D11DeviceContext* context, ID3D11Texture2D* texture, Microsoft::WRL::ComPtr<ID3D11Texture2D>* scratch = nullptr);
+
+    bool Upload(const ConstImageView<PixelFormatBGRA8>& image) override;
+    bool Upload(const ConstImageView<PixelFormatBGRA8>& image, const RECT& box) override;
+    bool Move(const RECT& rect, int dx, int dy) override;
+    void Flush() override;
+
+private:
+    bool PrepareScratch(const D3D11_TEXTURE2D_DESC& desc);
+
+    ID3D11DeviceContext* const context_;
+    ID3D11Texture2D* const texture_;
+    Microsoft::WRL::ComPtr<ID3D11Texture2D>* const scratch_;
+};
+
+
+// Keeps the uploads in memory and counts the copied bytes, e.g. to measure a policy without a GPU.
+class MemoryUploadTarget : public IUploadTarget
+{
+public:
+    bool Upload(const ConstImageView<PixelFormatBGRA8>& image) override;
+    bool Upload(const ConstImageView<PixelFormatBGRA8>& image, const RECT& box) override;
+    bool Move(const RECT& rect, int dx, int dy) override;
+
+    ConstImageView<PixelFormatBGRA8> GetImage() const;
+    UINT64 GetUploadedBytes() const;
+    UINT64 GetCallCount() const;
+
+private:
+    Image<PixelFormatBGRA8> image_;
+    Image<PixelFormatBGRA8> moveImage_;
+    UINT64 uploadedBytes_ = 0;
+    UINT64 callCount_ = 0;
+};
+
+
+// Uploads only the tiles that changed since the previous upload, merged into boxes, unless the
+// boxes would cost more than the whole frame. A box is taken to cost a fixed overhead on top of
+// its pixels, since each one is a separate copy call. For a scroll, moving the pixels already
+// in the target and uploading the remaining tiles is used instead when that costs less, the
+// move counting as one more box.
+class PartialUploader
+{
+public:
+    // Above this fraction of dirty pixels, overheads included, the whole frame is uploaded.
+    // 0 always uploads the whole frame.
+    void SetMaxDirtyRatio(float ratio);
+    float GetMaxDirtyRatio() const;
+
+    // dirtyTiles must be relative to the frame in the target and cover exactly the image,
+    // or be null to upload the whole image. motion is only used along with dirtyTiles.
+    bool Upload(IUploadTarget* target, const ConstImageView<PixelFormatBGRA8>& image, const DirtyTiles* dirtyTiles, const FrameMotion* motion = nullptr);
+
+    // Counts a frame that did not need an upload since nothing changed.
+    void Skip(const ConstImageView<PixelFormatBGRA8>& image);
+
+    UploadStats GetStats() const;
+
+private:
+    bool ShouldUploadPartially(UINT boxCount, UINT64 dirtyPixels, UINT64 totalPixels) const;
+
+    DirtyRectMerger merger_;
+    DirtyRectMerger motionMerger_;
+    std::atomic<float> maxDirtyRatio_ = 0.5f;
+    UploadStats stats_;
+    mutable std::mutex statsMutex_;
+};
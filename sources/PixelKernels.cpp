@@ -0,0 +1,1712 @@
+#include "pch.h"
+#include <algorithm>
+#include <intrin.h>
+#include <emmintrin.h>
+#include <immintrin.h>
+#include "PixelKernels.h"
+
+// MSVC accepts AVX2 intrinsics in any function, other compilers need them enabled per function.
+#ifdef _MSC_VER
+#define TARGET_AVX2
+#else //_MSC_VER
+#define TARGET_AVX2 __attribute__((target("avx2,f16c")))
+#endif //_MSC_VER
+
+std::atomic<CpuIsa> PixelKernels::_detectedIsa = CpuIsa::SSE2;
+std::atomic<CpuIsa> PixelKernels::_activeIsa = CpuIsa::SSE2;
+std::atomic<PixelKernels::SwapRedBlueFunc> PixelKernels::_swapRedBlue = &PixelKernels::SwapRedBlueSSE2;
+std::atomic<PixelKernels::XorFunc> PixelKernels::_xor = &PixelKernels::XorSSE2;
+std::atomic<PixelKernels::HasAlphaFunc> PixelKernels::_hasAlpha = &PixelKernels::HasAlphaSSE2;
+std::atomic<PixelKernels::CompositeCursorFunc> PixelKernels::_compositeCursor = &PixelKernels::CompositeCursorSSE2;
+std::atomic<PixelKernels::ApplyCursorMaskFunc> PixelKernels::_applyCursorMask = &PixelKernels::ApplyCursorMaskSSE2;
+std::atomic<PixelKernels::AccumulateRowFunc> PixelKernels::_accumulateRow = &PixelKernels::AccumulateRowSSE2;
+std::atomic<PixelKernels::FilterRowFunc> PixelKernels::_filterRow = &PixelKernels::FilterRowSSE2;
+std::atomic<PixelKernels::Downsample2xFunc> PixelKernels::_downsample2x = &PixelKernels::Downsample2xSSE2;
+std::atomic<PixelKernels::WeightedSumFunc> PixelKernels::_weightedSum = &PixelKernels::WeightedSumSSE2;
+std::atomic<PixelKernels::ToRGB565Func> PixelKernels::_toRGB565 = &PixelKernels::ToRGB565SSE2;
+std::atomic<PixelKernels::ToRGBA16FFunc> PixelKernels::_toRGBA16F = &PixelKernels::ToRGBA16FScalar;
+std::atomic<PixelKernels::PremultiplyFunc> PixelKernels::_premultiply = &PixelKernels::PremultiplySSE2;
+std::atomic<PixelKernels::UnpremultiplyFunc> PixelKernels::_unpremultiply = &PixelKernels::UnpremultiplySSE2;
+std::atomic<PixelKernels::ReverseRowFunc> PixelKernels::_reverseRow = &PixelKernels::ReverseRowSSE2;
+std::atomic<PixelKernels::TransposeFunc> PixelKernels::_transpose = &PixelKernels::TransposeSSE2;
+std::atomic<PixelKernels::HashTileRowFunc> PixelKernels::_hashTileRow = &PixelKernels::HashTileRowSSE2;
+std::atomic<PixelKernels::HashColumnsFunc> PixelKernels::_hashColumns = &PixelKernels::HashColumnsSSE2;
+
+namespace
+{
+    constexpr UINT kColorMask = 0x00FFFFFF;
+    constexpr UINT kAlphaMask = 0xFF000000;
+
+    // Transposes work on tiles of this many pixels square, so that the source and destination
+    // rows of a tile (4 KB each) stay in the L1 cache while the tile is written.
+    constexpr UINT kTransposeTileSize = 32;
+
+    // Tile hashes follow the accumulate and scramble steps of XXH3 on stripes of 8 pixels.
+    // Each stripe of a tile has its own keys, so that moving pixels within a row changes the hash.
+    constexpr UINT kHashStripePixels = 8;
+    constexpr UINT kHashKeyStripes = 8;
+    constexpr UINT kHashPrime = 0x9E3779B1;
+
+    alignas(32) const UINT64 kHashKeys[kHashKeyStripes * 4] =
+    {
+        0xF2A74DE452E6B438ULL, 0x6513270E269E0D37ULL, 0x0C5C7FD0A6A3A450ULL, 0xD23F0824128B2F33ULL,
+        0x1818E811892F902BULL, 0x9531985D5D9DC9F8ULL, 0xE8E25D940ED90475ULL, 0x36F675CC81E74EF5ULL,
+        0x1600A35A099950D8ULL, 0x6B0D549B6F03675AULL, 0x3D9C172411E20B8FULL, 0x8D116ECE1738F7D9ULL,
+        0x0F21DDB66CAD4A26ULL, 0x90C192CFD3AC94AFULL, 0xF28C105D1FB17C23ULL, 0xA170B33839263059ULL,
+        0x953F48F1A09F76B5ULL, 0x0FD630F1F29D0DA9ULL, 0x95E60AF593BD04CFULL, 0x0CB1E29C658CDA14ULL,
+        0x3898D190F9EBDACCULL, 0x8E81973E0BECD7B0ULL, 0x2217BEADDBC496CBULL, 0x6B4CB2424A23D596ULL,
+        0x8A6A63EC24EDE6A4ULL, 0x922766581E27A1C0ULL, 0x8F6D05584EF8AA38ULL, 0xAE97BA94D0EDA82FULL,
+        0x1A61DBE22E44158BULL, 0x923A736994E3BF91ULL, 0x301850C5A38FD547ULL, 0x18F135D25F557203ULL,
+    };
+
+    alignas(32) const UINT64 kHashScrambleKeys[4] =
+    {
+        0xB64CE4228C38FB29ULL, 0x907A70C31012F037ULL, 0x9E7769B10F4205B4ULL, 0x7F15052434B9B5DFULL,
+    };
+
+    void AccumulateStripe(const BYTE* src, const UINT64* keys, UINT64* lanes)
+    {
+        for (int i = 0; i < 4; ++i)
+        {
+            UINT64 data;
+            memcpy(&data, src + i * 8, 8);
+            const UINT64 mixed = data ^ keys[i];
+            lanes[i ^ 1] += data;
+            lanes[i] += (mixed & 0xFFFFFFFF) * (mixed >> 32);
+        }
+    }
+
+    // The lanes of one stripe as two halves, after the SSE2 path of XXH3.
+    void AccumulateStripe(const BYTE* src, const UINT64* keys, __m128i* lo, __m128i* hi)
+    {
+        const __m128i data0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+        const __m128i data1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 16));
+        const __m128i mixed0 = _mm_xor_si128(data0, _mm_load_si128(reinterpret_cast<const __m128i*>(keys)));
+        const __m128i mixed1 = _mm_xor_si128(data1, _mm_load_si128(reinterpret_cast<const __m128i*>(keys + 2)));
+        const __m128i product0 = _mm_mul_epu32(mixed0, _mm_shuffle_epi32(mixed0, _MM_SHUFFLE(0, 3, 0, 1)));
+        const __m128i product1 = _mm_mul_epu32(mixed1, _mm_shuffle_epi32(mixed1, _MM_SHUFFLE(0, 3, 0, 1)));
+        *lo = _mm_add_epi64(*lo, _mm_add_epi64(_mm_shuffle_epi32(data0, _MM_SHUFFLE(1, 0, 3, 2)), product0));
+        *hi = _mm_add_epi64(*hi, _mm_add_epi64(_mm_shuffle_epi32(data1, _MM_SHUFFLE(1, 0, 3, 2)), product1));
+    }
+
+    __m128i ScrambleLanes(__m128i lanes, const UINT64* keys)
+    {
+        // 64-bit multiply by a 32-bit prime from two 32x32 products.
+        const __m128i prime = _mm_set1_epi32(static_cast<int>(kHashPrime));
+        lanes = _mm_xor_si128(lanes, _mm_srli_epi64(lanes, 47));
+        lanes = _mm_xor_si128(lanes, _mm_load_si128(reinterpret_cast<const __m128i*>(keys)));
+        const __m128i low = _mm_mul_epu32(lanes, prime);
+        const __m128i high = _mm_mul_epu32(_mm_srli_epi64(lanes, 32), prime);
+        return _mm_add_epi64(low, _mm_slli_epi64(high, 32));
+    }
+
+    UINT Load(const BYTE* ptr)
+    {
+        UINT value;
+        memcpy(&value, ptr, 4);
+        return value;
+    }
+
+    void Store(BYTE* ptr, UINT value)
+    {
+        memcpy(ptr, &value, 4);
+    }
+
+    // Rounds to nearest even. Only zero and normal results are needed for values in [0, 1].
+    USHORT FloatToHalf(float value)
+    {
+        UINT bits;
+        memcpy(&bits, &value, 4);
+
+        const UINT sign = (bits >> 16) & 0x8000;
+        if ((bits & 0x7FFFFFFF) == 0) return static_cast<USHORT>(sign);
+
+        const int exponent = static_cast<int>((bits >> 23) & 0xFF) - 127 + 15;
+        const UINT mantissa = bits & 0x7FFFFF;
+        UINT half = sign | (static_cast<UINT>(exponent) << 10) | (mantissa >> 13);
+
+        const UINT rest = mantissa & 0x1FFF;
+        if (rest > 0x1000 || (rest == 0x1000 && (half & 1))) ++half;
+
+        return static_cast<USHORT>(half);
+    }
+
+    struct HalfTable
+    {
+        USHORT values[256];
+
+        HalfTable()
+        {
+            for (int i = 0; i < 256; ++i)
+            {
+                // Same float math as the F16C variant, so that both round identically.
+                values[i] = FloatToHalf(static_cast<float>(i) * (1.f / 255.f));
+            }
+        }
+    };
+
+    const char* GetIsaName(CpuIsa isa)
+    {
+        switch (isa)
+        {
+            case CpuIsa::Scalar: return "Scalar";
+            case CpuIsa::SSE2: return "SSE2";
+            case CpuIsa::AVX2: return "AVX2";
+            default: return "Unknown";
+        }
+    }
+}
+
+
+CpuIsa PixelKernels::DetectIsa()
+{
+    int info[4];
+    __cpuid(info, 0);
+    const int maxLeaf = info[0];
+
+    __cpuid(info, 1);
+    const bool hasSSE2 = (info[3] & (1 << 26)) != 0;
+    const bool hasOSXSave = (info[2] & (1 << 27)) != 0;
+    const bool hasAVX = (info[2] & (1 << 28)) != 0;
+    if (!hasSSE2) return CpuIsa::Scalar;
+
+    // AVX2 also needs the OS to save the YMM registers on context switches.
+    // Every AVX2 CPU has F16C as well, but check it since the AVX2 variants use it.
+    const bool hasF16C = (info[2] & (1 << 29)) != 0;
+    if (!hasOSXSave || !hasAVX || !hasF16C || maxLeaf < 7) return CpuIsa::SSE2;
+    if ((_xgetbv(0) & 0x6) != 0x6) return CpuIsa::SSE2;
+
+    __cpuidex(info, 7, 0);
+    const bool hasAVX2 = (info[1] & (1 << 5)) != 0;
+
+    return hasAVX2 ? CpuIsa::AVX2 : CpuIsa::SSE2;
+}
+
+
+void PixelKernels::Initialize(CpuIsa maxIsa)
+{
+    const CpuIsa detected = DetectIsa();
+    CpuIsa isa = maxIsa < detected ? maxIsa : detected;
+
+    // A variant that differs from the scalar one would corrupt every frame it touches,
+    // so it is never bound.
+    if (isa != CpuIsa::Scalar && !VerifyKernels(isa))
+    {
+        DebugLog::Error(__FUNCTION__, " => The ", GetIsaName(isa), " kernels differ from the scalar ones. Falling back to Scalar.");
+        isa = CpuIsa::Scalar;
+    }
+
+    BindKernels(isa);
+
+    _detectedIsa = detected;
+    _activeIsa = isa;
+
+    DebugLog::Log(__FUNCTION__, " => ", GetIsaName(isa), " (detected: ", GetIsaName(detected), ")");
+}
+
+
+void PixelKernels::BindKernels(CpuIsa isa)
+{
+    switch (isa)
+    {
+        case CpuIsa::AVX2:
+        {
+            _swapRedBlue = &SwapRedBlueAVX2;
+            _xor = &XorAVX2;
+            _hasAlpha = &HasAlphaAVX2;
+            _compositeCursor = &CompositeCursorAVX2;
+            _applyCursorMask = &ApplyCursorMaskAVX2;
+            _accumulateRow = &AccumulateRowAVX2;
+            _filterRow = &FilterRowAVX2;
+            _downsample2x = &Downsample2xAVX2;
+            _weightedSum = &WeightedSumAVX2;
+            _toRGB565 = &ToRGB565AVX2;
+            _toRGBA16F = &ToRGBA16FAVX2;
+            _premultiply = &PremultiplyAVX2;
+            _unpremultiply = &UnpremultiplyAVX2;
+            _reverseRow = &ReverseRowAVX2;
+            _transpose = &TransposeAVX2;
+            _hashTileRow = &HashTileRowAVX2;
+            _hashColumns = &HashColumnsAVX2;
+            break;
+        }
+        case CpuIsa::SSE2:
+        {
+            _swapRedBlue = &SwapRedBlueSSE2;
+            _xor = &XorSSE2;
+            _hasAlpha = &HasAlphaSSE2;
+            _compositeCursor = &CompositeCursorSSE2;
+            _applyCursorMask = &ApplyCursorMaskSSE2;
+            _accumulateRow = &AccumulateRowSSE2;
+            _filterRow = &FilterRowSSE2;
+            _downsample2x = &Downsample2xSSE2;
+            _weightedSum = &WeightedSumSSE2;
+            _toRGB565 = &ToRGB565SSE2;
+            _toRGBA16F = &ToRGBA16FScalar;
+            _premultiply = &PremultiplySSE2;
+            _unpremultiply = &UnpremultiplySSE2;
+            _reverseRow = &ReverseRowSSE2;
+            _transpose = &TransposeSSE2;
+            _hashTileRow = &HashTileRowSSE2;
+            _hashColumns = &HashColumnsSSE2;
+            break;
+        }
+        default:
+        {
+            _swapRedBlue = &SwapRedBlueScalar;
+            _xor = &XorScalar;
+            _hasAlpha = &HasAlphaScalar;
+            _compositeCursor = &CompositeCursorScalar;
+            _applyCursorMask = &ApplyCursorMaskScalar;
+            _accumulateRow = &AccumulateRowScalar;
+            _filterRow = &FilterRowScalar;
+            _downsample2x = &Downsample2xScalar;
+            _weightedSum = &WeightedSumScalar;
+            _toRGB565 = &ToRGB565Scalar;
+            _toRGBA16F = &ToRGBA16FScalar;
+            _premultiply = &PremultiplyScalar;
+            _unpremultiply = &UnpremultiplyScalar;
+            _reverseRow = &ReverseRowScalar;
+            _transpose = &TransposeScalar;
+            _hashTileRow = &HashTileRowScalar;
+            _hashColumns = &HashColumnsScalar;
+            break;
+        }
+    }
+}
+
+
+CpuIsa PixelKernels::GetDetectedIsa()
+{
+    return _detectedIsa;
+}
+
+
+CpuIsa PixelKernels::GetActiveIsa()
+{
+    return _activeIsa;
+}
+
+
+bool PixelKernels::VerifyKernels(CpuIsa isa)
+{
+    // Compare every variant the CPU can run against the scalar one on random rows,
+    // with odd widths and offsets so that the tails and unaligned loads are covered.
+    constexpr UINT maxWidth = 67;
+    constexpr UINT bufferSize = (maxWidth + 4) * 4;
+    BYTE src[4][bufferSize];
+    BYTE expected[bufferSize];
+    BYTE actual[bufferSize];
+
+    UINT seed = 12345;
+    for (auto& row : src)
+    {
+        for (auto& value : row)
+        {
+            seed = seed * 1664525 + 1013904223;
+            value = static_cast<BYTE>(seed >> 24);
+        }
+    }
+
+    // Make some pixels equal or black so that every branch of the cursor kernels is taken.
+    for (UINT i = 0; i < bufferSize; i += 12)
+    {
+        memcpy(src[1] + i, src[0] + i, 4);
+        src[2][i + 3] = 0;
+        if (i % 24 == 0) memset(src[2] + i + 4, 0, 3);
+        if (i % 36 == 0) memset(src[1] + i + 4, 0, 3);
+    }
+    for (UINT i = 3; i < bufferSize; i += 4)
+    {
+        src[3][i] = 0;
+    }
+
+    struct Variants
+    {
+        SwapRedBlueFunc swapRedBlue;
+        XorFunc xorMask;
+        HasAlphaFunc hasAlpha;
+        CompositeCursorFunc compositeCursor;
+        ApplyCursorMaskFunc applyCursorMask;
+        AccumulateRowFunc accumulateRow;
+        FilterRowFunc filterRow;
+        Downsample2xFunc downsample2x;
+        WeightedSumFunc weightedSum;
+        ToRGB565Func toRGB565;
+        ToRGBA16FFunc toRGBA16F;
+        PremultiplyFunc premultiply;
+        UnpremultiplyFunc unpremultiply;
+        ReverseRowFunc reverseRow;
+        TransposeFunc transpose;
+        HashTileRowFunc hashTileRow;
+        HashColumnsFunc hashColumns;
+    };
+    const Variants scalar
+    {
+        &SwapRedBlueScalar, &XorScalar, &HasAlphaScalar, &CompositeCursorScalar, &ApplyCursorMaskScalar,
+        &AccumulateRowScalar, &FilterRowScalar, &Downsample2xScalar, &WeightedSumScalar,
+        &ToRGB565Scalar, &ToRGBA16FScalar, &PremultiplyScalar, &UnpremultiplyScalar, &ReverseRowScalar,
+        &TransposeScalar, &HashTileRowScalar, &HashColumnsScalar,
+    };
+    const Variants variants[] =
+    {
+        {
+            &SwapRedBlueSSE2, &XorSSE2, &HasAlphaSSE2, &CompositeCursorSSE2, &ApplyCursorMaskSSE2,
+            &AccumulateRowSSE2, &FilterRowSSE2, &Downsample2xSSE2, &WeightedSumSSE2,
+            &ToRGB565SSE2, &ToRGBA16FScalar, &PremultiplySSE2, &UnpremultiplySSE2, &ReverseRowSSE2,
+            &TransposeSSE2, &HashTileRowSSE2, &HashColumnsSSE2,
+        },
+        {
+            &SwapRedBlueAVX2, &XorAVX2, &HasAlphaAVX2, &CompositeCursorAVX2, &ApplyCursorMaskAVX2,
+            &AccumulateRowAVX2, &FilterRowAVX2, &Downsample2xAVX2, &WeightedSumAVX2,
+            &ToRGB565AVX2, &ToRGBA16FAVX2, &PremultiplyAVX2, &UnpremultiplyAVX2, &ReverseRowAVX2,
+            &TransposeAVX2, &HashTileRowAVX2, &HashColumnsAVX2,
+        },
+    };
+
+    // Chroma weights have negative values, and the offset takes some results out of range.
+    const ColorWeights colorWeights = { 112, -86, -26, 128 };
+
+    // Resampling taps: 3 per output pixel with a negative lobe, so that the clamping is covered too.
+    constexpr UINT tapCount = 3;
+    UINT starts[maxWidth];
+    float weights[maxWidth * tapCount];
+    float accumulated[2][bufferSize];
+    for (UINT x = 0; x < maxWidth; ++x)
+    {
+        starts[x] = x;
+        weights[x * tapCount + 0] = -0.25f;
+        weights[x * tapCount + 1] = 1.125f + static_cast<float>(x % 5) * 0.0625f;
+        weights[x * tapCount + 2] = 0.125f;
+    }
+
+    // Transpose input: crosses the tile size and leaves partial micro tiles at both edges.
+    constexpr UINT imageWidth = kTransposeTileSize + 5;
+    constexpr UINT imageHeight = 21;
+    constexpr int imageStride = imageWidth * 4;
+    constexpr int transposedStride = imageHeight * 4;
+    BYTE image[imageWidth * imageHeight * 4];
+    BYTE transposed[2][imageWidth * imageHeight * 4];
+    for (auto& value : image)
+    {
+        seed = seed * 1664525 + 1013904223;
+        value = static_cast<BYTE>(seed >> 24);
+    }
+
+    // Tile hashes: tiles of 16 pixels leave a narrower last tile and a partial stripe for most widths.
+    constexpr UINT hashTileWidth = 16;
+    UINT64 lanes[2][(maxWidth + hashTileWidth - 1) / hashTileWidth * 4];
+    UINT columns[2][maxWidth];
+
+    const CpuIsa variantIsas[] = { CpuIsa::SSE2, CpuIsa::AVX2 };
+
+    bool result = true;
+    for (size_t v = 0; v < _countof(variants); ++v)
+    {
+        if (variantIsas[v] > isa) break;
+
+        const auto& variant = variants[v];
+        for (UINT width = 0; width <= maxWidth; ++width)
+        {
+            const UINT offset = (width % 4) * 4;
+            const BYTE* a = src[0] + offset;
+            const BYTE* b = src[1];
+            const BYTE* c = src[2] + 4;
+            const size_t bytes = width * 4;
+
+            const auto check = [&](const char* name)
+            {
+                if (memcmp(expected, actual, bytes) == 0) return;
+                DebugLog::Error(__FUNCTION__, " => ", name, " (", GetIsaName(variantIsas[v]), ") differs from the scalar one. width=", width);
+                result = false;
+            };
+
+            scalar.swapRedBlue(a, expected, width);
+            variant.swapRedBlue(a, actual, width);
+            check("SwapRedBlue");
+
+            scalar.xorMask(a, b, expected, width);
+            variant.xorMask(a, b, actual, width);
+            check("Xor");
+
+            // src[3] has no alpha at all, while the random row has alpha almost everywhere.
+            if (scalar.hasAlpha(src[3], width) != variant.hasAlpha(src[3], width) ||
+                scalar.hasAlpha(a, width) != variant.hasAlpha(a, width))
+            {
+                DebugLog::Error(__FUNCTION__, " => HasAlpha (", GetIsaName(variantIsas[v]), ") differs from the scalar one. width=", width);
+                result = false;
+            }
+
+            scalar.compositeCursor(a, b, c, expected, width);
+            variant.compositeCursor(a, b, c, actual, width);
+            check("CompositeCursor");
+
+            scalar.applyCursorMask(c, b, expected, width);
+            variant.applyCursorMask(c, b, actual, width);
+            check("ApplyCursorMask");
+
+            for (UINT i = 0; i < 2; ++i)
+            {
+                for (UINT j = 0; j < bufferSize; ++j)
+                {
+                    accumulated[i][j] = static_cast<float>(c[j % (bufferSize - 4)]) * 0.5f;
+                }
+            }
+            scalar.accumulateRow(a, 0.3f, accumulated[0], width * 4);
+            variant.accumulateRow(a, 0.3f, accumulated[1], width * 4);
+            if (memcmp(accumulated[0], accumulated[1], width * 4 * sizeof(float)) != 0)
+            {
+                DebugLog::Error(__FUNCTION__, " => AccumulateRow (", GetIsaName(variantIsas[v]), ") differs from the scalar one. width=", width);
+                result = false;
+            }
+
+            // The filter reads tapCount - 1 pixels past the width.
+            scalar.filterRow(accumulated[0], starts, weights, tapCount, expected, width);
+            variant.filterRow(accumulated[0], starts, weights, tapCount, actual, width);
+            check("FilterRow");
+
+            // Reads two source pixels per output pixel.
+            scalar.downsample2x(src[0], src[2], expected, width / 2);
+            variant.downsample2x(src[0], src[2], actual, width / 2);
+            check("Downsample2x");
+
+            // A step of 2 leaves every other byte untouched, so start from the same bytes.
+            memset(expected, 0, sizeof(expected));
+            memset(actual, 0, sizeof(actual));
+            scalar.weightedSum(a, expected, 1 + width % 2, width, colorWeights);
+            variant.weightedSum(a, actual, 1 + width % 2, width, colorWeights);
+            check("WeightedSum");
+
+            scalar.toRGB565(a, expected, width);
+            variant.toRGB565(a, actual, width);
+            check("ToRGB565");
+
+            // Writes 8 bytes per pixel.
+            scalar.toRGBA16F(a, expected, width / 2);
+            variant.toRGBA16F(a, actual, width / 2);
+            check("ToRGBA16F");
+
+            // c has zero alpha every third pixel, and random colors above alpha which must be clamped.
+            scalar.premultiply(c, expected, width);
+            variant.premultiply(c, actual, width);
+            check("Premultiply");
+
+            scalar.unpremultiply(c, expected, width);
+            variant.unpremultiply(c, actual, width);
+            check("Unpremultiply");
+
+            scalar.reverseRow(a, expected, width);
+            variant.reverseRow(a, actual, width);
+            check("ReverseRow");
+
+            for (UINT i = 0; i < _countof(lanes[0]); ++i)
+            {
+                lanes[0][i] = lanes[1][i] = i * 0x9E3779B97F4A7C15ULL;
+            }
+            scalar.hashTileRow(a, width, hashTileWidth, lanes[0]);
+            variant.hashTileRow(a, width, hashTileWidth, lanes[1]);
+            if (memcmp(lanes[0], lanes[1], sizeof(lanes[0])) != 0)
+            {
+                DebugLog::Error(__FUNCTION__, " => HashTileRow (", GetIsaName(variantIsas[v]), ") differs from the scalar one. width=", width);
+                result = false;
+            }
+
+            for (UINT x = 0; x < maxWidth; ++x)
+            {
+                columns[0][x] = columns[1][x] = x * 0x9E3779B1;
+            }
+            scalar.hashColumns(a, width, columns[0]);
+            variant.hashColumns(a, width, columns[1]);
+            if (memcmp(columns[0], columns[1], sizeof(columns[0])) != 0)
+            {
+                DebugLog::Error(__FUNCTION__, " => HashColumns (", GetIsaName(variantIsas[v]), ") differs from the scalar one. width=", width);
+                result = false;
+            }
+        }
+
+        // Read bottom-up to cover negative strides.
+        const BYTE* lastRow = image + (imageHeight - 1) * imageStride;
+        scalar.transpose(lastRow, -imageStride, transposed[0], transposedStride, imageWidth, imageHeight);
+        variant.transpose(lastRow, -imageStride, transposed[1], transposedStride, imageWidth, imageHeight);
+        if (memcmp(transposed[0], transposed[1], sizeof(transposed[0])) != 0)
+        {
+            DebugLog::Error(__FUNCTION__, " => Transpose (", GetIsaName(variantIsas[v]), ") differs from the scalar one.");
+            result = false;
+        }
+    }
+
+    return result;
+}
+
+
+void PixelKernels::SwapRedBlueScalar(const BYTE* src, BYTE* dst, UINT width)
+{
+    for (UINT x = 0; x < width; ++x)
+    {
+        const UINT pixel = Load(src + x * 4);
+        Store(dst + x * 4, (pixel & 0xFF00FF00) | ((pixel >> 16) & 0xFF) | ((pixel & 0xFF) << 16));
+    }
+}
+
+
+void PixelKernels::SwapRedBlueSSE2(const BYTE* src, BYTE* dst, UINT width)
+{
+    // SSE2 has no byte shuffle, so move the channels with 32-bit shifts and masks.
+    const __m128i greenAlpha = _mm_set1_epi32(0xFF00FF00);
+    const __m128i lowByte = _mm_set1_epi32(0x000000FF);
+
+    UINT x = 0;
+    for (; x + 4 <= width; x += 4)
+    {
+        const __m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x * 4));
+        const __m128i ga = _mm_and_si128(p, greenAlpha);
+        const __m128i r = _mm_and_si128(_mm_srli_epi32(p, 16), lowByte);
+        const __m128i b = _mm_slli_epi32(_mm_and_si128(p, lowByte), 16);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x * 4), _mm_or_si128(ga, _mm_or_si128(r, b)));
+    }
+
+    SwapRedBlueScalar(src + x * 4, dst + x * 4, width - x);
+}
+
+
+TARGET_AVX2
+void PixelKernels::SwapRedBlueAVX2(const BYTE* src, BYTE* dst, UINT width)
+{
+    const __m256i shuffle = _mm256_setr_epi8(
+        2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+        2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+
+    UINT x = 0;
+    for (; x + 8 <= width; x += 8)
+    {
+        const __m256i p = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + x * 4));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x * 4), _mm256_shuffle_epi8(p, shuffle));
+    }
+
+    SwapRedBlueSSE2(src + x * 4, dst + x * 4, width - x);
+}
+
+
+void PixelKernels::XorScalar(const BYTE* src1, const BYTE* src2, BYTE* dst, UINT width)
+{
+    for (UINT x = 0; x < width; ++x)
+    {
+        Store(dst + x * 4, Load(src1 + x * 4) ^ Load(src2 + x * 4));
+    }
+}
+
+
+void PixelKernels::XorSSE2(const BYTE* src1, const BYTE* src2, BYTE* dst, UINT width)
+{
+    UINT x = 0;
+    for (; x + 4 <= width; x += 4)
+    {
+        const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src1 + x * 4));
+        const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src2 + x * 4));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x * 4), _mm_xor_si128(a, b));
+    }
+
+    XorScalar(src1 + x * 4, src2 + x * 4, dst + x * 4, width - x);
+}
+
+
+TARGET_AVX2
+void PixelKernels::XorAVX2(const BYTE* src1, const BYTE* src2, BYTE* dst, UINT width)
+{
+    UINT x = 0;
+    for (; x + 8 <= width; x += 8)
+    {
+        const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src1 + x * 4));
+        const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src2 + x * 4));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x * 4), _mm256_xor_si256(a, b));
+    }
+
+    XorSSE2(src1 + x * 4, src2 + x * 4, dst + x * 4, width - x);
+}
+
+
+bool PixelKernels::HasAlphaScalar(const BYTE* src, UINT width)
+{
+    UINT alpha = 0;
+    for (UINT x = 0; x < width; ++x)
+    {
+        alpha |= Load(src + x * 4) & kAlphaMask;
+    }
+    return alpha != 0;
+}
+
+
+bool PixelKernels::HasAlphaSSE2(const BYTE* src, UINT width)
+{
+    __m128i alpha = _mm_setzero_si128();
+
+    UINT x = 0;
+    for (; x + 4 <= width; x += 4)
+    {
+        alpha = _mm_or_si128(alpha, _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x * 4)));
+    }
+
+    const __m128i alphaMask = _mm_set1_epi32(static_cast<int>(kAlphaMask));
+    const __m128i isZero = _mm_cmpeq_epi32(_mm_and_si128(alpha, alphaMask), _mm_setzero_si128());
+    if (_mm_movemask_epi8(isZero) != 0xFFFF) return true;
+
+    return HasAlphaScalar(src + x * 4, width - x);
+}
+
+
+TARGET_AVX2
+bool PixelKernels::HasAlphaAVX2(const BYTE* src, UINT width)
+{
+    __m256i alpha = _mm256_setzero_si256();
+
+    UINT x = 0;
+    for (; x + 8 <= width; x += 8)
+    {
+        alpha = _mm256_or_si256(alpha, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + x * 4)));
+    }
+
+    const __m256i alphaMask = _mm256_set1_epi32(static_cast<int>(kAlphaMask));
+    if (!_mm256_testz_si256(alpha, alphaMask)) return true;
+
+    return HasAlphaSSE2(src + x * 4, width - x);
+}
+
+
+void PixelKernels::CompositeCursorScalar(const BYTE* desktop, const BYTE* desktopWithCursor, const BYTE* cursor, BYTE* dst, UINT width)
+{
+    for (UINT x = 0; x < width; ++x)
+    {
+        const UINT c = Load(cursor + x * 4);
+        if (c & kAlphaMask)
+        {
+            Store(dst + x * 4, c);
+            continue;
+        }
+
+        const UINT d = Load(desktop + x * 4);
+        const UINT dc = Load(desktopWithCursor + x * 4);
+        const bool isCursor = ((d ^ dc) & kColorMask) != 0;
+        Store(dst + x * 4, (dc & kColorMask) | (isCursor ? kAlphaMask : 0));
+    }
+}
+
+
+void PixelKernels::CompositeCursorSSE2(const BYTE* desktop, const BYTE* desktopWithCursor, const BYTE* cursor, BYTE* dst, UINT width)
+{
+    const __m128i colorMask = _mm_set1_epi32(kColorMask);
+    const __m128i alphaMask = _mm_set1_epi32(static_cast<int>(kAlphaMask));
+    const __m128i zero = _mm_setzero_si128();
+
+    UINT x = 0;
+    for (; x + 4 <= width; x += 4)
+    {
+        const __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(desktop + x * 4));
+        const __m128i dc = _mm_loadu_si128(reinterpret_cast<const __m128i*>(desktopWithCursor + x * 4));
+        const __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cursor + x * 4));
+
+        const __m128i isTransparent = _mm_cmpeq_epi32(_mm_and_si128(c, alphaMask), zero);
+        const __m128i isUnchanged = _mm_cmpeq_epi32(_mm_and_si128(_mm_xor_si128(d, dc), colorMask), zero);
+        const __m128i composite = _mm_or_si128(_mm_and_si128(dc, colorMask), _mm_andnot_si128(isUnchanged, alphaMask));
+        const __m128i result = _mm_or_si128(_mm_and_si128(isTransparent, composite), _mm_andnot_si128(isTransparent, c));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x * 4), result);
+    }
+
+    CompositeCursorScalar(desktop + x * 4, desktopWithCursor + x * 4, cursor + x * 4, dst + x * 4, width - x);
+}
+
+
+TARGET_AVX2
+void PixelKernels::CompositeCursorAVX2(const BYTE* desktop, const BYTE* desktopWithCursor, const BYTE* cursor, BYTE* dst, UINT width)
+{
+    const __m256i colorMask = _mm256_set1_epi32(kColorMask);
+    const __m256i alphaMask = _mm256_set1_epi32(static_cast<int>(kAlphaMask));
+    const __m256i zero = _mm256_setzero_si256();
+
+    UINT x = 0;
+    for (; x + 8 <= width; x += 8)
+    {
+        const __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(desktop + x * 4));
+        const __m256i dc = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(desktopWithCursor + x * 4));
+        const __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(cursor + x * 4));
+
+        const __m256i isTransparent = _mm256_cmpeq_epi32(_mm256_and_si256(c, alphaMask), zero);
+        const __m256i isUnchanged = _mm256_cmpeq_epi32(_mm256_and_si256(_mm256_xor_si256(d, dc), colorMask), zero);
+        const __m256i composite = _mm256_or_si256(_mm256_and_si256(dc, colorMask), _mm256_andnot_si256(isUnchanged, alphaMask));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x * 4), _mm256_blendv_epi8(c, composite, isTransparent));
+    }
+
+    CompositeCursorSSE2(desktop + x * 4, desktopWithCursor + x * 4, cursor + x * 4, dst + x * 4, width - x);
+}
+
+
+void PixelKernels::ApplyCursorMaskScalar(const BYTE* color, const BYTE* mask, BYTE* dst, UINT width)
+{
+    for (UINT x = 0; x < width; ++x)
+    {
+        const UINT c = Load(color + x * 4) & kColorMask;
+        const bool isMasked = (Load(mask + x * 4) & kColorMask) != 0;
+        if (!isMasked)
+        {
+            Store(dst + x * 4, c | kAlphaMask);
+        }
+        else
+        {
+            Store(dst + x * 4, c != 0 ? kAlphaMask : 0);
+        }
+    }
+}
+
+
+void PixelKernels::ApplyCursorMaskSSE2(const BYTE* color, const BYTE* mask, BYTE* dst, UINT width)
+{
+    const __m128i colorMask = _mm_set1_epi32(kColorMask);
+    const __m128i alphaMask = _mm_set1_epi32(static_cast<int>(kAlphaMask));
+    const __m128i zero = _mm_setzero_si128();
+
+    UINT x = 0;
+    for (; x + 4 <= width; x += 4)
+    {
+        const __m128i c = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(color + x * 4)), colorMask);
+        const __m128i m = _mm_loadu_si128(reinterpret_cast<const __m128i*>(mask + x * 4));
+
+        // Opaque unless the pixel is masked and black.
+        const __m128i isUnmasked = _mm_cmpeq_epi32(_mm_and_si128(m, colorMask), zero);
+        const __m128i isBlack = _mm_cmpeq_epi32(c, zero);
+        const __m128i isTransparent = _mm_andnot_si128(isUnmasked, isBlack);
+        const __m128i result = _mm_or_si128(_mm_and_si128(isUnmasked, c), _mm_andnot_si128(isTransparent, alphaMask));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x * 4), result);
+    }
+
+    ApplyCursorMaskScalar(color + x * 4, mask + x * 4, dst + x * 4, width - x);
+}
+
+
+TARGET_AVX2
+void PixelKernels::ApplyCursorMaskAVX2(const BYTE* color, const BYTE* mask, BYTE* dst, UINT width)
+{
+    const __m256i colorMask = _mm256_set1_epi32(kColorMask);
+    const __m256i alphaMask = _mm256_set1_epi32(static_cast<int>(kAlphaMask));
+    const __m256i zero = _mm256_setzero_si256();
+
+    UINT x = 0;
+    for (; x + 8 <= width; x += 8)
+    {
+        const __m256i c = _mm256_and_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(color + x * 4)), colorMask);
+        const __m256i m = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(mask + x * 4));
+
+        const __m256i isUnmasked = _mm256_cmpeq_epi32(_mm256_and_si256(m, colorMask), zero);
+        const __m256i isBlack = _mm256_cmpeq_epi32(c, zero);
+        const __m256i isTransparent = _mm256_andnot_si256(isUnmasked, isBlack);
+        const __m256i result = _mm256_or_si256(_mm256_and_si256(isUnmasked, c), _mm256_andnot_si256(isTransparent, alphaMask));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x * 4), result);
+    }
+
+    ApplyCursorMaskSSE2(color + x * 4, mask + x * 4, dst + x * 4, width - x);
+}
+
+
+void PixelKernels::AccumulateRowScalar(const BYTE* src, float weight, float* dst, UINT count)
+{
+    for (UINT i = 0; i < count; ++i)
+    {
+        dst[i] += static_cast<float>(src[i]) * weight;
+    }
+}
+
+
+void PixelKernels::AccumulateRowSSE2(const BYTE* src, float weight, float* dst, UINT count)
+{
+    const __m128 w = _mm_set1_ps(weight);
+    const __m128i zero = _mm_setzero_si128();
+
+    UINT i = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+        const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        const __m128i lo = _mm_unpacklo_epi8(bytes, zero);
+        const __m128i hi = _mm_unpackhi_epi8(bytes, zero);
+        const __m128i values[4] =
+        {
+            _mm_unpacklo_epi16(lo, zero),
+            _mm_unpackhi_epi16(lo, zero),
+            _mm_unpacklo_epi16(hi, zero),
+            _mm_unpackhi_epi16(hi, zero),
+        };
+        for (int j = 0; j < 4; ++j)
+        {
+            float* out = dst + i + j * 4;
+            _mm_storeu_ps(out, _mm_add_ps(_mm_loadu_ps(out), _mm_mul_ps(_mm_cvtepi32_ps(values[j]), w)));
+        }
+    }
+
+    AccumulateRowScalar(src + i, weight, dst + i, count - i);
+}
+
+
+TARGET_AVX2
+void PixelKernels::AccumulateRowAVX2(const BYTE* src, float weight, float* dst, UINT count)
+{
+    const __m256 w = _mm256_set1_ps(weight);
+
+    UINT i = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+        const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        const __m256 lo = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(bytes));
+        const __m256 hi = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_srli_si128(bytes, 8)));
+        _mm256_storeu_ps(dst + i, _mm256_add_ps(_mm256_loadu_ps(dst + i), _mm256_mul_ps(lo, w)));
+        _mm256_storeu_ps(dst + i + 8, _mm256_add_ps(_mm256_loadu_ps(dst + i + 8), _mm256_mul_ps(hi, w)));
+    }
+
+    AccumulateRowSSE2(src + i, weight, dst + i, count - i);
+}
+
+
+void PixelKernels::FilterRowScalar(const float* src, const UINT* starts, const float* weights, UINT tapCount, BYTE* dst, UINT width)
+{
+    for (UINT x = 0; x < width; ++x)
+    {
+        const float* in = src + starts[x] * 4;
+        const float* w = weights + x * tapCount;
+        for (UINT c = 0; c < 4; ++c)
+        {
+            float sum = 0.f;
+            for (UINT i = 0; i < tapCount; ++i)
+            {
+                sum = sum + in[i * 4 + c] * w[i];
+            }
+            // Truncating after adding 0.5 rounds the same way as the SIMD variants.
+            const int value = static_cast<int>(sum + 0.5f);
+            dst[x * 4 + c] = static_cast<BYTE>(value < 0 ? 0 : value > 255 ? 255 : value);
+        }
+    }
+}
+
+
+void PixelKernels::FilterRowSSE2(const float* src, const UINT* starts, const float* weights, UINT tapCount, BYTE* dst, UINT width)
+{
+    // One pixel is one vector, so every tap is a single multiply-add for all four channels.
+    const __m128 half = _mm_set1_ps(0.5f);
+
+    UINT x = 0;
+    for (; x + 4 <= width; x += 4)
+    {
+        __m128i values[4];
+        for (int j = 0; j < 4; ++j)
+        {
+            const float* in = src + starts[x + j] * 4;
+            const float* w = weights + (x + j) * tapCount;
+            __m128 sum = _mm_setzero_ps();
+            for (UINT i = 0; i < tapCount; ++i)
+            {
+                sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(in + i * 4), _mm_set1_ps(w[i])));
+            }
+            values[j] = _mm_cvttps_epi32(_mm_add_ps(sum, half));
+        }
+        const __m128i packed = _mm_packus_epi16(_mm_packs_epi32(values[0], values[1]), _mm_packs_epi32(values[2], values[3]));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x * 4), packed);
+    }
+
+    FilterRowScalar(src, starts + x, weights + x * tapCount, tapCount, dst + x * 4, width - x);
+}
+
+
+TARGET_AVX2
+void PixelKernels::FilterRowAVX2(const float* src, const UINT* starts, const float* weights, UINT tapCount, BYTE* dst, UINT width)
+{
+    // Two pixels per vector, one in each 128-bit lane.
+    const __m256 half = _mm256_set1_ps(0.5f);
+
+    UINT x = 0;
+    for (; x + 4 <= width; x += 4)
+    {
+        __m256i values[2];
+        for (int j = 0; j < 2; ++j)
+        {
+            const float* in0 = src + starts[x + j * 2] * 4;
+            const float* in1 = src + starts[x + j * 2 + 1] * 4;
+            const float* w0 = weights + (x + j * 2) * tapCount;
+            const float* w1 = w0 + tapCount;
+            __m256 sum = _mm256_setzero_ps();
+            for (UINT i = 0; i < tapCount; ++i)
+            {
+                const __m256 in = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(in0 + i * 4)), _mm_loadu_ps(in1 + i * 4), 1);
+                const __m256 w = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_set1_ps(w0[i])), _mm_set1_ps(w1[i]), 1);
+                sum = _mm256_add_ps(sum, _mm256_mul_ps(in, w));
+            }
+            values[j] = _mm256_cvttps_epi32(_mm256_add_ps(sum, half));
+        }
+        // The packs work per lane, so the pixels come out as 0, 2, 1, 3 and are put back in order.
+        const __m256i packed16 = _mm256_packs_epi32(values[0], values[1]);
+        const __m128i packed = _mm_packus_epi16(_mm256_castsi256_si128(packed16), _mm256_extracti128_si256(packed16, 1));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x * 4), _mm_shuffle_epi32(packed, _MM_SHUFFLE(3, 1, 2, 0)));
+    }
+
+    FilterRowScalar(src, starts + x, weights + x * tapCount, tapCount, dst + x * 4, width - x);
+}
+
+
+void PixelKernels::Downsample2xScalar(const BYTE* src0, const BYTE* src1, BYTE* dst, UINT width)
+{
+    for (UINT x = 0; x < width; ++x)
+    {
+        const BYTE* a = src0 + x * 8;
+        const BYTE* b = src1 + x * 8;
+        for (UINT c = 0; c < 4; ++c)
+        {
+            dst[x * 4 + c] = static_cast<BYTE>((a[c] + a[c + 4] + b[c] + b[c + 4] + 2) >> 2);
+        }
+    }
+}
+
+
+void PixelKernels::Downsample2xSSE2(const BYTE* src0, const BYTE* src1, BYTE* dst, UINT width)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i two = _mm_set1_epi16(2);
+
+    // Sums two pixels of each row per 64-bit half, then adds the horizontal neighbors.
+    const auto sumPairs = [&](const BYTE* a, const BYTE* b) -> __m128i
+    {
+        const __m128i rowA = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a));
+        const __m128i rowB = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b));
+        const __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(rowA, zero), _mm_unpacklo_epi8(rowB, zero));
+        const __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(rowA, zero), _mm_unpackhi_epi8(rowB, zero));
+        const __m128i sum = _mm_add_epi16(_mm_unpacklo_epi64(lo, hi), _mm_unpackhi_epi64(lo, hi));
+        return _mm_srli_epi16(_mm_add_epi16(sum, two), 2);
+    };
+
+    UINT x = 0;
+    for (; x + 4 <= width; x += 4)
+    {
+        const __m128i first = sumPairs(src0 + x * 8, src1 + x * 8);
+        const __m128i second = sumPairs(src0 + x * 8 + 16, src1 + x * 8 + 16);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x * 4), _mm_packus_epi16(first, second));
+    }
+
+    Downsample2xScalar(src0 + x * 8, src1 + x * 8, dst + x * 4, width - x);
+}
+
+
+TARGET_AVX2
+void PixelKernels::Downsample2xAVX2(const BYTE* src0, const BYTE* src1, BYTE* dst, UINT width)
+{
+    const __m256i two = _mm256_set1_epi16(2);
+
+    // The lanes hold outputs 0, 2, 4, 6 | 1, 3, 5, 7 after packing.
+    const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+
+    UINT x = 0;
+    for (; x + 8 <= width; x += 8)
+    {
+        // Each load widens 4 pixels into the two lanes (pixels 0, 1 | 2, 3).
+        __m256i sums[4];
+        for (int i = 0; i < 4; ++i)
+        {
+            const __m256i a = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src0 + x * 8 + i * 16)));
+            const __m256i b = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src1 + x * 8 + i * 16)));
+            sums[i] = _mm256_add_epi16(a, b);
+        }
+
+        const __m256i first = _mm256_add_epi16(_mm256_unpacklo_epi64(sums[0], sums[1]), _mm256_unpackhi_epi64(sums[0], sums[1]));
+        const __m256i second = _mm256_add_epi16(_mm256_unpacklo_epi64(sums[2], sums[3]), _mm256_unpackhi_epi64(sums[2], sums[3]));
+        const __m256i packed = _mm256_packus_epi16(
+            _mm256_srli_epi16(_mm256_add_epi16(first, two), 2),
+            _mm256_srli_epi16(_mm256_add_epi16(second, two), 2));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x * 4), _mm256_permutevar8x32_epi32(packed, order));
+    }
+
+    Downsample2xSSE2(src0 + x * 8, src1 + x * 8, dst + x * 4, width - x);
+}
+
+
+void PixelKernels::WeightedSumScalar(const BYTE* src, BYTE* dst, UINT step, UINT width, const ColorWeights& weights)
+{
+    for (UINT x = 0; x < width; ++x, src += 4, dst += step)
+    {
+        const int sum = weights.b * src[0] + weights.g * src[1] + weights.r * src[2];
+        const int value = ((sum + 128) >> 8) + weights.offset;
+        *dst = static_cast<BYTE>(value < 0 ? 0 : value > 255 ? 255 : value);
+    }
+}
+
+
+void PixelKernels::WeightedSumSSE2(const BYTE* src, BYTE* dst, UINT step, UINT width, const ColorWeights& weights)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i coefficients = _mm_setr_epi16(
+        static_cast<short>(weights.b), static_cast<short>(weights.g), static_cast<short>(weights.r), 0,
+        static_cast<short>(weights.b), static_cast<short>(weights.g), static_cast<short>(weights.r), 0);
+    const __m128i half = _mm_set1_epi32(128);
+    const __m128i offset = _mm_set1_epi32(weights.offset);
+
+    UINT x = 0;
+    for (; x + 8 <= width; x += 8)
+    {
+        __m128i sums[2];
+        for (int i = 0; i < 2; ++i)
+        {
+            // pmaddwd leaves B*b + G*g and R*r in neighboring lanes, so add the even lanes to the odd ones.
+            const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x * 4 + i * 16));
+            const __m128 lo = _mm_castsi128_ps(_mm_madd_epi16(_mm_unpacklo_epi8(pixels, zero), coefficients));
+            const __m128 hi = _mm_castsi128_ps(_mm_madd_epi16(_mm_unpackhi_epi8(pixels, zero), coefficients));
+            const __m128i even = _mm_castps_si128(_mm_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0)));
+            const __m128i odd = _mm_castps_si128(_mm_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1)));
+            const __m128i sum = _mm_add_epi32(_mm_add_epi32(even, odd), half);
+            sums[i] = _mm_add_epi32(_mm_srai_epi32(sum, 8), offset);
+        }
+
+        // Both packs saturate, which clamps the results to a byte.
+        const __m128i packed = _mm_packus_epi16(_mm_packs_epi32(sums[0], sums[1]), zero);
+        if (step == 1)
+        {
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(dst + x), packed);
+        }
+        else
+        {
+            alignas(16) BYTE values[16];
+            _mm_store_si128(reinterpret_cast<__m128i*>(values), packed);
+            for (UINT i = 0; i < 8; ++i)
+            {
+                dst[(x + i) * step] = values[i];
+            }
+        }
+    }
+
+    WeightedSumScalar(src + x * 4, dst + x * step, step, width - x, weights);
+}
+
+
+TARGET_AVX2
+void PixelKernels::WeightedSumAVX2(const BYTE* src, BYTE* dst, UINT step, UINT width, const ColorWeights& weights)
+{
+    const __m256i coefficients = _mm256_setr_epi16(
+        static_cast<short>(weights.b), static_cast<short>(weights.g), static_cast<short>(weights.r), 0,
+        static_cast<short>(weights.b), static_cast<short>(weights.g), static_cast<short>(weights.r), 0,
+        static_cast<short>(weights.b), static_cast<short>(weights.g), static_cast<short>(weights.r), 0,
+        static_cast<short>(weights.b), static_cast<short>(weights.g), static_cast<short>(weights.r), 0);
+    const __m256i half = _mm256_set1_epi32(128);
+    const __m256i offset = _mm256_set1_epi32(weights.offset);
+
+    // After packing, the 16-bit pairs hold outputs 0, 4, 8, 12 | 2, 6, 10, 14 (and the odd ones after each).
+    const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+
+    UINT x = 0;
+    for (; x + 16 <= width; x += 16)
+    {
+        __m256i sums[2];
+        for (int i = 0; i < 2; ++i)
+        {
+            // Each widened load holds pixels 0, 1 | 2, 3 of its 4 pixels.
+            const BYTE* p = src + x * 4 + i * 32;
+            const __m256 lo = _mm256_castsi256_ps(_mm256_madd_epi16(
+                _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p))), coefficients));
+            const __m256 hi = _mm256_castsi256_ps(_mm256_madd_epi16(
+                _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 16))), coefficients));
+            const __m256i even = _mm256_castps_si256(_mm256_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0)));
+            const __m256i odd = _mm256_castps_si256(_mm256_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1)));
+            const __m256i sum = _mm256_add_epi32(_mm256_add_epi32(even, odd), half);
+            sums[i] = _mm256_add_epi32(_mm256_srai_epi32(sum, 8), offset);
+        }
+
+        const __m256i words = _mm256_permutevar8x32_epi32(_mm256_packs_epi32(sums[0], sums[1]), order);
+        const __m128i packed = _mm_packus_epi16(_mm256_castsi256_si128(words), _mm256_extracti128_si256(words, 1));
+        if (step == 1)
+        {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), packed);
+        }
+        else
+        {
+            alignas(16) BYTE values[16];
+            _mm_store_si128(reinterpret_cast<__m128i*>(values), packed);
+            for (UINT i = 0; i < 16; ++i)
+            {
+                dst[(x + i) * step] = values[i];
+            }
+        }
+    }
+
+    WeightedSumSSE2(src + x * 4, dst + x * step, step, width - x, weights);
+}
+
+
+void PixelKernels::ToRGB565Scalar(const BYTE* src, BYTE* dst, UINT width)
+{
+    for (UINT x = 0; x < width; ++x)
+    {
+        const UINT pixel = Load(src + x * 4);
+        const USHORT value = static_cast<USHORT>(((pixel >> 8) & 0xF800) | ((pixel >> 5) & 0x07E0) | ((pixel >> 3) & 0x001F));
+        memcpy(dst + x * 2, &value, 2);
+    }
+}
+
+
+void PixelKernels::ToRGB565SSE2(const BYTE* src, BYTE* dst, UINT width)
+{
+    const __m128i redMask = _mm_set1_epi32(0xF800);
+    const __m128i greenMask = _mm_set1_epi32(0x07E0);
+    const __m128i blueMask = _mm_set1_epi32(0x001F);
+
+    // packs_epi32 saturates, so sign-extend the 16-bit values first to keep their bits.
+    const auto pack = [&](__m128i pixels) -> __m128i
+    {
+        const __m128i value = _mm_or_si128(
+            _mm_or_si128(_mm_and_si128(_mm_srli_epi32(pixels, 8), redMask), _mm_and_si128(_mm_srli_epi32(pixels, 5), greenMask)),
+            _mm_and_si128(_mm_srli_epi32(pixels, 3), blueMask));
+        return _mm_srai_epi32(_mm_slli_epi32(value, 16), 16);
+    };
+
+    UINT x = 0;
+    for (; x + 8 <= width; x += 8)
+    {
+        const __m128i first = pack(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x * 4)));
+        const __m128i second = pack(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x * 4 + 16)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x * 2), _mm_packs_epi32(first, second));
+    }
+
+    ToRGB565Scalar(src + x * 4, dst + x * 2, width - x);
+}
+
+
+TARGET_AVX2
+void PixelKernels::ToRGB565AVX2(const BYTE* src, BYTE* dst, UINT width)
+{
+    const __m256i redMask = _mm256_set1_epi32(0xF800);
+    const __m256i greenMask = _mm256_set1_epi32(0x07E0);
+    const __m256i blueMask = _mm256_set1_epi32(0x001F);
+
+    UINT x = 0;
+    for (; x + 16 <= width; x += 16)
+    {
+        __m256i values[2];
+        for (int i = 0; i < 2; ++i)
+        {
+            const __m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + x * 4 + i * 32));
+            const __m256i value = _mm256_or_si256(
+                _mm256_or_si256(_mm256_and_si256(_mm256_srli_epi32(pixels, 8), redMask), _mm256_and_si256(_mm256_srli_epi32(pixels, 5), greenMask)),
+                _mm256_and_si256(_mm256_srli_epi32(pixels, 3), blueMask));
+            values[i] = _mm256_srai_epi32(_mm256_slli_epi32(value, 16), 16);
+        }
+
+        // Packing works per lane, leaving pixels 0-3, 8-11 | 4-7, 12-15.
+        const __m256i packed = _mm256_packs_epi32(values[0], values[1]);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x * 2), _mm256_permute4x64_epi64(packed, _MM_SHUFFLE(3, 1, 2, 0)));
+    }
+
+    ToRGB565SSE2(src + x * 4, dst + x * 2, width - x);
+}
+
+
+void PixelKernels::ToRGBA16FScalar(const BYTE* src, BYTE* dst, UINT width)
+{
+    static const HalfTable table;
+
+    for (UINT x = 0; x < width; ++x, src += 4, dst += 8)
+    {
+        const USHORT values[4] = { table.values[src[2]], table.values[src[1]], table.values[src[0]], table.values[src[3]] };
+        memcpy(dst, values, 8);
+    }
+}
+
+
+TARGET_AVX2
+void PixelKernels::ToRGBA16FAVX2(const BYTE* src, BYTE* dst, UINT width)
+{
+    const __m128i toRGBA = _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+    const __m256 scale = _mm256_set1_ps(1.f / 255.f);
+
+    UINT x = 0;
+    for (; x + 4 <= width; x += 4)
+    {
+        const __m128i pixels = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x * 4)), toRGBA);
+        const __m256 lo = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(pixels)), scale);
+        const __m256 hi = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_srli_si128(pixels, 8))), scale);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x * 8), _mm256_cvtps_ph(lo, _MM_FROUND_TO_NEAREST_INT));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x * 8 + 16), _mm256_cvtps_ph(hi, _MM_FROUND_TO_NEAREST_INT));
+    }
+
+    ToRGBA16FScalar(src + x * 4, dst + x * 8, width - x);
+}
+
+
+void PixelKernels::PremultiplyScalar(const BYTE* src, BYTE* dst, UINT width)
+{
+    for (UINT x = 0; x < width; ++x, src += 4, dst += 4)
+    {
+        const UINT a = src[3];
+        for (UINT c = 0; c < 3; ++c)
+        {
+            // Exact rounding of v / 255 for v in [0, 255 * 255].
+            const UINT v = src[c] * a + 128;
+            dst[c] = static_cast<BYTE>((v + (v >> 8)) >> 8);
+        }
+        dst[3] = static_cast<BYTE>(a);
+    }
+}
+
+
+void PixelKernels::PremultiplySSE2(const BYTE* src, BYTE* dst, UINT width)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i half = _mm_set1_epi16(128);
+
+    // Multiplying alpha by 255 and dividing it by 255 keeps it unchanged.
+    const __m128i alphaFactor = _mm_setr_epi16(0, 0, 0, 255, 0, 0, 0, 255);
+
+    const auto multiply = [&](__m128i pixels) -> __m128i
+    {
+        __m128i factors = _mm_shufflehi_epi16(_mm_shufflelo_epi16(pixels, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+        factors = _mm_or_si128(factors, alphaFactor);
+        const __m128i v = _mm_add_epi16(_mm_mullo_epi16(pixels, factors), half);
+        return _mm_srli_epi16(_mm_add_epi16(v, _mm_srli_epi16(v, 8)), 8);
+    };
+
+    UINT x = 0;
+    for (; x + 4 <= width; x += 4)
+    {
+        const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x * 4));
+        const __m128i lo = multiply(_mm_unpacklo_epi8(pixels, zero));
+        const __m128i hi = multiply(_mm_unpackhi_epi8(pixels, zero));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x * 4), _mm_packus_epi16(lo, hi));
+    }
+
+    PremultiplyScalar(src + x * 4, dst + x * 4, width - x);
+}
+
+
+TARGET_AVX2
+void PixelKernels::PremultiplyAVX2(const BYTE* src, BYTE* dst, UINT width)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i half = _mm256_set1_epi16(128);
+    const __m256i alphaFactor = _mm256_setr_epi16(0, 0, 0, 255, 0, 0, 0, 255, 0, 0, 0, 255, 0, 0, 0, 255);
+
+    UINT x = 0;
+    for (; x + 8 <= width; x += 8)
+    {
+        // Unpacking and packing both work per lane, so the pixels come back in order.
+        const __m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + x * 4));
+        __m256i words[2] = { _mm256_unpacklo_epi8(pixels, zero), _mm256_unpackhi_epi8(pixels, zero) };
+        for (int i = 0; i < 2; ++i)
+        {
+            __m256i factors = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(words[i], _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+            factors = _mm256_or_si256(factors, alphaFactor);
+            const __m256i v = _mm256_add_epi16(_mm256_mullo_epi16(words[i], factors), half);
+            words[i] = _mm256_srli_epi16(_mm256_add_epi16(v, _mm256_srli_epi16(v, 8)), 8);
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x * 4), _mm256_packus_epi16(words[0], words[1]));
+    }
+
+    PremultiplySSE2(src + x * 4, dst + x * 4, width - x);
+}
+
+
+void PixelKernels::UnpremultiplyScalar(const BYTE* src, BYTE* dst, UINT width)
+{
+    for (UINT x = 0; x < width; ++x, src += 4, dst += 4)
+    {
+        const BYTE a = src[3];
+        if (a == 0)
+        {
+            Store(dst, 0);
+            continue;
+        }
+
+        // Float division keeps the SIMD variants exact; the operations are in the same order there.
+        const float alpha = static_cast<float>(a);
+        for (UINT c = 0; c < 3; ++c)
+        {
+            const int value = static_cast<int>(static_cast<float>(src[c]) * 255.f / alpha + 0.5f);
+            dst[c] = static_cast<BYTE>(value > 255 ? 255 : value);
+        }
+        dst[3] = a;
+    }
+}
+
+
+void PixelKernels::UnpremultiplySSE2(const BYTE* src, BYTE* dst, UINT width)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i alphaMask = _mm_setr_epi32(0, 0, 0, -1);
+    const __m128 zeroFloat = _mm_setzero_ps();
+    const __m128 scale = _mm_set1_ps(255.f);
+    const __m128 half = _mm_set1_ps(0.5f);
+
+    // Takes one pixel in 32-bit lanes. The alpha lane is replaced by the source alpha.
+    const auto divide = [&](__m128i pixel) -> __m128i
+    {
+        const __m128 values = _mm_cvtepi32_ps(pixel);
+        const __m128 alpha = _mm_shuffle_ps(values, values, _MM_SHUFFLE(3, 3, 3, 3));
+        const __m128 result = _mm_add_ps(_mm_div_ps(_mm_mul_ps(values, scale), alpha), half);
+        const __m128i color = _mm_andnot_si128(_mm_castps_si128(_mm_cmpeq_ps(alpha, zeroFloat)), _mm_cvttps_epi32(result));
+        return _mm_or_si128(_mm_andnot_si128(alphaMask, color), _mm_and_si128(alphaMask, pixel));
+    };
+
+    UINT x = 0;
+    for (; x + 4 <= width; x += 4)
+    {
+        const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x * 4));
+        const __m128i lo = _mm_unpacklo_epi8(pixels, zero);
+        const __m128i hi = _mm_unpackhi_epi8(pixels, zero);
+        const __m128i first = _mm_packs_epi32(divide(_mm_unpacklo_epi16(lo, zero)), divide(_mm_unpackhi_epi16(lo, zero)));
+        const __m128i second = _mm_packs_epi32(divide(_mm_unpacklo_epi16(hi, zero)), divide(_mm_unpackhi_epi16(hi, zero)));
+
+        // packus clamps the colors above 255.
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x * 4), _mm_packus_epi16(first, second));
+    }
+
+    UnpremultiplyScalar(src + x * 4, dst + x * 4, width - x);
+}
+
+
+TARGET_AVX2
+void PixelKernels::UnpremultiplyAVX2(const BYTE* src, BYTE* dst, UINT width)
+{
+    const __m256i alphaMask = _mm256_setr_epi32(0, 0, 0, -1, 0, 0, 0, -1);
+    const __m256 zeroFloat = _mm256_setzero_ps();
+    const __m256 scale = _mm256_set1_ps(255.f);
+    const __m256 half = _mm256_set1_ps(0.5f);
+
+    // The packs leave pixels 0, 2, 4, 6 | 1, 3, 5, 7.
+    const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+
+    UINT x = 0;
+    for (; x + 8 <= width; x += 8)
+    {
+        // Each vector holds two pixels in 32-bit lanes.
+        __m256i results[4];
+        for (int i = 0; i < 4; ++i)
+        {
+            const __m256i pixel = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(src + x * 4 + i * 8)));
+            const __m256 values = _mm256_cvtepi32_ps(pixel);
+            const __m256 alpha = _mm256_shuffle_ps(values, values, _MM_SHUFFLE(3, 3, 3, 3));
+            const __m256 result = _mm256_add_ps(_mm256_div_ps(_mm256_mul_ps(values, scale), alpha), half);
+            const __m256i color = _mm256_andnot_si256(_mm256_castps_si256(_mm256_cmp_ps(alpha, zeroFloat, _CMP_EQ_OQ)), _mm256_cvttps_epi32(result));
+            results[i] = _mm256_or_si256(_mm256_andnot_si256(alphaMask, color), _mm256_and_si256(alphaMask, pixel));
+        }
+
+        const __m256i packed = _mm256_packus_epi16(_mm256_packs_epi32(results[0], results[1]), _mm256_packs_epi32(results[2], results[3]));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x * 4), _mm256_permutevar8x32_epi32(packed, order));
+    }
+
+    UnpremultiplySSE2(src + x * 4, dst + x * 4, width - x);
+}
+
+
+void PixelKernels::ReverseRowScalar(const BYTE* src, BYTE* dst, UINT width)
+{
+    for (UINT x = 0; x < width; ++x)
+    {
+        Store(dst + x * 4, Load(src + (width - 1 - x) * 4));
+    }
+}
+
+
+void PixelKernels::ReverseRowSSE2(const BYTE* src, BYTE* dst, UINT width)
+{
+    UINT x = 0;
+    for (; x + 4 <= width; x += 4)
+    {
+        const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + (width - 4 - x) * 4));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x * 4), _mm_shuffle_epi32(pixels, _MM_SHUFFLE(0, 1, 2, 3)));
+    }
+
+    ReverseRowScalar(src, dst + x * 4, width - x);
+}
+
+
+TARGET_AVX2
+void PixelKernels::ReverseRowAVX2(const BYTE* src, BYTE* dst, UINT width)
+{
+    const __m256i reverse = _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0);
+
+    UINT x = 0;
+    for (; x + 8 <= width; x += 8)
+    {
+        const __m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + (width - 8 - x) * 4));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x * 4), _mm256_permutevar8x32_epi32(pixels, reverse));
+    }
+
+    ReverseRowSSE2(src, dst + x * 4, width - x);
+}
+
+
+void PixelKernels::TransposeScalar(const BYTE* src, int srcStride, BYTE* dst, int dstStride, UINT width, UINT height)
+{
+    for (UINT ty = 0; ty < height; ty += kTransposeTileSize)
+    {
+        const UINT tileHeight = std::min<UINT>(kTransposeTileSize, height - ty);
+        for (UINT tx = 0; tx < width; tx += kTransposeTileSize)
+        {
+            const UINT tileWidth = std::min<UINT>(kTransposeTileSize, width - tx);
+            for (UINT y = ty; y < ty + tileHeight; ++y)
+            {
+                const BYTE* in = src + static_cast<ptrdiff_t>(y) * srcStride;
+                for (UINT x = tx; x < tx + tileWidth; ++x)
+                {
+                    Store(dst + static_cast<ptrdiff_t>(x) * dstStride + y * 4, Load(in + x * 4));
+                }
+            }
+        }
+    }
+}
+
+
+void PixelKernels::TransposeSSE2(const BYTE* src, int srcStride, BYTE* dst, int dstStride, UINT width, UINT height)
+{
+    for (UINT ty = 0; ty < height; ty += kTransposeTileSize)
+    {
+        const UINT tileHeight = std::min<UINT>(kTransposeTileSize, height - ty);
+        for (UINT tx = 0; tx < width; tx += kTransposeTileSize)
+        {
+            const UINT tileWidth = std::min<UINT>(kTransposeTileSize, width - tx);
+            const BYTE* tileSrc = src + static_cast<ptrdiff_t>(ty) * srcStride + tx * 4;
+            BYTE* tileDst = dst + static_cast<ptrdiff_t>(tx) * dstStride + ty * 4;
+
+            // 4x4 blocks: two rounds of unpacking turn 4 rows into 4 columns.
+            UINT y = 0;
+            for (; y + 4 <= tileHeight; y += 4)
+            {
+                UINT x = 0;
+                for (; x + 4 <= tileWidth; x += 4)
+                {
+                    const BYTE* in = tileSrc + static_cast<ptrdiff_t>(y) * srcStride + x * 4;
+                    const __m128i r0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+                    const __m128i r1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + srcStride));
+                    const __m128i r2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + srcStride * 2));
+                    const __m128i r3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + srcStride * 3));
+                    const __m128i t0 = _mm_unpacklo_epi32(r0, r1);
+                    const __m128i t1 = _mm_unpacklo_epi32(r2, r3);
+                    const __m128i t2 = _mm_unpackhi_epi32(r0, r1);
+                    const __m128i t3 = _mm_unpackhi_epi32(r2, r3);
+
+                    BYTE* out = tileDst + static_cast<ptrdiff_t>(x) * dstStride + y * 4;
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_unpacklo_epi64(t0, t1));
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + dstStride), _mm_unpackhi_epi64(t0, t1));
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + dstStride * 2), _mm_unpacklo_epi64(t2, t3));
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + dstStride * 3), _mm_unpackhi_epi64(t2, t3));
+                }
+
+                TransposeScalar(
+                    tileSrc + static_cast<ptrdiff_t>(y) * srcStride + x * 4, srcStride,
+                    tileDst + static_cast<ptrdiff_t>(x) * dstStride + y * 4, dstStride,
+                    tileWidth - x, 4);
+            }
+
+            TransposeScalar(tileSrc + static_cast<ptrdiff_t>(y) * srcStride, srcStride, tileDst + y * 4, dstStride, tileWidth, tileHeight - y);
+        }
+    }
+}
+
+
+TARGET_AVX2
+void PixelKernels::TransposeAVX2(const BYTE* src, int srcStride, BYTE* dst, int dstStride, UINT width, UINT height)
+{
+    for (UINT ty = 0; ty < height; ty += kTransposeTileSize)
+    {
+        const UINT tileHeight = std::min<UINT>(kTransposeTileSize, height - ty);
+        for (UINT tx = 0; tx < width; tx += kTransposeTileSize)
+        {
+            const UINT tileWidth = std::min<UINT>(kTransposeTileSize, width - tx);
+            const BYTE* tileSrc = src + static_cast<ptrdiff_t>(ty) * srcStride + tx * 4;
+            BYTE* tileDst = dst + static_cast<ptrdiff_t>(tx) * dstStride + ty * 4;
+
+            // 8x8 blocks: each vector holds 4 pixels of row i in its low lane and of row i + 4 in its
+            // high lane, so the 4x4 transposes of the SSE2 variant produce whole destination rows.
+            // The fallbacks are only called for partial blocks, since they mix in SSE2 code.
+            const ptrdiff_t lower = static_cast<ptrdiff_t>(srcStride) * 4;
+            UINT y = 0;
+            for (; y + 8 <= tileHeight; y += 8)
+            {
+                UINT x = 0;
+                for (; x + 8 <= tileWidth; x += 8)
+                {
+                    const BYTE* in = tileSrc + static_cast<ptrdiff_t>(y) * srcStride + x * 4;
+                    BYTE* out = tileDst + static_cast<ptrdiff_t>(x) * dstStride + y * 4;
+                    for (int half = 0; half < 2; ++half)
+                    {
+                        const BYTE* row0 = in + half * 16;
+                        const BYTE* row1 = row0 + srcStride;
+                        const BYTE* row2 = row1 + srcStride;
+                        const BYTE* row3 = row2 + srcStride;
+                        const __m256i r0 = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(row0))), _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + lower)), 1);
+                        const __m256i r1 = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(row1))), _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + lower)), 1);
+                        const __m256i r2 = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(row2))), _mm_loadu_si128(reinterpret_cast<const __m128i*>(row2 + lower)), 1);
+                        const __m256i r3 = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(row3))), _mm_loadu_si128(reinterpret_cast<const __m128i*>(row3 + lower)), 1);
+
+                        const __m256i t0 = _mm256_unpacklo_epi32(r0, r1);
+                        const __m256i t1 = _mm256_unpacklo_epi32(r2, r3);
+                        const __m256i t2 = _mm256_unpackhi_epi32(r0, r1);
+                        const __m256i t3 = _mm256_unpackhi_epi32(r2, r3);
+
+                        BYTE* rows = out + static_cast<ptrdiff_t>(half) * 4 * dstStride;
+                        _mm256_storeu_si256(reinterpret_cast<__m256i*>(rows), _mm256_unpacklo_epi64(t0, t1));
+                        _mm256_storeu_si256(reinterpret_cast<__m256i*>(rows + dstStride), _mm256_unpackhi_epi64(t0, t1));
+                        _mm256_storeu_si256(reinterpret_cast<__m256i*>(rows + dstStride * 2), _mm256_unpacklo_epi64(t2, t3));
+                        _mm256_storeu_si256(reinterpret_cast<__m256i*>(rows + dstStride * 3), _mm256_unpackhi_epi64(t2, t3));
+                    }
+                }
+
+                if (x < tileWidth)
+                {
+                    TransposeSSE2(
+                        tileSrc + static_cast<ptrdiff_t>(y) * srcStride + x * 4, srcStride,
+                        tileDst + static_cast<ptrdiff_t>(x) * dstStride + y * 4, dstStride,
+                        tileWidth - x, 8);
+                }
+            }
+
+            if (y < tileHeight)
+            {
+                TransposeSSE2(tileSrc + static_cast<ptrdiff_t>(y) * srcStride, srcStride, tileDst + y * 4, dstStride, tileWidth, tileHeight - y);
+            }
+        }
+    }
+}
+
+
+void PixelKernels::HashTileRowScalar(const BYTE* src, UINT width, UINT tileWidth, UINT64* lanes)
+{
+    for (UINT tileX = 0; tileX < width; tileX += tileWidth, lanes += 4)
+    {
+        const UINT tileEnd = std::min<UINT>(tileX + tileWidth, width);
+
+        UINT x = tileX;
+        for (; x + kHashStripePixels <= tileEnd; x += kHashStripePixels)
+        {
+            AccumulateStripe(src + x * 4, kHashKeys + (x - tileX) / kHashStripePixels % kHashKeyStripes * 4, lanes);
+        }
+
+        // The partial stripe at the end is padded with zeros.
+        if (x < tileEnd)
+        {
+            BYTE tail[kHashStripePixels * 4] = {};
+            memcpy(tail, src + x * 4, (tileEnd - x) * 4);
+            AccumulateStripe(tail, kHashKeys + (x - tileX) / kHashStripePixels % kHashKeyStripes * 4, lanes);
+        }
+
+        for (int i = 0; i < 4; ++i)
+        {
+            UINT64 lane = lanes[i];
+            lane ^= lane >> 47;
+            lane ^= kHashScrambleKeys[i];
+            lanes[i] = lane * kHashPrime;
+        }
+    }
+}
+
+
+void PixelKernels::HashTileRowSSE2(const BYTE* src, UINT width, UINT tileWidth, UINT64* lanes)
+{
+    for (UINT tileX = 0; tileX < width; tileX += tileWidth, lanes += 4)
+    {
+        const UINT tileEnd = std::min<UINT>(tileX + tileWidth, width);
+
+        __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lanes));
+        __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lanes + 2));
+
+        UINT x = tileX;
+        for (; x + kHashStripePixels <= tileEnd; x += kHashStripePixels)
+        {
+            AccumulateStripe(src + x * 4, kHashKeys + (x - tileX) / kHashStripePixels % kHashKeyStripes * 4, &lo, &hi);
+        }
+
+        if (x < tileEnd)
+        {
+            BYTE tail[kHashStripePixels * 4] = {};
+            memcpy(tail, src + x * 4, (tileEnd - x) * 4);
+            AccumulateStripe(tail, kHashKeys + (x - tileX) / kHashStripePixels % kHashKeyStripes * 4, &lo, &hi);
+        }
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), ScrambleLanes(lo, kHashScrambleKeys));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes + 2), ScrambleLanes(hi, kHashScrambleKeys + 2));
+    }
+}
+
+
+TARGET_AVX2
+void PixelKernels::HashTileRowAVX2(const BYTE* src, UINT width, UINT tileWidth, UINT64* lanes)
+{
+    const __m256i prime = _mm256_set1_epi32(static_cast<int>(kHashPrime));
+    const __m256i scrambleKeys = _mm256_load_si256(reinterpret_cast<const __m256i*>(kHashScrambleKeys));
+    BYTE tail[kHashStripePixels * 4];
+
+    for (UINT tileX = 0; tileX < width; tileX += tileWidth, lanes += 4)
+    {
+        const UINT tileEnd = std::min<UINT>(tileX + tileWidth, width);
+
+        __m256i acc = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(lanes));
+
+        for (UINT x = tileX; x < tileEnd; x += kHashStripePixels)
+        {
+            const BYTE* stripe = src + x * 4;
+            if (x + kHashStripePixels > tileEnd)
+            {
+                memset(tail, 0, sizeof(tail));
+                memcpy(tail, stripe, (tileEnd - x) * 4);
+                stripe = tail;
+            }
+
+            const UINT64* keys = kHashKeys + (x - tileX) / kHashStripePixels % kHashKeyStripes * 4;
+            const __m256i data = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(stripe));
+            const __m256i mixed = _mm256_xor_si256(data, _mm256_load_si256(reinterpret_cast<const __m256i*>(keys)));
+            const __m256i product = _mm256_mul_epu32(mixed, _mm256_shuffle_epi32(mixed, _MM_SHUFFLE(0, 3, 0, 1)));
+            acc = _mm256_add_epi64(acc, _mm256_add_epi64(_mm256_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2)), product));
+        }
+
+        acc = _mm256_xor_si256(acc, _mm256_srli_epi64(acc, 47));
+        acc = _mm256_xor_si256(acc, scrambleKeys);
+        const __m256i low = _mm256_mul_epu32(acc, prime);
+        const __m256i high = _mm256_mul_epu32(_mm256_srli_epi64(acc, 32), prime);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), _mm256_add_epi64(low, _mm256_slli_epi64(high, 32)));
+    }
+}
+
+
+void PixelKernels::HashColumnsScalar(const BYTE* src, UINT width, UINT* columns)
+{
+    for (UINT x = 0; x < width; ++x)
+    {
+        columns[x] = (columns[x] ^ Load(src + x * 4)) * kHashPrime;
+    }
+}
+
+
+void PixelKernels::HashColumnsSSE2(const BYTE* src, UINT width, UINT* columns)
+{
+    // SSE2 has no 32-bit multiply, so multiply the even and the odd lanes separately.
+    const __m128i prime = _mm_set1_epi32(static_cast<int>(kHashPrime));
+
+    UINT x = 0;
+    for (; x + 4 <= width; x += 4)
+    {
+        const __m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x * 4));
+        const __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(columns + x));
+        const __m128i mixed = _mm_xor_si128(c, p);
+        const __m128i even = _mm_mul_epu32(mixed, prime);
+        const __m128i odd = _mm_mul_epu32(_mm_srli_epi64(mixed, 32), prime);
+        const __m128i product = _mm_unpacklo_epi32(
+            _mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+            _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(columns + x), product);
+    }
+
+    HashColumnsScalar(src + x * 4, width - x, columns + x);
+}
+
+
+TARGET_AVX2
+void PixelKernels::HashColumnsAVX2(const BYTE* src, UINT width, UINT* columns)
+{
+    const __m256i prime = _mm256_set1_epi32(static_cast<int>(kHashPrime));
+
+    UINT x = 0;
+    for (; x + 8 <= width; x += 8)
+    {
+        const __m256i p = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + x * 4));
+        const __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(columns + x));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(columns + x), _mm256_mullo_epi32(_mm256_xor_si256(c, p), prime));
+    }
+
+    HashColumnsScalar(src + x * 4, width - x, columns + x);
+}
@@ -0,0 +1,258 @@
+#pragma once
+
+#include <Windows.h>
+#include <atomic>
+
+enum class CpuIsa
+{
+    Scalar = 0,
+    SSE2 = 1,
+    AVX2 = 2,
+};
+
+// Fixed-point weights (1.0 = 256) of the B, G and R channels, and a value added after scaling.
+struct ColorWeights
+{
+    int b;
+    int g;
+    int r;
+    int offset;
+};
+
+// Row kernels for 32-bit pixels. Rows need not be aligned, and src may equal dst unless noted.
+// Every variant produces exactly the same bytes as the scalar one.
+// Initialize() detects the CPU once and binds each kernel to the best variant it supports, after
+// checking those variants against the scalar ones; if any differs, every kernel falls back to the
+// scalar variant. Until then the SSE2 variants, which every supported target has, are used.
+class PixelKernels
+{
+public:
+    using SwapRedBlueFunc = void(*)(const BYTE* src, BYTE* dst, UINT width);
+    using XorFunc = void(*)(const BYTE* src1, const BYTE* src2, BYTE* dst, UINT width);
+    using HasAlphaFunc = bool(*)(const BYTE* src, UINT width);
+    using CompositeCursorFunc = void(*)(const BYTE* desktop, const BYTE* desktopWithCursor, const BYTE* cursor, BYTE* dst, UINT width);
+    using ApplyCursorMaskFunc = void(*)(const BYTE* color, const BYTE* mask, BYTE* dst, UINT width);
+    using AccumulateRowFunc = void(*)(const BYTE* src, float weight, float* dst, UINT count);
+    using FilterRowFunc = void(*)(const float* src, const UINT* starts, const float* weights, UINT tapCount, BYTE* dst, UINT width);
+    using Downsample2xFunc = void(*)(const BYTE* src0, const BYTE* src1, BYTE* dst, UINT width);
+    using WeightedSumFunc = void(*)(const BYTE* src, BYTE* dst, UINT step, UINT width, const ColorWeights& weights);
+    using ToRGB565Func = void(*)(const BYTE* src, BYTE* dst, UINT width);
+    using ToRGBA16FFunc = void(*)(const BYTE* src, BYTE* dst, UINT width);
+    using PremultiplyFunc = void(*)(const BYTE* src, BYTE* dst, UINT width);
+    using UnpremultiplyFunc = void(*)(const BYTE* src, BYTE* dst, UINT width);
+    using ReverseRowFunc = void(*)(const BYTE* src, BYTE* dst, UINT width);
+    using TransposeFunc = void(*)(const BYTE* src, int srcStride, BYTE* dst, int dstStride, UINT width, UINT height);
+    using HashTileRowFunc = void(*)(const BYTE* src, UINT width, UINT tileWidth, UINT64* lanes);
+    using HashColumnsFunc = void(*)(const BYTE* src, UINT width, UINT* columns);
+
+    // maxIsa caps the variants, e.g. to reproduce a problem seen on an older CPU.
+    static void Initialize(CpuIsa maxIsa = CpuIsa::AVX2);
+    static CpuIsa GetDetectedIsa();
+    static CpuIsa GetActiveIsa();
+
+    // Swaps the 1st and 3rd byte of every pixel (BGRA <-> RGBA).
+    static void SwapRedBlue(const BYTE* src, BYTE* dst, UINT width)
+    {
+        _swapRedBlue.load(std::memory_order_relaxed)(src, dst, width);
+    }
+
+    // Combines the color and mask bitmaps of an icon.
+    static void Xor(const BYTE* src1, const BYTE* src2, BYTE* dst, UINT width)
+    {
+        _xor.load(std::memory_order_relaxed)(src1, src2, dst, width);
+    }
+
+    // Returns true if any pixel has a non-zero alpha, i.e. the bitmap carries a real alpha channel.
+    static bool HasAlpha(const BYTE* src, UINT width)
+    {
+        return _hasAlpha.load(std::memory_order_relaxed)(src, width);
+    }
+
+    // Uses the cursor pixel where it has alpha, otherwise the desktop drawn with the cursor.
+    // Pixels that DrawIcon() changed are opaque (e.g. monochrome cursors), the others are transparent.
+    static void CompositeCursor(const BYTE* desktop, const BYTE* desktopWithCursor, const BYTE* cursor, BYTE* dst, UINT width)
+    {
+        _compositeCursor.load(std::memory_order_relaxed)(desktop, desktopWithCursor, cursor, dst, width);
+    }
+
+    // Renders a cursor without alpha from its color (or XOR) and AND mask bitmaps.
+    // Pixels outside the mask are opaque, masked black pixels are transparent and
+    // masked colored pixels, which would invert the screen, are drawn as opaque black.
+    static void ApplyCursorMask(const BYTE* color, const BYTE* mask, BYTE* dst, UINT width)
+    {
+        _applyCursorMask.load(std::memory_order_relaxed)(color, mask, dst, width);
+    }
+
+    // Adds src[i] * weight to dst[i] for count bytes (not pixels). Used for the vertical pass of resampling.
+    static void AccumulateRow(const BYTE* src, float weight, float* dst, UINT count)
+    {
+        _accumulateRow.load(std::memory_order_relaxed)(src, weight, dst, count);
+    }
+
+    // Horizontal pass of resampling: each output pixel x is the sum of tapCount input pixels
+    // from starts[x], weighted by weights[x * tapCount + i], rounded and clamped to a byte.
+    static void FilterRow(const float* src, const UINT* starts, const float* weights, UINT tapCount, BYTE* dst, UINT width)
+    {
+        _filterRow.load(std::memory_order_relaxed)(src, starts, weights, tapCount, dst, width);
+    }
+
+    // Averages 2x2 blocks of two source rows into width output pixels, rounding to nearest.
+    // Each source row must have 2 * width pixels.
+    static void Downsample2x(const BYTE* src0, const BYTE* src1, BYTE* dst, UINT width)
+    {
+        _downsample2x.load(std::memory_order_relaxed)(src0, src1, dst, width);
+    }
+
+    // Writes one byte per BGRA pixel to dst[x * step]: the weighted sum of B, G and R rounded
+    // to nearest, plus the offset, clamped to a byte. Used for luma, chroma and grayscale.
+    static void WeightedSum(const BYTE* src, BYTE* dst, UINT step, UINT width, const ColorWeights& weights)
+    {
+        _weightedSum.load(std::memory_order_relaxed)(src, dst, step, width, weights);
+    }
+
+    // BGRA to little-endian RGB565 by truncating the low bits.
+    static void ToRGB565(const BYTE* src, BYTE* dst, UINT width)
+    {
+        _toRGB565.load(std::memory_order_relaxed)(src, dst, width);
+    }
+
+    // BGRA to RGBA half floats in [0, 1], rounded to nearest even.
+    static void ToRGBA16F(const BYTE* src, BYTE* dst, UINT width)
+    {
+        _toRGBA16F.load(std::memory_order_relaxed)(src, dst, width);
+    }
+
+    // Multiplies the color by alpha / 255, rounded to nearest. Alpha is kept.
+    static void Premultiply(const BYTE* src, BYTE* dst, UINT width)
+    {
+        _premultiply.load(std::memory_order_relaxed)(src, dst, width);
+    }
+
+    // Divides the color by alpha / 255, rounded to nearest and clamped to 255.
+    // Pixels with zero alpha become transparent black.
+    static void Unpremultiply(const BYTE* src, BYTE* dst, UINT width)
+    {
+        _unpremultiply.load(std::memory_order_relaxed)(src, dst, width);
+    }
+
+    // Writes the pixels in reverse order. src and dst must not overlap.
+    static void ReverseRow(const BYTE* src, BYTE* dst, UINT width)
+    {
+        _reverseRow.load(std::memory_order_relaxed)(src, dst, width);
+    }
+
+    // Block kernel: writes the width x height source as a height x width destination,
+    // so that column x of the source becomes row x of the destination. The strides are
+    // in bytes and may be negative. Works in cache-sized tiles; src and dst must not overlap.
+    static void Transpose(const BYTE* src, int srcStride, BYTE* dst, int dstStride, UINT width, UINT height)
+    {
+        _transpose.load(std::memory_order_relaxed)(src, srcStride, dst, dstStride, width, height);
+    }
+
+    // Folds a row into per-tile hashes. The pixels of tile i, tileWidth (a multiple of 8) wide,
+    // update the 4 lanes at lanes + 4 * i, which are then scrambled so that the order of the rows
+    // counts too. The last tile may be narrower. Not a cryptographic hash.
+    static void HashTileRow(const BYTE* src, UINT width, UINT tileWidth, UINT64* lanes)
+    {
+        _hashTileRow.load(std::memory_order_relaxed)(src, width, tileWidth, lanes);
+    }
+
+    // Folds a row into one 32-bit hash per column: columns[x] = (columns[x] ^ pixel) * prime.
+    static void HashColumns(const BYTE* src, UINT width, UINT* columns)
+    {
+        _hashColumns.load(std::memory_order_relaxed)(src, width, columns);
+    }
+
+    static void SwapRedBlueScalar(const BYTE* src, BYTE* dst, UINT width);
+    static void SwapRedBlueSSE2(const BYTE* src, BYTE* dst, UINT width);
+    static void SwapRedBlueAVX2(const BYTE* src, BYTE* dst, UINT width);
+
+    static void XorScalar(const BYTE* src1, const BYTE* src2, BYTE* dst, UINT width);
+    static void XorSSE2(const BYTE* src1, const BYTE* src2, BYTE* dst, UINT width);
+    static void XorAVX2(const BYTE* src1, const BYTE* src2, BYTE* dst, UINT width);
+
+    static bool HasAlphaScalar(const BYTE* src, UINT width);
+    static bool HasAlphaSSE2(const BYTE* src, UINT width);
+    static bool HasAlphaAVX2(const BYTE* src, UINT width);
+
+    static void CompositeCursorScalar(const BYTE* desktop, const BYTE* desktopWithCursor, const BYTE* cursor, BYTE* dst, UINT width);
+    static void CompositeCursorSSE2(const BYTE* desktop, const BYTE* desktopWithCursor, const BYTE* cursor, BYTE* dst, UINT width);
+    static void CompositeCursorAVX2(const BYTE* desktop, const BYTE* desktopWithCursor, const BYTE* cursor, BYTE* dst, UINT width);
+
+    static void ApplyCursorMaskScalar(const BYTE* color, const BYTE* mask, BYTE* dst, UINT width);
+    static void ApplyCursorMaskSSE2(const BYTE* color, const BYTE* mask, BYTE* dst, UINT width);
+    static void ApplyCursorMaskAVX2(const BYTE* color, const BYTE* mask, BYTE* dst, UINT width);
+
+    static void AccumulateRowScalar(const BYTE* src, float weight, float* dst, UINT count);
+    static void AccumulateRowSSE2(const BYTE* src, float weight, float* dst, UINT count);
+    static void AccumulateRowAVX2(const BYTE* src, float weight, float* dst, UINT count);
+
+    static void FilterRowScalar(const float* src, const UINT* starts, const float* weights, UINT tapCount, BYTE* dst, UINT width);
+    static void FilterRowSSE2(const float* src, const UINT* starts, const float* weights, UINT tapCount, BYTE* dst, UINT width);
+    static void FilterRowAVX2(const float* src, const UINT* starts, const float* weights, UINT tapCount, BYTE* dst, UINT width);
+
+    static void Downsample2xScalar(const BYTE* src0, const BYTE* src1, BYTE* dst, UINT width);
+    static void Downsample2xSSE2(const BYTE* src0, const BYTE* src1, BYTE* dst, UINT width);
+    static void Downsample2xAVX2(const BYTE* src0, const BYTE* src1, BYTE* dst, UINT width);
+
+    static void WeightedSumScalar(const BYTE* src, BYTE* dst, UINT step, UINT width, const ColorWeights& weights);
+    static void WeightedSumSSE2(const BYTE* src, BYTE* dst, UINT step, UINT width, const ColorWeights& weights);
+    static void WeightedSumAVX2(const BYTE* src, BYTE* dst, UINT step, UINT width, const ColorWeights& weights);
+
+    static void ToRGB565Scalar(const BYTE* src, BYTE* dst, UINT width);
+    static void ToRGB565SSE2(const BYTE* src, BYTE* dst, UINT width);
+    static void ToRGB565AVX2(const BYTE* src, BYTE* dst, UINT width);
+
+    // SSE2 has no half-float conversion, so that level uses the scalar lookup table.
+    static void ToRGBA16FScalar(const BYTE* src, BYTE* dst, UINT width);
+    static void ToRGBA16FAVX2(const BYTE* src, BYTE* dst, UINT width);
+
+    static void PremultiplyScalar(const BYTE* src, BYTE* dst, UINT width);
+    static void PremultiplySSE2(const BYTE* src, BYTE* dst, UINT width);
+    static void PremultiplyAVX2(const BYTE* src, BYTE* dst, UINT width);
+
+    static void UnpremultiplyScalar(const BYTE* src, BYTE* dst, UINT width);
+    static void UnpremultiplySSE2(const BYTE* src, BYTE* dst, UINT width);
+    static void UnpremultiplyAVX2(const BYTE* src, BYTE* dst, UINT width);
+
+    static void ReverseRowScalar(const BYTE* src, BYTE* dst, UINT width);
+    static void ReverseRowSSE2(const BYTE* src, BYTE* dst, UINT width);
+    static void ReverseRowAVX2(const BYTE* src, BYTE* dst, UINT width);
+
+    static void TransposeScalar(const BYTE* src, int srcStride, BYTE* dst, int dstStride, UINT width, UINT height);
+    static void TransposeSSE2(const BYTE* src, int srcStride, BYTE* dst, int dstStride, UINT width, UINT height);
+    static void TransposeAVX2(const BYTE* src, int srcStride, BYTE* dst, int dstStride, UINT width, UINT height);
+
+    static void HashTileRowScalar(const BYTE* src, UINT width, UINT tileWidth, UINT64* lanes);
+    static void HashTileRowSSE2(const BYTE* src, UINT width, UINT tileWidth, UINT64* lanes);
+    static void HashTileRowAVX2(const BYTE* src, UINT width, UINT tileWidth, UINT64* lanes);
+
+    static void HashColumnsScalar(const BYTE* src, UINT width, UINT* columns);
+    static void HashColumnsSSE2(const BYTE* src, UINT width, UINT* columns);
+    static void HashColumnsAVX2(const BYTE* src, UINT width, UINT* columns);
+
+private:
+    static CpuIsa DetectIsa();
+    static void BindKernels(CpuIsa isa);
+    static bool VerifyKernels(CpuIsa isa);
+
+    static std::atomic<CpuIsa> _detectedIsa;
+    static std::atomic<CpuIsa> _activeIsa;
+    static std::atomic<SwapRedBlueFunc> _swapRedBlue;
+    static std::atomic<XorFunc> _xor;
+    static std::atomic<HasAlphaFunc> _hasAlpha;
+    static std::atomic<CompositeCursorFunc> _compositeCursor;
+    static std::atomic<ApplyCursorMaskFunc> _applyCursorMask;
+    static std::atomic<AccumulateRowFunc> _accumulateRow;
+    static std::atomic<FilterRowFunc> _filterRow;
+    static std::atomic<Downsample2xFunc> _downsample2x;
+    static std::atomic<WeightedSumFunc> _weightedSum;
+    static std::atomic<ToRGB565Func> _toRGB565;
+    static std::atomic<ToRGBA16FFunc> _toRGBA16F;
+    static std::atomic<PremultiplyFunc> _premultiply;
+    static std::atomic<UnpremultiplyFunc> _unpremultiply;
+    static std::atomic<ReverseRowFunc> _reverseRow;
+    static std::atomic<TransposeFunc> _transpose;
+    static std::atomic<HashTileRowFunc> _hashTileRow;
+    static std::atomic<HashColumnsFunc> _hashColumns;
+};
@@ -0,0 +1,152 @@
+#include "pch.h"
+#include <algorithm>
+#include <cmath>
+#include "Resampler.h"
+#include "PixelKernels.h"
+
+namespace
+{
+    constexpr double kPi = 3.14159265358979323846;
+
+    double GetRadius(ResampleFilter filter)
+    {
+        switch (filter)
+        {
+            case ResampleFilter::Box: return 0.5;
+            case ResampleFilter::Bilinear: return 1.0;
+            case ResampleFilter::Lanczos: return 3.0;
+            default: return 0.0;
+        }
+    }
+
+    double Sinc(double x)
+    {
+        if (x == 0.0) return 1.0;
+        x *= kPi;
+        return std::sin(x) / x;
+    }
+
+    double Evaluate(ResampleFilter filter, double x)
+    {
+        switch (filter)
+        {
+            case ResampleFilter::Box:
+                return (x > -0.5 && x <= 0.5) ? 1.0 : 0.0;
+            case ResampleFilter::Bilinear:
+                return std::max<double>(1.0 - std::fabs(x), 0.0);
+            case ResampleFilter::Lanczos:
+                return (x > -3.0 && x < 3.0) ? Sinc(x) * Sinc(x / 3.0) : 0.0;
+            default:
+                return 0.0;
+        }
+    }
+}
+
+
+bool Resampler::Axis::Create(UINT srcSize, UINT dstSize, ResampleFilter filter)
+{
+    const double scale = static_cast<double>(srcSize) / dstSize;
+    const double filterScale = std::max<double>(scale, 1.0);
+    const double support = GetRadius(filter) * filterScale;
+
+    tapCount = std::min<UINT>(static_cast<UINT>(std::ceil(support)) * 2 + 1, srcSize);
+    starts.assign(dstSize, 0);
+    weights.assign(static_cast<size_t>(dstSize) * tapCount, 0.f);
+
+    std::vector<double> values(tapCount);
+    for (UINT i = 0; i < dstSize; ++i)
+    {
+        const double center = (i + 0.5) * scale;
+        const int first = std::max<int>(static_cast<int>(center - support + 0.5), 0);
+        const int last = std::min<int>(static_cast<int>(center + support + 0.5), static_cast<int>(srcSize));
+        const UINT count = std::min<UINT>(static_cast<UINT>(std::max<int>(last - first, 1)), tapCount);
+
+        // Shift the window back near the right edge so that it always has tapCount pixels.
+        const UINT start = std::min<UINT>(static_cast<UINT>(first), srcSize - tapCount);
+        const UINT offset = static_cast<UINT>(first) - start;
+
+        double total = 0.0;
+        for (UINT k = 0; k < count; ++k)
+        {
+            values[k] = Evaluate(filter, (first + k - center + 0.5) / filterScale);
+            total += values[k];
+        }
+        if (total == 0.0)
+        {
+            values[0] = total = 1.0;
+        }
+
+        starts[i] = start;
+        float* w = weights.data() + static_cast<size_t>(i) * tapCount;
+        for (UINT k = 0; k < count && offset + k < tapCount; ++k)
+        {
+            w[offset + k] = static_cast<float>(values[k] / total);
+        }
+    }
+
+    return true;
+}
+
+
+bool Resampler::Create(UINT srcWidth, UINT srcHeight, UINT dstWidth, UINT dstHeight, ResampleFilter filter)
+{
+    if (srcWidth == 0 || srcHeight == 0 || dstWidth == 0 || dstHeight == 0)
+    {
+        DebugLog::Error(__FUNCTION__, " => Invalid size: ", srcWidth, "x", srcHeight, " -> ", dstWidth, "x", dstHeight);
+        return false;
+    }
+
+    if (GetRadius(filter) == 0.0)
+    {
+        DebugLog::Error(__FUNCTION__, " => The filter is not supported: ", static_cast<int>(filter));
+        return false;
+    }
+
+    srcWidth_ = srcWidth;
+    srcHeight_ = srcHeight;
+    dstWidth_ = dstWidth;
+    dstHeight_ = dstHeight;
+    filter_ = filter;
+
+    return horizontal_.Create(srcWidth, dstWidth, filter) && vertical_.Create(srcHeight, dstHeight, filter);
+}
+
+
+bool Resampler::IsCreatedFor(UINT srcWidth, UINT srcHeight, UINT dstWidth, UINT dstHeight, ResampleFilter filter) const
+{
+    return
+        srcWidth_ == srcWidth && srcHeight_ == srcHeight &&
+        dstWidth_ == dstWidth && dstHeight_ == dstHeight &&
+        filter_ == filter;
+}
+
+
+UINT Resampler::GetRowBufferSize() const
+{
+    return srcWidth_ * 4;
+}
+
+
+float* Resampler::GetRowBuffers(UINT bandCount)
+{
+    rowBuffers_.ExpandIfNeeded(GetRowBufferSize() * bandCount);
+    return rowBuffers_.Get();
+}
+
+
+void Resampler::ResampleRow(const BYTE* src, int srcStride, UINT y, BYTE* dst, float* rowBuffer) const
+{
+    // Vertical pass into the scratch row, then the horizontal pass straight into the output.
+    std::fill(rowBuffer, rowBuffer + GetRowBufferSize(), 0.f);
+
+    const UINT start = vertical_.starts[y];
+    const float* weights = vertical_.weights.data() + static_cast<size_t>(y) * vertical_.tapCount;
+    for (UINT i = 0; i < vertical_.tapCount; ++i)
+    {
+        if (weights[i] == 0.f) continue;
+        const BYTE* row = src + static_cast<ptrdiff_t>(start + i) * srcStride;
+        PixelKernels::AccumulateRow(row, weights[i], rowBuffer, srcWidth_ * 4);
+    }
+
+    PixelKernels::FilterRow(rowBuffer, horizontal_.starts.data(), horizontal_.weights.data(), horizontal_.tapCount, dst, dstWidth_);
+}
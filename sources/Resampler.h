@@ -0,0 +1,58 @@
+#pragma once
+
+#include <Windows.h>
+#include <vector>
+
+#include "Buffer.h"
+
+enum class ResampleFilter
+{
+    Nearest = 0,
+    Box = 1,
+    Bilinear = 2,
+    Lanczos = 3,
+};
+
+
+// Separable resampler for 32-bit pixels. The channels are filtered independently,
+// so the channel order does not matter. The filters widen with the scale when
+// downscaling, so every source pixel contributes and thumbnails do not alias.
+// Weights are computed once in Create(); rows can then be resampled from any thread.
+class Resampler
+{
+public:
+    bool Create(UINT srcWidth, UINT srcHeight, UINT dstWidth, UINT dstHeight, ResampleFilter filter);
+    bool IsCreatedFor(UINT srcWidth, UINT srcHeight, UINT dstWidth, UINT dstHeight, ResampleFilter filter) const;
+
+    // Number of floats ResampleRow() needs as a scratch row.
+    UINT GetRowBufferSize() const;
+
+    // Returns bandCount scratch rows of GetRowBufferSize() floats each, one per row band.
+    // The storage is kept with the weights, so callers that reuse a resampler do not allocate
+    // per call. Not thread-safe: call it before handing the rows to the band threads.
+    float* GetRowBuffers(UINT bandCount);
+
+    // Writes the output row y. src points to the first source row and the stride may be negative.
+    void ResampleRow(const BYTE* src, int srcStride, UINT y, BYTE* dst, float* rowBuffer) const;
+
+private:
+    // Each output pixel uses tapCount consecutive input pixels from its start.
+    // Unused taps have a zero weight, so the kernels need no per-pixel counts.
+    struct Axis
+    {
+        UINT tapCount = 0;
+        std::vector<UINT> starts;
+        std::vector<float> weights;
+
+        bool Create(UINT srcSize, UINT dstSize, ResampleFilter filter);
+    };
+
+    UINT srcWidth_ = 0;
+    UINT srcHeight_ = 0;
+    UINT dstWidth_ = 0;
+    UINT dstHeight_ = 0;
+    ResampleFilter filter_ = ResampleFilter::Nearest;
+    Axis horizontal_;
+    Axis vertical_;
+    Buffer<float> rowBuffers_;
+};
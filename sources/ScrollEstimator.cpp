@@ -0,0 +1,145 @@
+#include "pch.h"
+#include <algorithm>
+#include "ScrollEstimator.h"
+
+namespace
+{
+    // Fewer matching lines than this are taken as a coincidence, e.g. a few repeated lines of text.
+    constexpr UINT kMinMatchedLines = 16;
+
+    constexpr int kEmptySlot = -1;
+    constexpr int kDuplicateLine = -2;
+}
+
+
+bool ScrollEstimator::Estimate(const UINT64* previous, const UINT64* current, UINT lineCount, UINT stripCount, UINT firstStrip, UINT endStrip, Result* result)
+{
+    if (lineCount < kMinMatchedLines || firstStrip >= endStrip || endStrip > stripCount) return false;
+
+    UINT tableSize = 1;
+    while (tableSize < lineCount * 2) tableSize <<= 1;
+    keys_.ExpandIfNeeded(tableSize);
+    lines_.ExpandIfNeeded(tableSize);
+    tableMask_ = tableSize - 1;
+
+    // votes[offset + lineCount]
+    votes_.ExpandIfNeeded(lineCount * 2);
+    UINT* votes = votes_.Get();
+    std::fill(votes, votes + lineCount * 2, 0u);
+
+    // Unchanged lines say nothing about a scroll, and lines that are not unique would vote at random.
+    for (UINT strip = firstStrip; strip < endStrip; ++strip)
+    {
+        BuildTable(previous, lineCount, stripCount, strip);
+        for (UINT line = 0; line < lineCount; ++line)
+        {
+            const UINT64 hash = current[line * stripCount + strip];
+            if (hash == previous[line * stripCount + strip]) continue;
+
+            const int source = Find(hash);
+            if (source < 0) continue;
+
+            ++votes[line + lineCount - source];
+        }
+    }
+
+    const UINT best = static_cast<UINT>(std::max_element(votes, votes + lineCount * 2) - votes);
+    if (votes[best] < kMinMatchedLines) return false;
+
+    Result estimate;
+    estimate.offset = static_cast<int>(best) - static_cast<int>(lineCount);
+    estimate.votes = votes[best];
+    estimate.firstLine = lineCount;
+    estimate.firstStrip = stripCount;
+
+    // The lines that cannot come from the previous frame are new content scrolling in.
+    const UINT beginLine = static_cast<UINT>(std::max<int>(estimate.offset, 0));
+    const UINT endLine = static_cast<UINT>(std::min<int>(lineCount, lineCount + estimate.offset));
+
+    // A strip takes part in the scroll if the offset explains most of its changed lines.
+    for (UINT strip = firstStrip; strip < endStrip; ++strip)
+    {
+        UINT changed = 0;
+        UINT matched = 0;
+        UINT first = lineCount;
+        UINT last = 0;
+        for (UINT line = beginLine; line < endLine; ++line)
+        {
+            const UINT64 hash = current[line * stripCount + strip];
+            if (hash == previous[line * stripCount + strip]) continue;
+
+            ++changed;
+            if (hash == previous[(line - estimate.offset) * stripCount + strip])
+            {
+                ++matched;
+                first = std::min<UINT>(first, line);
+                last = line;
+            }
+        }
+
+        if (matched == 0 || matched * 2 < changed) continue;
+
+        estimate.firstStrip = std::min<UINT>(estimate.firstStrip, strip);
+        estimate.endStrip = strip + 1;
+        estimate.firstLine = std::min<UINT>(estimate.firstLine, first);
+        estimate.endLine = std::max<UINT>(estimate.endLine, last + 1);
+    }
+
+    if (estimate.firstStrip >= estimate.endStrip) return false;
+
+    *result = estimate;
+    return true;
+}
+
+
+bool ScrollEstimator::IsPredicted(const UINT64* previous, const UINT64* current, UINT stripCount, const Result& result, UINT line, UINT strip)
+{
+    const bool isMoved =
+        strip >= result.firstStrip && strip < result.endStrip &&
+        line >= result.firstLine && line < result.endLine;
+    const UINT source = isMoved ? static_cast<UINT>(static_cast<int>(line) - result.offset) : line;
+    return current[line * stripCount + strip] == previous[source * stripCount + strip];
+}
+
+
+void ScrollEstimator::BuildTable(const UINT64* previous, UINT lineCount, UINT stripCount, UINT strip)
+{
+    UINT64* keys = keys_.Get();
+    int* lines = lines_.Get();
+    std::fill(lines, lines + tableMask_ + 1, kEmptySlot);
+
+    for (UINT line = 0; line < lineCount; ++line)
+    {
+        const UINT64 hash = previous[line * stripCount + strip];
+        UINT slot = static_cast<UINT>(hash) & tableMask_;
+        while (lines[slot] != kEmptySlot && keys[slot] != hash)
+        {
+            slot = (slot + 1) & tableMask_;
+        }
+
+        if (lines[slot] == kEmptySlot)
+        {
+            keys[slot] = hash;
+            lines[slot] = static_cast<int>(line);
+        }
+        else
+        {
+            lines[slot] = kDuplicateLine;
+        }
+    }
+}
+
+
+int ScrollEstimator::Find(UINT64 hash) const
+{
+    const UINT64* keys = keys_.Get();
+    const int* lines = lines_.Get();
+
+    UINT slot = static_cast<UINT>(hash) & tableMask_;
+    while (lines[slot] != kEmptySlot)
+    {
+        if (keys[slot] == hash) return lines[slot];
+        slot = (slot + 1) & tableMask_;
+    }
+    return kEmptySlot;
+}
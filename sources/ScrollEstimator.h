@@ -0,0 +1,43 @@
+#pragma once
+
+#include <Windows.h>
+
+#include "Buffer.h"
+
+// Finds the offset by which lines moved between two frames by matching line hashes.
+// The hashes are laid out line by line with one hash per strip: a hash of each row of every
+// tile column to find vertical scrolls, or of each column of every tile row for horizontal ones.
+// Matching per strip finds a scroll even when the lines also cross static parts such as sidebars.
+class ScrollEstimator
+{
+public:
+    struct Result
+    {
+        // Line l of the current frame shows line l - offset of the previous one.
+        int offset = 0;
+        // The moved lines and strips of the current frame.
+        UINT firstLine = 0;
+        UINT endLine = 0;
+        UINT firstStrip = 0;
+        UINT endStrip = 0;
+        // Number of changed lines that the offset explains.
+        UINT votes = 0;
+    };
+
+    // Searches the strips in [firstStrip, endStrip), e.g. the ones with dirty tiles.
+    // Returns false if no offset explains enough changed lines.
+    bool Estimate(const UINT64* previous, const UINT64* current, UINT lineCount, UINT stripCount, UINT firstStrip, UINT endStrip, Result* result);
+
+    // Whether the line of the strip equals the previous frame once the moved lines are moved.
+    static bool IsPredicted(const UINT64* previous, const UINT64* current, UINT stripCount, const Result& result, UINT line, UINT strip);
+
+private:
+    void BuildTable(const UINT64* previous, UINT lineCount, UINT stripCount, UINT strip);
+    int Find(UINT64 hash) const;
+
+    // Open addressing from the hash of a previous line to the line, or to -2 if it is not unique.
+    Buffer<UINT64> keys_;
+    Buffer<int> lines_;
+    Buffer<UINT> votes_;
+    UINT tableMask_ = 0;
+};
@@ -7,20 +7,29 @@
 
 #include "Timer.h"
 
-class ScopedThreadSleeper : public ScopedTimer
+class ScopedThreadSleeper
 {
 public:
+    using microseconds = std::chrono::microseconds;
+
     template <class T>
-    explicit ScopedThreadSleeper(const T& duration) :
-        ScopedTimer([duration](microseconds us)
-            {
-                const auto waitTime = duration - us;
-                if (waitTime > microseconds::zero())
-                {
-                    std::this_thread::sleep_for(waitTime);
-                }
-            })
+    explicit ScopedThreadSleeper(const T& duration)
+        : duration_(std::chrono::duration_cast<microseconds>(duration))
+        , start_(std::chrono::steady_clock::now())
     {}
+    ~ScopedThreadSleeper()
+    {
+        const auto us = std::chrono::duration_cast<microseconds>(std::chrono::steady_clock::now() - start_);
+        const auto waitTime = duration_ - us;
+        if (waitTime > microseconds::zero())
+        {
+            std::this_thread::sleep_for(waitTime);
+        }
+    }
+
+private:
+    const microseconds duration_;
+    const std::chrono::steady_clock::time_point start_;
 };
 
 class ThreadLoop
@@ -0,0 +1,546 @@
+#include "pch.h"
+#include <algorithm>
+#include "TileDiff.h"
+#include "ImagePipeline.h"
+#include "PixelKernels.h"
+
+namespace
+{
+    constexpr UINT kTileSize = DirtyTiles::kTileSize;
+
+    // Initial lanes of every tile, the first primes of XXH3.
+    const UINT64 kLaneSeeds[4] =
+    {
+        0x00000000C2B2AE3DULL, 0x9E3779B185EBCA87ULL, 0xC2B2AE3D27D4EB4FULL, 0x165667B19E3779F9ULL,
+    };
+
+    // Initial hash of every column of a tile row, see PixelKernels::HashColumns().
+    constexpr UINT kColumnSeed = 0x165667B1;
+
+    UINT64 Mix(UINT64 hash, UINT64 value)
+    {
+        hash = (hash ^ value) * 0x9E3779B185EBCA87ULL;
+        return hash ^ (hash >> 32);
+    }
+
+    UINT64 FoldLanes(const UINT64* lanes)
+    {
+        UINT64 hash = 0;
+        for (int i = 0; i < 4; ++i)
+        {
+            hash = Mix(hash, lanes[i]);
+        }
+        return hash;
+    }
+}
+
+
+void DirtyTiles::Reset()
+{
+    flags_.Reset();
+    x_ = 0;
+    y_ = 0;
+    width_ = 0;
+    height_ = 0;
+    columns_ = 0;
+    rows_ = 0;
+    dirtyCount_ = 0;
+}
+
+
+bool DirtyTiles::Empty() const
+{
+    return columns_ == 0 || rows_ == 0;
+}
+
+
+RECT DirtyTiles::GetRegion() const
+{
+    return RECT
+    {
+        static_cast<LONG>(x_),
+        static_cast<LONG>(y_),
+        static_cast<LONG>(x_ + width_),
+        static_cast<LONG>(y_ + height_),
+    };
+}
+
+
+UINT DirtyTiles::GetColumnCount() const
+{
+    return columns_;
+}
+
+
+UINT DirtyTiles::GetRowCount() const
+{
+    return rows_;
+}
+
+
+UINT DirtyTiles::GetDirtyCount() const
+{
+    return dirtyCount_;
+}
+
+
+size_t DirtyTiles::GetCapacity() const
+{
+    return flags_.Capacity();
+}
+
+
+bool DirtyTiles::IsDirty(UINT column, UINT row) const
+{
+    if (column >= columns_ || row >= rows_) return true;
+    return flags_[row * columns_ + column] != 0;
+}
+
+
+RECT DirtyTiles::GetTileRect(UINT column, UINT row) const
+{
+    const UINT left = column * kTileSize;
+    const UINT top = row * kTileSize;
+    return RECT
+    {
+        static_cast<LONG>(x_ + left),
+        static_cast<LONG>(y_ + top),
+        static_cast<LONG>(x_ + std::min<UINT>(left + kTileSize, width_)),
+        static_cast<LONG>(y_ + std::min<UINT>(top + kTileSize, height_)),
+    };
+}
+
+
+UINT DirtyTiles::GetRects(RECT* rects, UINT maxCount) const
+{
+    UINT count = 0;
+    for (UINT row = 0; row < rows_ && count < maxCount; ++row)
+    {
+        for (UINT column = 0; column < columns_ && count < maxCount; ++column)
+        {
+            if (flags_[row * columns_ + column])
+            {
+                rects[count++] = GetTileRect(column, row);
+            }
+        }
+    }
+    return dirtyCount_;
+}
+
+
+bool DirtyTiles::Intersects(const RECT& rect) const
+{
+    if (Empty()) return true;
+    if (rect.left >= rect.right || rect.top >= rect.bottom) return false;
+
+    const RECT region = GetRegion();
+    if (rect.left < region.left || rect.top < region.top || rect.right > region.right || rect.bottom > region.bottom)
+    {
+        return true;
+    }
+    if (dirtyCount_ == 0) return false;
+
+    const UINT firstColumn = (rect.left - region.left) / kTileSize;
+    const UINT lastColumn = (rect.right - region.left - 1) / kTileSize;
+    const UINT firstRow = (rect.top - region.top) / kTileSize;
+    const UINT lastRow = (rect.bottom - region.top - 1) / kTileSize;
+    for (UINT row = firstRow; row <= lastRow; ++row)
+    {
+        for (UINT column = firstColumn; column <= lastColumn; ++column)
+        {
+            if (flags_[row * columns_ + column]) return true;
+        }
+    }
+    return false;
+}
+
+
+bool FrameMotion::Empty() const
+{
+    return rect.left >= rect.right || rect.top >= rect.bottom;
+}
+
+
+void FrameMotion::Clear()
+{
+    rect = {};
+    dx = 0;
+    dy = 0;
+}
+
+
+void FrameMotion::Reset()
+{
+    Clear();
+    remainder.Reset();
+}
+
+
+UINT DirtyRectMerger::Merge(const DirtyTiles& tiles)
+{
+    count_ = 0;
+    pixelCount_ = 0;
+    if (tiles.Empty() || tiles.GetDirtyCount() == 0) return 0;
+
+    const UINT columns = tiles.GetColumnCount();
+    const UINT rows = tiles.GetRowCount();
+    rects_.ExpandIfNeeded(columns * rows);
+    openRects_.ExpandIfNeeded(columns * 2);
+
+    int* previous = openRects_.Get();
+    int* current = openRects_.Get() + columns;
+    std::fill(previous, previous + columns, -1);
+
+    for (UINT row = 0; row < rows; ++row)
+    {
+        std::fill(current, current + columns, -1);
+
+        for (UINT column = 0; column < columns;)
+        {
+            if (!tiles.IsDirty(column, row))
+            {
+                ++column;
+                continue;
+            }
+
+            UINT end = column + 1;
+            while (end < columns && tiles.IsDirty(end, row)) ++end;
+
+            const RECT first = tiles.GetTileRect(column, row);
+            const RECT last = tiles.GetTileRect(end - 1, row);
+
+            // Grow the box above if it spans the same columns.
+            const int above = previous[column];
+            if (above >= 0 && rects_[above].right == last.right)
+            {
+                rects_[above].bottom = last.bottom;
+                current[column] = above;
+            }
+            else
+            {
+                rects_[count_] = RECT { first.left, first.top, last.right, last.bottom };
+                current[column] = static_cast<int>(count_++);
+            }
+
+            column = end;
+        }
+
+        std::swap(previous, current);
+    }
+
+    for (UINT i = 0; i < count_; ++i)
+    {
+        const RECT& rect = rects_[i];
+        pixelCount_ += static_cast<UINT64>(rect.right - rect.left) * (rect.bottom - rect.top);
+    }
+
+    return count_;
+}
+
+
+const RECT* DirtyRectMerger::GetRects() const
+{
+    return rects_.Get();
+}
+
+
+UINT DirtyRectMerger::GetCount() const
+{
+    return count_;
+}
+
+
+UINT64 DirtyRectMerger::GetPixelCount() const
+{
+    return pixelCount_;
+}
+
+
+bool TileHasher::Update(const ConstImageView<PixelFormatBGRA8>& frame, UINT x, UINT y, UINT width, UINT height, UINT maxThreadCount, DirtyTiles* dirty, FrameMotion* motion)
+{
+    if (motion) motion->Clear();
+
+    const auto region = frame.Crop(x, y, width, height);
+    if (region.Empty() || width == 0 || height == 0)
+    {
+        Reset();
+        dirty->Reset();
+        return false;
+    }
+
+    const UINT columns = (width + kTileSize - 1) / kTileSize;
+    const UINT rows = (height + kTileSize - 1) / kTileSize;
+    const bool isSameRegion = hasHashes_ && x == x_ && y == y_ && width == width_ && height == height_;
+    const bool hashLines = motion != nullptr;
+
+    hashes_.ExpandIfNeeded(columns * rows);
+    newHashes_.ExpandIfNeeded(columns * rows);
+    lanes_.ExpandIfNeeded(columns * rows * 4);
+    dirty->flags_.ExpandIfNeeded(columns * rows);
+    dirty->x_ = x;
+    dirty->y_ = y;
+    dirty->width_ = width;
+    dirty->height_ = height;
+    dirty->columns_ = columns;
+    dirty->rows_ = rows;
+
+    if (hashLines)
+    {
+        rowHashes_.ExpandIfNeeded(height * columns);
+        columnHashes_.ExpandIfNeeded(width * rows);
+        columnLanes_.ExpandIfNeeded(width * rows);
+    }
+
+    const UINT64* previousHashes = hashes_.Get();
+    UINT64* hashes = newHashes_.Get();
+    BYTE* flags = dirty->flags_.Get();
+
+    // Each tile row has its own lanes, so the bands hash in parallel. A tile hash folds the
+    // hashes of its rows, which double as the row hashes for scroll detection.
+    RunRowBands(rows, width * kTileSize, maxThreadCount, [&](UINT begin, UINT end)
+    {
+        for (UINT row = begin; row < end; ++row)
+        {
+            UINT64* lanes = lanes_.Get() + row * columns * 4;
+            UINT64* tileHashes = hashes + row * columns;
+            std::fill(tileHashes, tileHashes + columns, 0ull);
+
+            UINT* columnLanes = hashLines ? columnLanes_.Get() + row * width : nullptr;
+            if (hashLines)
+            {
+                std::fill(columnLanes, columnLanes + width, kColumnSeed);
+            }
+
+            const UINT rowEnd = std::min<UINT>((row + 1) * kTileSize, height);
+            for (UINT py = row * kTileSize; py < rowEnd; ++py)
+            {
+                for (UINT column = 0; column < columns; ++column)
+                {
+                    memcpy(lanes + column * 4, kLaneSeeds, sizeof(kLaneSeeds));
+                }
+
+                const BYTE* src = region.GetRow(py);
+                PixelKernels::HashTileRow(src, width, kTileSize, lanes);
+                if (hashLines)
+                {
+                    PixelKernels::HashColumns(src, width, columnLanes);
+                }
+
+                for (UINT column = 0; column < columns; ++column)
+                {
+                    const UINT64 hash = FoldLanes(lanes + column * 4);
+                    tileHashes[column] = Mix(tileHashes[column], hash);
+                    if (hashLines)
+                    {
+                        rowHashes_[py * columns + column] = hash;
+                    }
+                }
+            }
+
+            for (UINT column = 0; column < columns; ++column)
+            {
+                const UINT index = row * columns + column;
+                flags[index] = !isSameRegion || previousHashes[index] != hashes[index];
+            }
+
+            // Mixing spreads the 32 bit column hashes over the bits that the estimator looks up.
+            if (hashLines)
+            {
+                for (UINT px = 0; px < width; ++px)
+                {
+                    columnHashes_[px * rows + row] = Mix(0, columnLanes[px]);
+                }
+            }
+        }
+    });
+
+    std::swap(hashes_, newHashes_);
+    dirty->dirtyCount_ = static_cast<UINT>(std::count(flags, flags + columns * rows, 1));
+
+    // The tile hashes already cover the region, so the frame hash folds them together with the
+    // pixels around the region, which readers of the whole buffer see as well.
+    UINT64 frameHash = Mix(Mix(0, (static_cast<UINT64>(x) << 32) | y), (static_cast<UINT64>(width) << 32) | height);
+    for (UINT i = 0; i < columns * rows; ++i)
+    {
+        frameHash = Mix(frameHash, hashes[i]);
+    }
+    frameHash_ = Mix(frameHash, HashMargins(frame, x, y, width, height));
+
+    if (hashLines)
+    {
+        if (isSameRegion && hasLineHashes_ && dirty->dirtyCount_ > 0)
+        {
+            EstimateMotion(*dirty, motion);
+        }
+        std::swap(rowHashes_, previousRowHashes_);
+        std::swap(columnHashes_, previousColumnHashes_);
+    }
+    hasLineHashes_ = hashLines;
+
+    x_ = x;
+    y_ = y;
+    width_ = width;
+    height_ = height;
+    hasHashes_ = true;
+
+    return true;
+}
+
+
+UINT64 TileHasher::HashMargins(const ConstImageView<PixelFormatBGRA8>& frame, UINT x, UINT y, UINT width, UINT height)
+{
+    // The margins are usually a few pixels of window border and shadow, so they are hashed on
+    // this thread, a row or the parts of a row left and right of the region at a time.
+    const UINT frameWidth = frame.GetWidth();
+    marginLanes_.ExpandIfNeeded((frameWidth + kTileSize - 1) / kTileSize * 4);
+
+    UINT64 hash = Mix(0, (static_cast<UINT64>(frameWidth) << 32) | frame.GetHeight());
+    const auto hashSpan = [&](const BYTE* src, UINT spanWidth)
+    {
+        const UINT tileCount = (spanWidth + kTileSize - 1) / kTileSize;
+        for (UINT i = 0; i < tileCount; ++i)
+        {
+            memcpy(marginLanes_.Get() + i * 4, kLaneSeeds, sizeof(kLaneSeeds));
+        }
+        PixelKernels::HashTileRow(src, spanWidth, kTileSize, marginLanes_.Get());
+        for (UINT i = 0; i < tileCount; ++i)
+        {
+            hash = Mix(hash, FoldLanes(marginLanes_.Get() + i * 4));
+        }
+    };
+
+    for (UINT py = 0; py < frame.GetHeight(); ++py)
+    {
+        const BYTE* src = frame.GetRow(py);
+        if (py < y || py >= y + height)
+        {
+            hashSpan(src, frameWidth);
+        }
+        else
+        {
+            hashSpan(src, x);
+            hashSpan(src + (x + width) * 4, frameWidth - x - width);
+        }
+    }
+    return hash;
+}
+
+
+void TileHasher::EstimateMotion(const DirtyTiles& dirty, FrameMotion* motion)
+{
+    const UINT columns = dirty.columns_;
+    const UINT rows = dirty.rows_;
+
+    // Only the tile columns and rows with changes can take part in a scroll.
+    UINT firstColumn = columns;
+    UINT endColumn = 0;
+    UINT firstRow = rows;
+    UINT endRow = 0;
+    for (UINT row = 0; row < rows; ++row)
+    {
+        for (UINT column = 0; column < columns; ++column)
+        {
+            if (!dirty.IsDirty(column, row)) continue;
+            firstColumn = std::min<UINT>(firstColumn, column);
+            endColumn = std::max<UINT>(endColumn, column + 1);
+            firstRow = std::min<UINT>(firstRow, row);
+            endRow = std::max<UINT>(endRow, row + 1);
+        }
+    }
+
+    ScrollEstimator::Result vertical;
+    ScrollEstimator::Result horizontal;
+    const bool isVertical = scrollEstimator_.Estimate(previousRowHashes_.Get(), rowHashes_.Get(), dirty.height_, columns, firstColumn, endColumn, &vertical);
+    const bool isHorizontal = scrollEstimator_.Estimate(previousColumnHashes_.Get(), columnHashes_.Get(), dirty.width_, rows, firstRow, endRow, &horizontal);
+    if (!isVertical && !isHorizontal) return;
+
+    const bool useVertical = isVertical && (!isHorizontal || vertical.votes >= horizontal.votes);
+    const ScrollEstimator::Result& result = useVertical ? vertical : horizontal;
+
+    // A tile stays dirty if any of its lines differs from the moved previous frame, including
+    // tiles that were clean but are covered by the move.
+    DirtyTiles& remainder = motion->remainder;
+    remainder.flags_.ExpandIfNeeded(columns * rows);
+    remainder.x_ = dirty.x_;
+    remainder.y_ = dirty.y_;
+    remainder.width_ = dirty.width_;
+    remainder.height_ = dirty.height_;
+    remainder.columns_ = columns;
+    remainder.rows_ = rows;
+
+    UINT dirtyCount = 0;
+    for (UINT row = 0; row < rows; ++row)
+    {
+        for (UINT column = 0; column < columns; ++column)
+        {
+            const RECT tile = dirty.GetTileRect(column, row);
+            bool isDirty = false;
+            if (useVertical)
+            {
+                for (UINT py = tile.top - dirty.y_; py < tile.bottom - dirty.y_ && !isDirty; ++py)
+                {
+                    isDirty = !ScrollEstimator::IsPredicted(previousRowHashes_.Get(), rowHashes_.Get(), columns, result, py, column);
+                }
+            }
+            else
+            {
+                for (UINT px = tile.left - dirty.x_; px < tile.right - dirty.x_ && !isDirty; ++px)
+                {
+                    isDirty = !ScrollEstimator::IsPredicted(previousColumnHashes_.Get(), columnHashes_.Get(), rows, result, px, row);
+                }
+            }
+            remainder.flags_[row * columns + column] = isDirty;
+            dirtyCount += isDirty;
+        }
+    }
+    remainder.dirtyCount_ = dirtyCount;
+
+    // A move that leaves as many tiles to upload is not worth a copy.
+    if (dirtyCount >= dirty.dirtyCount_) return;
+
+    if (useVertical)
+    {
+        motion->rect =
+        {
+            static_cast<LONG>(dirty.x_ + result.firstStrip * kTileSize),
+            static_cast<LONG>(dirty.y_ + result.firstLine),
+            static_cast<LONG>(dirty.x_ + std::min<UINT>(result.endStrip * kTileSize, dirty.width_)),
+            static_cast<LONG>(dirty.y_ + result.endLine),
+        };
+        motion->dy = result.offset;
+    }
+    else
+    {
+        motion->rect =
+        {
+            static_cast<LONG>(dirty.x_ + result.firstLine),
+            static_cast<LONG>(dirty.y_ + result.firstStrip * kTileSize),
+            static_cast<LONG>(dirty.x_ + result.endLine),
+            static_cast<LONG>(dirty.y_ + std::min<UINT>(result.endStrip * kTileSize, dirty.height_)),
+        };
+        motion->dx = result.offset;
+    }
+}
+
+
+void TileHasher::Reset()
+{
+    hashes_.Reset();
+    newHashes_.Reset();
+    lanes_.Reset();
+    rowHashes_.Reset();
+    columnHashes_.Reset();
+    previousRowHashes_.Reset();
+    previousColumnHashes_.Reset();
+    columnLanes_.Reset();
+    marginLanes_.Reset();
+    frameHash_ = 0;
+    hasHashes_ = false;
+    hasLineHashes_ = false;
+}
+
+
+UINT64 TileHasher::GetFrameHash() const
+{
+    return frameHash_;
+}
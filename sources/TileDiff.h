@@ -0,0 +1,127 @@
+#pragma once
+
+#include <Windows.h>
+
+#include "Buffer.h"
+#include "Image.h"
+#include "ScrollEstimator.h"
+
+// Which tiles of a region of a frame changed since the previous frame, one flag per tile in
+// row-major order. The region and the rectangles are in frame coordinates, and the tiles at
+// the right and bottom edges of the region may be smaller. Without tiles, as before the first
+// hash or after Reset(), nothing is known and every query treats the frame as changed.
+class DirtyTiles
+{
+public:
+    static constexpr UINT kTileSize = 64;
+
+    void Reset();
+
+    bool Empty() const;
+    RECT GetRegion() const;
+    UINT GetColumnCount() const;
+    UINT GetRowCount() const;
+    UINT GetDirtyCount() const;
+    size_t GetCapacity() const;
+
+    bool IsDirty(UINT column, UINT row) const;
+    RECT GetTileRect(UINT column, UINT row) const;
+
+    // Writes the rectangles of up to maxCount dirty tiles and returns the number of dirty tiles.
+    UINT GetRects(RECT* rects, UINT maxCount) const;
+
+    // True if a dirty tile overlaps the rectangle, or if the rectangle is not inside the region.
+    bool Intersects(const RECT& rect) const;
+
+private:
+    friend class TileHasher;
+
+    Buffer<BYTE> flags_;
+    UINT x_ = 0;
+    UINT y_ = 0;
+    UINT width_ = 0;
+    UINT height_ = 0;
+    UINT columns_ = 0;
+    UINT rows_ = 0;
+    UINT dirtyCount_ = 0;
+};
+
+
+// A change of a frame described as a part of the previous frame that moved, e.g. a scroll,
+// plus the tiles that the move does not explain. Empty when no move was found.
+struct FrameMotion
+{
+    // Where the moved pixels are in the frame. They were at rect offset by (-dx, -dy).
+    RECT rect = {};
+    int dx = 0;
+    int dy = 0;
+    // The tiles that differ from the previous frame once the move is applied.
+    DirtyTiles remainder;
+
+    bool Empty() const;
+    // Clear() keeps the remainder allocated for the next frame, Reset() frees it.
+    void Clear();
+    void Reset();
+};
+
+
+// Merges the dirty tiles into few boxes: runs of dirty tiles within a tile row first, and then
+// runs of tile rows with the same span. The boxes are in frame coordinates, sorted by top.
+class DirtyRectMerger
+{
+public:
+    // Returns the number of boxes, which stay valid until the next call.
+    UINT Merge(const DirtyTiles& tiles);
+
+    const RECT* GetRects() const;
+    UINT GetCount() const;
+    UINT64 GetPixelCount() const;
+
+private:
+    Buffer<RECT> rects_;
+    // The box ending at the previous and the current tile row that starts at each column, or -1.
+    Buffer<int> openRects_;
+    UINT count_ = 0;
+    UINT64 pixelCount_ = 0;
+};
+
+
+// Keeps the tile hashes of the previous frame for the capture thread. A tile is a 64 bit hash
+// of its pixels, so comparing frames reads each pixel once and never needs the previous frame.
+class TileHasher
+{
+public:
+    // Hashes the tiles of the region and marks those whose hash differs from the previous call.
+    // Every tile is dirty when the region moves or is resized, and after Reset().
+    // With motion, also hashes every row and column to look for a scroll since the previous call.
+    bool Update(const ConstImageView<PixelFormatBGRA8>& frame, UINT x, UINT y, UINT width, UINT height, UINT maxThreadCount, DirtyTiles* dirty, FrameMotion* motion = nullptr);
+    void Reset();
+
+    // Hash of the whole frame as of the last Update(): the tiles of the region, its position and
+    // size, and the pixels outside the region, so that a change in the margins changes it too.
+    UINT64 GetFrameHash() const;
+
+private:
+    UINT64 HashMargins(const ConstImageView<PixelFormatBGRA8>& frame, UINT x, UINT y, UINT width, UINT height);
+    void EstimateMotion(const DirtyTiles& dirty, FrameMotion* motion);
+
+    Buffer<UINT64> hashes_;
+    Buffer<UINT64> newHashes_;
+    Buffer<UINT64> lanes_;
+    // For scroll detection, a hash per row of each tile column and per column of each tile row,
+    // of this frame and of the previous one.
+    Buffer<UINT64> rowHashes_;
+    Buffer<UINT64> columnHashes_;
+    Buffer<UINT64> previousRowHashes_;
+    Buffer<UINT64> previousColumnHashes_;
+    Buffer<UINT> columnLanes_;
+    Buffer<UINT64> marginLanes_;
+    ScrollEstimator scrollEstimator_;
+    UINT x_ = 0;
+    UINT y_ = 0;
+    UINT width_ = 0;
+    UINT height_ = 0;
+    UINT64 frameHash_ = 0;
+    bool hasHashes_ = false;
+    bool hasLineHashes_ = false;
+};
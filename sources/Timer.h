@@ -1,37 +1,72 @@
 #pragma once
 
 #include <chrono>
-#include <functional>
+#include <type_traits>
+#include <utility>
 
+// The callbacks are stored inline instead of in std::function, so a guard never allocates
+// and the call can be inlined. Use the Make* functions to deduce the lambda type.
+template <class Func>
 class ScopedReleaser
 {
 public:
-    using ReleaseFuncType = std::function<void()>;
-    ScopedReleaser(ReleaseFuncType&& func) : func_(func) {}
-    ~ScopedReleaser() { func_(); }
+    explicit ScopedReleaser(Func func) : func_(std::move(func)) {}
+    ScopedReleaser(ScopedReleaser&& other) : func_(std::move(other.func_)), isActive_(other.isActive_) { other.isActive_ = false; }
+    ~ScopedReleaser() { if (isActive_) func_(); }
+
+    ScopedReleaser(const ScopedReleaser&) = delete;
+    ScopedReleaser& operator=(const ScopedReleaser&) = delete;
+    ScopedReleaser& operator=(ScopedReleaser&&) = delete;
 
 private:
-    const ReleaseFuncType func_;
+    Func func_;
+    bool isActive_ = true;
 };
 
+template <class Func>
+ScopedReleaser<typename std::decay<Func>::type> MakeScopedReleaser(Func&& func)
+{
+    return ScopedReleaser<typename std::decay<Func>::type>(std::forward<Func>(func));
+}
+
+template <class Func>
 class ScopedTimer
 {
 public:
     using microseconds = std::chrono::microseconds;
-    using TimerFuncType = std::function<void(microseconds)>;
-    ScopedTimer(TimerFuncType&& func)
-        : func_(func)
-        , start_(std::chrono::high_resolution_clock::now())
+
+    explicit ScopedTimer(Func func)
+        : func_(std::move(func))
+        , start_(std::chrono::steady_clock::now())
+    {
+    }
+    ScopedTimer(ScopedTimer&& other)
+        : func_(std::move(other.func_))
+        , start_(other.start_)
+        , isActive_(other.isActive_)
     {
+        other.isActive_ = false;
     }
     ~ScopedTimer()
     {
-        const auto end = std::chrono::high_resolution_clock::now();
+        if (!isActive_) return;
+        const auto end = std::chrono::steady_clock::now();
         const auto time = std::chrono::duration_cast<microseconds>(end - start_);
         func_(time);
     }
 
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(ScopedTimer&&) = delete;
+
 private:
-    const TimerFuncType func_;
-    const std::chrono::time_point<std::chrono::steady_clock> start_;
-};
\ No newline at end of file
+    Func func_;
+    const std::chrono::steady_clock::time_point start_;
+    bool isActive_ = true;
+};
+
+template <class Func>
+ScopedTimer<typename std::decay<Func>::type> MakeScopedTimer(Func&& func)
+{
+    return ScopedTimer<typename std::decay<Func>::type>(std::forward<Func>(func));
+}
\ No newline at end of file
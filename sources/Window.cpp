@@ -4,6 +4,7 @@
 #include "WindowTexture.h"
 #include "WindowIconTexture.h"
 #include "WindowManager.h"
+#include "AllocationCounter.h"
 
 Window::Window(int id)
     : id_(id)
@@ -202,12 +203,74 @@ UINT Window::GetZOrder() const
 }
 
 
+DWORD Window::GetMonitorOrientation() const
+{
+    return data1_.orientation;
+}
+
+
 BYTE* Window::GetBuffer() const
 {
+    Touch();
     return windowTexture_->GetBuffer();
 }
 
 
+bool Window::AcquireSnapshot(FrameSnapshot* snapshot) const
+{
+    Touch();
+    return windowTexture_->AcquireSnapshot(snapshot);
+}
+
+
+int Window::GetDirtyTileCount() const
+{
+    return windowTexture_->GetDirtyTileCount();
+}
+
+
+void Window::SetPartialUploadRatio(float ratio)
+{
+    windowTexture_->SetPartialUploadRatio(ratio);
+}
+
+
+float Window::GetPartialUploadRatio() const
+{
+    return windowTexture_->GetPartialUploadRatio();
+}
+
+
+UploadStats Window::GetUploadStats() const
+{
+    return windowTexture_->GetUploadStats();
+}
+
+
+CaptureRateStats Window::GetCaptureRateStats() const
+{
+    return captureRate_.GetStats(CaptureRateController::GetTime());
+}
+
+
+void Window::SetScrollDetection(bool enabled)
+{
+    windowTexture_->SetScrollDetection(enabled);
+}
+
+
+bool Window::GetScrollDetection() const
+{
+    return windowTexture_->GetScrollDetection();
+}
+
+
+UINT64 Window::GetSuppressedFrameCount() const
+{
+    return windowTexture_->GetSuppressedFrameCount();
+}
+
+
 UINT Window::GetTextureWidth() const
 {
     return windowTexture_->GetWidth();
@@ -280,6 +343,18 @@ ID3D11Texture2D* Window::GetIconTexture() const
 }
 
 
+void Window::SetIconAlphaMode(AlphaMode mode)
+{
+    iconTexture_->SetAlphaMode(mode);
+}
+
+
+AlphaMode Window::GetIconAlphaMode() const
+{
+    return iconTexture_->GetAlphaMode();
+}
+
+
 void Window::SetCaptureMode(CaptureMode mode)
 {
     windowTexture_->SetCaptureMode(mode);
@@ -298,18 +373,118 @@ bool Window::GetCursorDraw() const
 }
 
 
+void Window::SetRotation(FrameRotation rotation)
+{
+    windowTexture_->SetRotation(rotation);
+}
+
+
+FrameRotation Window::GetRotation() const
+{
+    return windowTexture_->GetRotation();
+}
+
+
+void Window::SetMirror(bool mirror)
+{
+    windowTexture_->SetMirror(mirror);
+}
+
+
+bool Window::GetMirror() const
+{
+    return windowTexture_->GetMirror();
+}
+
+
+void Window::SetOutputSize(UINT width, UINT height)
+{
+    windowTexture_->SetOutputSize(width, height);
+}
+
+
+void Window::SetOutputFilter(ResampleFilter filter)
+{
+    windowTexture_->SetOutputFilter(filter);
+}
+
+
+ResampleFilter Window::GetOutputFilter() const
+{
+    return windowTexture_->GetOutputFilter();
+}
+
+
+void Window::SetMipGeneration(bool enabled)
+{
+    windowTexture_->SetMipGeneration(enabled);
+}
+
+
+bool Window::GetMipGeneration() const
+{
+    return windowTexture_->GetMipGeneration();
+}
+
+
+UINT64 Window::GetMipGenerationTime() const
+{
+    return windowTexture_->GetMipGenerationTime();
+}
+
+
+UINT Window::GetMipLevelCount() const
+{
+    return windowTexture_->GetMipLevelCount();
+}
+
+
+bool Window::AcquireMipSnapshot(UINT level, FrameSnapshot* snapshot) const
+{
+    Touch();
+    return windowTexture_->AcquireMipSnapshot(level, snapshot);
+}
+
+
+void Window::SetBufferGrowthPolicy(const BufferGrowthPolicy& policy)
+{
+    windowTexture_->SetBufferGrowthPolicy(policy);
+}
+
+
+BufferGrowthPolicy Window::GetBufferGrowthPolicy() const
+{
+    return windowTexture_->GetBufferGrowthPolicy();
+}
+
+
+BufferStats Window::GetBufferStats() const
+{
+    return windowTexture_->GetBufferStats();
+}
+
+
 UINT Window::GetPixel(int x, int y) const
 {
+    Touch();
     return windowTexture_->GetPixel(x, y);
 }
 
 
 bool Window::GetPixels(BYTE* output, int x, int y, int width, int height) const
 {
+    Touch();
     return windowTexture_->GetPixels(output, x, y, width, height);
 }
 
 
+bool Window::GetPixelsAs(OutputFormat format, BYTE* output, UINT outputSize, int x, int y, int width, int height) const
+{
+    Touch();
+    return windowTexture_->GetPixelsAs(format, output, outputSize, x, y, width, height);
+}
+
+
 CaptureMode Window::GetCaptureMode() const
 {
     return windowTexture_->GetCaptureMode();
@@ -322,12 +497,37 @@ void Window::RequestUpdateTitle()
 }
 
 
+void Window::Touch() const
+{
+    lastRequestedTime_ = ::GetTickCount64();
+}
+
+
+UINT64 Window::GetLastRequestedTime() const
+{
+    return lastRequestedTime_;
+}
+
+
+size_t Window::EvictBuffers()
+{
+    return windowTexture_->EvictBuffers() + iconTexture_->EvictBuffer();
+}
+
+
+size_t Window::CompressBuffers()
+{
+    return windowTexture_->CompressBuffers();
+}
+
+
 void Window::UpdateTitle()
 {
     if (!IsDesktop())
     {
         constexpr UINT timeout = 100 /* milliseconds */;
-        GetWindowTitle(data1_.hWnd, data2_.title, timeout);
+        arena_.Reset();
+        GetWindowTitle(data1_.hWnd, data2_.title, timeout, arena_);
     }
     else
     {
@@ -363,7 +563,7 @@ void Window::UpdateIsBackground()
 }
 
 
-void Window::Capture()
+void Window::Capture(const CaptureRateSettings& rateSettings)
 {
     // Run this scope in the thread loop managed by CaptureManager.
 
@@ -378,9 +578,27 @@ void Window::Capture()
         return;
     }
 
+    // A window that has not changed for a while is captured less often. A frame that has to
+    // be published, e.g. for a new texture, is not held back.
+    const UINT64 now = CaptureRateController::GetTime();
+    if (!captureRate_.IsDue(rateSettings, now) && !windowTexture_->IsPublishPending())
+    {
+        captureRate_.OnSkipped();
+        return;
+    }
+
     SCOPE_TIMER(WindowCapture)
+    ALLOCATION_CHECK(WindowCapture)
 
-        if (windowTexture_->Capture())
+        // A suppressed frame was identical to the published one, so the window has not changed.
+        // A failed capture says nothing about the window and leaves the capture rate as it is.
+        const CaptureResult result = windowTexture_->Capture();
+        if (result != CaptureResult::Failed)
+        {
+            captureRate_.OnCaptured(rateSettings, now, result == CaptureResult::Captured);
+        }
+
+        if (result == CaptureResult::Captured)
         {
             if (auto& uploader = WindowManager::GetUploadManager())
             {
@@ -394,6 +612,8 @@ void Window::Upload()
 {
     // Run this scope in the thread loop managed by UploadManager.
 
+    ALLOCATION_CHECK(WindowUpload)
+
     if (windowTexture_->Upload())
     {
         hasNewWindowTextureUploaded_ = true;
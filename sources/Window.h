@@ -7,10 +7,18 @@
 #include <atomic>
 #include <vector>
 
+#include "Arena.h"
 #include "Buffer.h"
+#include "CaptureRate.h"
 #include "Timer.h"
 
 enum class CaptureMode;
+enum class ResampleFilter;
+enum class OutputFormat;
+enum class AlphaMode;
+enum class FrameRotation;
+struct FrameSnapshot;
+struct UploadStats;
 
 class Window
 {
@@ -25,6 +33,8 @@ public:
         RECT windowRect;
         RECT clientRect;
         UINT zOrder;
+        // DMDO_DEFAULT, DMDO_90, DMDO_180 or DMDO_270 of the monitor of a desktop.
+        DWORD orientation;
     };
 
     struct Data2
@@ -65,7 +75,17 @@ public:
     UINT GetClientWidth() const;
     UINT GetClientHeight() const;
     UINT GetZOrder() const;
+    DWORD GetMonitorOrientation() const;
     BYTE* GetBuffer() const;
+    bool AcquireSnapshot(FrameSnapshot* snapshot) const;
+    int GetDirtyTileCount() const;
+    UINT64 GetSuppressedFrameCount() const;
+    void SetPartialUploadRatio(float ratio);
+    float GetPartialUploadRatio() const;
+    UploadStats GetUploadStats() const;
+    CaptureRateStats GetCaptureRateStats() const;
+    void SetScrollDetection(bool enabled);
+    bool GetScrollDetection() const;
     UINT GetTextureWidth() const;
     UINT GetTextureHeight() const;
     UINT GetTextureOffsetX() const;
@@ -81,6 +101,8 @@ public:
 
     void SetIconTexture(ID3D11Texture2D* ptr);
     ID3D11Texture2D* GetIconTexture() const;
+    void SetIconAlphaMode(AlphaMode mode);
+    AlphaMode GetIconAlphaMode() const;
 
     void SetCaptureMode(CaptureMode mode);
     CaptureMode GetCaptureMode() const;
@@ -88,12 +110,37 @@ public:
     void SetCursorDraw(bool draw);
     bool GetCursorDraw() const;
 
+    void SetRotation(FrameRotation rotation);
+    FrameRotation GetRotation() const;
+    void SetMirror(bool mirror);
+    bool GetMirror() const;
+
+    void SetOutputSize(UINT width, UINT height);
+    void SetOutputFilter(ResampleFilter filter);
+    ResampleFilter GetOutputFilter() const;
+
+    void SetMipGeneration(bool enabled);
+    bool GetMipGeneration() const;
+    UINT64 GetMipGenerationTime() const;
+    UINT GetMipLevelCount() const;
+    bool AcquireMipSnapshot(UINT level, FrameSnapshot* snapshot) const;
+
+    void SetBufferGrowthPolicy(const BufferGrowthPolicy& policy);
+    BufferGrowthPolicy GetBufferGrowthPolicy() const;
+    BufferStats GetBufferStats() const;
+
     UINT GetPixel(int x, int y) const;
     bool GetPixels(BYTE* output, int x, int y, int width, int height) const;
+    bool GetPixelsAs(OutputFormat format, BYTE* output, UINT outputSize, int x, int y, int width, int height) const;
 
     void RequestUpdateTitle();
 
-    void Capture();
+    void Touch() const;
+    UINT64 GetLastRequestedTime() const;
+    size_t EvictBuffers();
+    size_t CompressBuffers();
+
+    void Capture(const CaptureRateSettings& rateSettings);
     void Upload();
     void Render();
 
@@ -123,6 +170,8 @@ private:
     std::shared_ptr<class IconTexture> iconTexture_ = std::make_shared<IconTexture>(this);
     Data1 data1_;
     Data2 data2_;
+    Arena arena_;
+    CaptureRateController captureRate_;
 
     const int id_ = -1;
     int parentId_ = -1;
@@ -133,4 +182,5 @@ private:
     std::atomic<bool> hasNewWindowTextureUploaded_ = false;
     std::atomic<bool> hasNewIconTextureUploaded_ = false;
     std::atomic<bool> isAlive_ = true;
+    mutable std::atomic<UINT64> lastRequestedTime_ = ::GetTickCount64();
 };
\ No newline at end of file
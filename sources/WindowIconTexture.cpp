@@ -1,5 +1,6 @@
 #include "pch.h"
 #include "WindowIconTexture.h"
+#include "Image.h"
 #include "Window.h"
 #include "WindowManager.h"
 #include "UploadManager.h"
@@ -46,6 +47,19 @@ ID3D11Texture2D* IconTexture::GetUnityTexturePtr() const
 }
 
 
+void IconTexture::SetAlphaMode(AlphaMode mode)
+{
+    if (mode == AlphaMode::Ignore) mode = AlphaMode::Straight;
+    alphaMode_ = mode;
+}
+
+
+AlphaMode IconTexture::GetAlphaMode() const
+{
+    return alphaMode_;
+}
+
+
 bool IconTexture::CaptureOnce()
 {
     if (hasCaptured_) return false;
@@ -78,14 +92,14 @@ bool IconTexture::CaptureOnce()
         OutputApiError(__FUNCTION__, "GetIconInfo");
         return false;
     }
-    ScopedReleaser iconReleaser([&] 
+    const auto iconReleaser = MakeScopedReleaser([&] 
     { 
         ::DeleteObject(info.hbmColor); 
         ::DeleteObject(info.hbmMask); 
     });
 
     auto hDcMem = ::CreateCompatibleDC(NULL);
-    ScopedReleaser hDcReleaser([&] { ::DeleteDC(hDcMem); });
+    const auto hDcReleaser = MakeScopedReleaser([&] { ::DeleteDC(hDcMem); });
 
     BITMAPINFOHEADER bmi {};
     bmi.biWidth       = static_cast<LONG>(width);
@@ -97,41 +111,49 @@ bool IconTexture::CaptureOnce()
     bmi.biSizeImage   = 0;
 
     // Get color image
-    Buffer<BYTE> color;
-    color.ExpandIfNeeded(width * height * 4);
-    if (!::GetDIBits(hDcMem, info.hbmColor, 0, height, color.Get(), reinterpret_cast<BITMAPINFO*>(&bmi), DIB_RGB_COLORS))
+    Image<PixelFormatBGRA8> color(width, height);
+    if (!::GetDIBits(hDcMem, info.hbmColor, 0, height, color.GetData(), reinterpret_cast<BITMAPINFO*>(&bmi), DIB_RGB_COLORS))
     {
         OutputApiError(__FUNCTION__, "GetDIBits");
         return false;
     }
     
-    // Get mask image
-    Buffer<BYTE> mask;
-    mask.ExpandIfNeeded(width * height * 4);
-    if (!::GetDIBits(hDcMem, info.hbmMask, 0, height, mask.Get(), reinterpret_cast<BITMAPINFO*>(&bmi), DIB_RGB_COLORS))
+    // 32-bit icons carry their own alpha channel, so the mask is only needed for the older ones.
+    const bool hasAlpha = PixelKernels::HasAlpha(color.GetData(), width * height);
+
+    Image<PixelFormatBGRA8> mask;
+    if (!hasAlpha)
     {
-        OutputApiError(__FUNCTION__, "GetDIBits");
-        return false;
+        mask.Create(width, height);
+        if (!::GetDIBits(hDcMem, info.hbmMask, 0, height, mask.GetData(), reinterpret_cast<BITMAPINFO*>(&bmi), DIB_RGB_COLORS))
+        {
+            OutputApiError(__FUNCTION__, "GetDIBits");
+            return false;
+        }
     }
 
     {
         std::lock_guard<std::mutex> lock(bufferMutex_);
         buffer_.ExpandIfNeeded(width * height * 4);
 
-        auto buffer32 = buffer_.As<UINT>();
-        auto color32 = color.As<UINT>();
-        auto mask32 = mask.As<UINT>();
+        const auto output = ImageView<PixelFormatBGRA8>(buffer_.Get(), width, height).FlipVertical();
+        const auto colorView = color.GetView();
 
-        const auto n = width * height;
-        for (UINT x = 0; x < width; ++x) 
+        if (hasAlpha)
+        {
+            ConvertPixels(colorView, output);
+        }
+        else
         {
+            // Same AND/XOR mask rules as cursors, so that the result has straight alpha too.
+            const auto maskView = mask.GetView();
             for (UINT y = 0; y < height; ++y)
             {
-                const auto i = y * width + x;
-                const auto j = (height - 1 - y) * width + x;
-                buffer32[j] = color32[i] ^ mask32[i];
+                PixelKernels::ApplyCursorMask(colorView.GetRow(y), maskView.GetRow(y), output.GetRow(y), width);
             }
         }
+
+        ConvertAlphaMode(output, AlphaMode::Straight, alphaMode_);
     }
 
     hasCaptured_ = true;
@@ -190,6 +212,24 @@ bool IconTexture::UploadOnce()
 }
 
 
+size_t IconTexture::EvictBuffer()
+{
+    // Keep the buffer until it has reached the GPU.
+    if (!hasUploaded_) return 0;
+
+    std::lock_guard<std::mutex> lock(bufferMutex_);
+
+    const size_t freed = buffer_.Capacity();
+    buffer_.Reset();
+
+    // Allow the icon to be captured again if it is requested later.
+    hasCaptured_ = false;
+    hasUploaded_ = false;
+
+    return freed;
+}
+
+
 bool IconTexture::RenderOnce()
 {
     if (hasRendered_) return true;
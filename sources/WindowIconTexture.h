@@ -8,6 +8,7 @@
 #include <atomic>
 
 #include "Buffer.h"
+#include "Image.h"
 
 class Window;
 
@@ -23,10 +24,17 @@ public:
     void SetUnityTexturePtr(ID3D11Texture2D* ptr);
     ID3D11Texture2D* GetUnityTexturePtr() const;
 
+    // Alpha mode of the captured icon. Icons are captured with straight alpha and converted once
+    // if another mode is set; the mode applies from the next capture.
+    void SetAlphaMode(AlphaMode mode);
+    AlphaMode GetAlphaMode() const;
+
     bool CaptureOnce();
     bool UploadOnce();
     bool RenderOnce();
 
+    size_t EvictBuffer();
+
 private:
     Window* const window_ = nullptr;
 
@@ -37,6 +45,7 @@ private:
 
     Buffer<BYTE> buffer_;
     std::mutex bufferMutex_;
+    std::atomic<AlphaMode> alphaMode_ = AlphaMode::Straight;
 
     std::atomic<bool> hasCaptured_ = false;
     std::atomic<bool> hasUploaded_ = false;
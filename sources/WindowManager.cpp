@@ -79,7 +79,7 @@ bool IsUWP(DWORD pid)
     if (!GetPackageFamilyName) return false;
 
     auto process = ::OpenProcess(PROCESS_QUERY_INFORMATION, FALSE, pid);
-    ScopedReleaser releaser([&] { ::CloseHandle(process); });
+    const auto releaser = MakeScopedReleaser([&] { ::CloseHandle(process); });
 
     UINT32 len = 0;
     const auto res = GetPackageFamilyName(process, &len, NULL);
@@ -117,7 +117,7 @@ bool GetWindowTitle(HWND hWnd, std::wstring& outTitle)
 
     return false;
 }
-bool GetWindowTitle(HWND hWnd, std::wstring& outTitle, int timeout)
+bool GetWindowTitle(HWND hWnd, std::wstring& outTitle, int timeout, Arena& arena)
 {
     DWORD_PTR length = 0;
     if (FAILED(::SendMessageTimeoutW(hWnd, WM_GETTEXTLENGTH, 0, 0, SMTO_ABORTIFHUNG | SMTO_BLOCK, timeout, reinterpret_cast<PDWORD_PTR>(&length))))
@@ -126,14 +126,18 @@ bool GetWindowTitle(HWND hWnd, std::wstring& outTitle, int timeout)
     }
     if (length > 256) return false;
 
-    std::vector<WCHAR> buf(length + 1);
+    auto buf = arena.Allocate<WCHAR>(length + 1);
+    if (!buf) return false;
+    buf[0] = L'\0';
+
     DWORD_PTR result;
-    if (FAILED(::SendMessageTimeoutW(hWnd, WM_GETTEXT, buf.size(), reinterpret_cast<LPARAM>(&buf[0]), SMTO_ABORTIFHUNG | SMTO_BLOCK, timeout, reinterpret_cast<PDWORD_PTR>(&result))))
+    if (FAILED(::SendMessageTimeoutW(hWnd, WM_GETTEXT, length + 1, reinterpret_cast<LPARAM>(buf), SMTO_ABORTIFHUNG | SMTO_BLOCK, timeout, reinterpret_cast<PDWORD_PTR>(&result))))
     {
         return false;
     }
 
-    outTitle = &buf[0];
+    // Assigning an unchanged title would still reallocate if the string has to grow.
+    if (outTitle != buf) outTitle = buf;
     return true;
 }
 bool GetWindowClassName(HWND hWnd, std::string& outClassName)
@@ -212,6 +216,8 @@ void WindowManager::StartWindowHandleListThread()
         {
             UpdateWindowHandleList();
             UpdateWindows();
+            CompressIdleWindows();
+            EnforceMemoryBudget();
         }, std::chrono::milliseconds(16));
 }
 
@@ -313,6 +319,24 @@ std::shared_ptr<Window> WindowManager::GetCursorWindow() const
 }
 
 
+UINT64 WindowManager::GetEvictionCount() const
+{
+    return evictionCount_;
+}
+
+
+void WindowManager::SetCompressionIdleTime(UINT64 milliseconds)
+{
+    compressionIdleTime_ = milliseconds;
+}
+
+
+UINT64 WindowManager::GetCompressionIdleTime() const
+{
+    return compressionIdleTime_;
+}
+
+
 std::shared_ptr<Window> WindowManager::FindParentWindow(const std::shared_ptr<Window>& window) const
 {
     std::shared_ptr<Window> parent = nullptr;
@@ -511,6 +535,7 @@ void WindowManager::UpdateWindowHandleList()
         data.zOrder = ::GetWindowZOrder(hWnd);
         data.hMonitor = ::MonitorFromWindow(hWnd, MONITOR_DEFAULTTOPRIMARY);
         data.isDesktop = false;
+        data.orientation = DMDO_DEFAULT;
 
         auto thiz = reinterpret_cast<WindowManager*>(lParam);
         thiz->windowDataList_[1].push_back(data);
@@ -537,6 +562,16 @@ void WindowManager::UpdateWindowHandleList()
         data.zOrder = 0;
         data.hMonitor = hMonitor;
         data.isDesktop = true;
+        data.orientation = DMDO_DEFAULT;
+
+        MONITORINFOEX monitor;
+        monitor.cbSize = sizeof(MONITORINFOEX);
+        DEVMODE mode {};
+        mode.dmSize = sizeof(DEVMODE);
+        if (::GetMonitorInfo(hMonitor, &monitor) && ::EnumDisplaySettings(monitor.szDevice, ENUM_CURRENT_SETTINGS, &mode))
+        {
+            data.orientation = mode.dmDisplayOrientation;
+        }
 
         auto thiz = reinterpret_cast<WindowManager*>(lParam);
         thiz->windowDataList_[1].push_back(data);
@@ -575,6 +610,69 @@ void WindowManager::UpdateWindowHandleList()
 }
 
 
+void WindowManager::CompressIdleWindows()
+{
+    const UINT64 idleTime = compressionIdleTime_;
+    if (idleTime == 0) return;
+
+    const UINT64 now = ::GetTickCount64();
+
+    // Compress at most one window per tick so that the list thread stays responsive.
+    for (const auto& pair : windows_)
+    {
+        const auto& window = pair.second;
+        if (now - window->GetLastRequestedTime() < idleTime) continue;
+        if (window->CompressBuffers() > 0) break;
+    }
+}
+
+
+void WindowManager::EnforceMemoryBudget()
+{
+    if (BufferPool::IsNull()) return;
+
+    auto& pool = BufferPool::Get();
+    if (!pool.IsOverBudget()) return;
+
+    SCOPE_TIMER(EnforceMemoryBudget);
+
+    // Cached blocks go first since nobody is using them.
+    pool.Trim();
+    if (!pool.IsOverBudget()) return;
+
+    std::vector<std::shared_ptr<Window>> windows;
+    windows.reserve(windows_.size());
+    for (const auto& pair : windows_)
+    {
+        windows.push_back(pair.second);
+    }
+
+    std::sort(
+        windows.begin(),
+        windows.end(),
+        [](const auto& a, const auto& b)
+        {
+            return a->GetLastRequestedTime() < b->GetLastRequestedTime();
+        });
+
+    // Never evict windows that have been requested just now.
+    constexpr UINT64 minIdleTime = 1000 /* milliseconds */;
+    const UINT64 now = ::GetTickCount64();
+
+    for (const auto& window : windows)
+    {
+        if (now - window->GetLastRequestedTime() < minIdleTime) break;
+
+        if (window->EvictBuffers() > 0)
+        {
+            ++evictionCount_;
+            pool.Trim();
+            if (!pool.IsOverBudget()) break;
+        }
+    }
+}
+
+
 void WindowManager::RenderWindows()
 {
     for (auto&& pair : windows_)
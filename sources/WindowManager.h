@@ -20,7 +20,7 @@ bool IsFullScreenWindow(HWND hWnd);
 bool IsAltTabWindow(HWND hWnd);
 UINT GetWindowZOrder(HWND hWnd);
 bool GetWindowTitle(HWND hWnd, std::wstring& outTitle);
-bool GetWindowTitle(HWND hWnd, std::wstring& outTitle, int timeout);
+bool GetWindowTitle(HWND hWnd, std::wstring& outTitle, int timeout, Arena& arena);
 bool GetWindowClassName(HWND hWnd, std::string& outClassName);
 bool IsUWP(DWORD pid);
 bool IsApplicationFrameWindow(const std::string& className);
@@ -38,6 +38,9 @@ public:
     std::shared_ptr<Window> GetWindow(int id) const;
     std::shared_ptr<Window> GetWindowFromPoint(POINT point) const;
     std::shared_ptr<Window> GetCursorWindow() const;
+    UINT64 GetEvictionCount() const;
+    void SetCompressionIdleTime(UINT64 milliseconds);
+    UINT64 GetCompressionIdleTime() const;
 
     static const std::unique_ptr<CaptureManager>& GetCaptureManager();
     static const std::unique_ptr<UploadManager>& GetUploadManager();
@@ -53,6 +56,8 @@ private:
     void UpdateWindowHandleList();
     void UpdateWindows();
     void RenderWindows();
+    void CompressIdleWindows();
+    void EnforceMemoryBudget();
 
     std::unique_ptr<CaptureManager> captureManager_;
     std::unique_ptr<UploadManager> uploadManager_;
@@ -61,6 +66,8 @@ private:
     std::map<int, std::shared_ptr<Window>> windows_;
     int lastWindowId_ = 0;
     std::weak_ptr<Window> cursorWindow_;
+    std::atomic<UINT64> evictionCount_ = 0;
+    std::atomic<UINT64> compressionIdleTime_ = 10000;
 
     ThreadLoop windowHandleListThreadLoop_;
 
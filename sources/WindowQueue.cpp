@@ -11,7 +11,7 @@ void WindowQueue::Enqueue(int id)
     const auto it = std::find(queue_.begin(), queue_.end(), id);
     if (it == queue_.end())
     {
-        queue_.push_front(id);
+        queue_.insert(queue_.begin(), id);
     }
 }
 
@@ -1,6 +1,6 @@
 #pragma once
 
-#include <deque>
+#include <vector>
 #include <mutex>
 
 
@@ -13,5 +13,6 @@ public:
 
 private:
     std::mutex mutex_;
-    std::deque<int> queue_;
+    // A vector keeps its capacity, so a steady stream of requests does not allocate.
+    std::vector<int> queue_;
 };
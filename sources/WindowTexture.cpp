@@ -1,6 +1,7 @@
 #include "pch.h"
 #include <dwmapi.h>
 #include "WindowTexture.h"
+#include "ImagePipeline.h"
 #include "Window.h"
 #include "WindowManager.h"
 #include "UploadManager.h"
@@ -10,17 +11,32 @@
 
 using namespace Microsoft::WRL;
 
+namespace
+{
+    // Dragging a window edge grows the frame a little on every capture, so grow geometrically
+    // and give the memory back once the window has stayed much smaller for a while.
+    BufferGrowthPolicy CreateDefaultGrowthPolicy()
+    {
+        BufferGrowthPolicy policy;
+        policy.growthFactor = 1.25f;
+        policy.lowWaterRatio = 0.5f;
+        policy.shrinkAfterCalls = 60;
+        policy.preserveContents = false;
+        return policy;
+    }
+}
 
 
 WindowTexture::WindowTexture(Window* window)
     : window_(window)
+    , growthPolicy_(CreateDefaultGrowthPolicy())
 {
 }
 
 
 WindowTexture::~WindowTexture()
 {
-    std::lock_guard<std::mutex> lock(bufferMutex_);
+    ReleaseFrameSnapshot(&bufferSnapshot_);
     DeleteBitmap();
 }
 
@@ -28,6 +44,9 @@ WindowTexture::~WindowTexture()
 void WindowTexture::SetUnityTexturePtr(ID3D11Texture2D* ptr)
 {
     unityTexture_ = ptr;
+
+    // A new texture has none of the frames, so the next one has to be uploaded even if it is unchanged.
+    forcePublish_ = true;
 }
 
 
@@ -61,15 +80,161 @@ bool WindowTexture::GetCursorDraw() const
 }
 
 
+void WindowTexture::SetRotation(FrameRotation rotation)
+{
+    if (rotation_ == rotation) return;
+
+    rotation_ = rotation;
+
+    // The engine has to recreate the texture if the width and the height are swapped.
+    MessageManager::Get().Add({ MessageType::WindowSizeChanged, window_->GetId(), window_->GetHandle() });
+}
+
+
+FrameRotation WindowTexture::GetRotation() const
+{
+    return rotation_;
+}
+
+
+void WindowTexture::SetMirror(bool mirror)
+{
+    mirror_ = mirror;
+}
+
+
+bool WindowTexture::GetMirror() const
+{
+    return mirror_;
+}
+
+
+FrameRotation WindowTexture::GetAppliedRotation() const
+{
+    const FrameRotation rotation = rotation_;
+    if (rotation != FrameRotation::Auto) return rotation;
+    if (!window_->IsDesktop()) return FrameRotation::None;
+
+    // The desktop of a rotated monitor is captured as laid out in the frame buffer,
+    // so turn it back the other way.
+    switch (window_->GetMonitorOrientation())
+    {
+        case DMDO_90: return FrameRotation::Clockwise270;
+        case DMDO_180: return FrameRotation::Clockwise180;
+        case DMDO_270: return FrameRotation::Clockwise90;
+        default: return FrameRotation::None;
+    }
+}
+
+
+void WindowTexture::SetBufferGrowthPolicy(const BufferGrowthPolicy& policy)
+{
+    std::lock_guard<std::mutex> lock(bufferStatsMutex_);
+    growthPolicy_ = policy;
+}
+
+
+BufferGrowthPolicy WindowTexture::GetBufferGrowthPolicy() const
+{
+    std::lock_guard<std::mutex> lock(bufferStatsMutex_);
+    return growthPolicy_;
+}
+
+
+BufferStats WindowTexture::GetBufferStats() const
+{
+    std::lock_guard<std::mutex> lock(bufferStatsMutex_);
+    return bufferStats_;
+}
+
+
+void WindowTexture::SetOutputSize(UINT width, UINT height)
+{
+    if (outputWidth_ == width && outputHeight_ == height) return;
+
+    outputWidth_ = width;
+    outputHeight_ = height;
+
+    // The engine has to recreate the texture with the new size.
+    MessageManager::Get().Add({ MessageType::WindowSizeChanged, window_->GetId(), window_->GetHandle() });
+}
+
+
+void WindowTexture::SetOutputFilter(ResampleFilter filter)
+{
+    outputFilter_ = filter;
+    forcePublish_ = true;
+}
+
+
+ResampleFilter WindowTexture::GetOutputFilter() const
+{
+    return outputFilter_;
+}
+
+
+void WindowTexture::SetMipGeneration(bool enabled)
+{
+    generateMips_ = enabled;
+
+    // Mips are generated only for published frames.
+    forcePublish_ = true;
+}
+
+
+bool WindowTexture::GetMipGeneration() const
+{
+    return generateMips_;
+}
+
+
+UINT64 WindowTexture::GetMipGenerationTime() const
+{
+    return mipGenerationTime_;
+}
+
+
+void WindowTexture::GetOutputSize(UINT* width, UINT* height) const
+{
+    const UINT textureWidth = textureWidth_;
+    const UINT textureHeight = textureHeight_;
+    UINT outputWidth = outputWidth_;
+    UINT outputHeight = outputHeight_;
+
+    if (textureWidth == 0 || textureHeight == 0 || (outputWidth == 0 && outputHeight == 0))
+    {
+        *width = textureWidth;
+        *height = textureHeight;
+        return;
+    }
+
+    if (outputWidth == 0)
+    {
+        outputWidth = max(static_cast<UINT>(static_cast<UINT64>(textureWidth) * outputHeight / textureHeight), 1u);
+    }
+    if (outputHeight == 0)
+    {
+        outputHeight = max(static_cast<UINT>(static_cast<UINT64>(textureHeight) * outputWidth / textureWidth), 1u);
+    }
+
+    *width = outputWidth;
+    *height = outputHeight;
+}
+
+
 UINT WindowTexture::GetWidth() const
 {
-    return textureWidth_;
+    UINT width, height;
+    GetOutputSize(&width, &height);
+    return width;
 }
 
 
 UINT WindowTexture::GetHeight() const
 {
-    return textureHeight_;
+    UINT width, height;
+    GetOutputSize(&width, &height);
+    return height;
 }
 
 
@@ -87,14 +252,11 @@ UINT WindowTexture::GetOffsetY() const
 
 void WindowTexture::CreateBitmapIfNeeded(HDC hDc, UINT width, UINT height)
 {
-    std::lock_guard<std::mutex> lock(bufferMutex_);
-
     if (bufferWidth_ == width && bufferHeight_ == height) return;
     if (width == 0 || height == 0) return;
 
     bufferWidth_ = width;
     bufferHeight_ = height;
-    buffer_.ExpandIfNeeded(width * height * 4);
 
     DeleteBitmap();
     bitmap_ = ::CreateCompatibleBitmap(hDc, width, height);
@@ -113,12 +275,12 @@ void WindowTexture::DeleteBitmap()
 }
 
 
-bool WindowTexture::Capture()
+CaptureResult WindowTexture::Capture()
 {
     auto hWnd = window_->GetHandle();
 
     auto hDc = ::GetDC(hWnd);
-    ScopedReleaser hDcReleaser([&] { ::ReleaseDC(hWnd, hDc); });
+    const auto hDcReleaser = MakeScopedReleaser([&] { ::ReleaseDC(hWnd, hDc); });
 
     BITMAP bmpHeader;
     ZeroMemory(&bmpHeader, sizeof(BITMAP));
@@ -136,7 +298,7 @@ bool WindowTexture::Capture()
 
     if (dcWidth == 0 || dcHeight == 0)
     {
-        return false;
+        return CaptureResult::Failed;
     }
 
     // DPI scale
@@ -154,6 +316,10 @@ bool WindowTexture::Capture()
 
     CreateBitmapIfNeeded(hDc, dcWidth, dcHeight);
 
+    const FrameRotation rotation = GetAppliedRotation();
+    const bool mirror = mirror_;
+    const bool isRotated = rotation != FrameRotation::None || mirror;
+
     {
         SCOPE_TIMER(DwmGetWindowAttribute)
 
@@ -217,6 +383,18 @@ bool WindowTexture::Capture()
             textureHeight_ = bufferHeight_.load();
         }
 
+        if (isRotated)
+        {
+            UINT x = offsetX_, y = offsetY_, width = textureWidth_, height = textureHeight_;
+            if (ImageRotation::RotateRegion(rotation, mirror, bufferWidth_, bufferHeight_, &x, &y, &width, &height))
+            {
+                offsetX_ = x;
+                offsetY_ = y;
+                textureWidth_ = width;
+                textureHeight_ = height;
+            }
+        }
+
         if (textureWidth_ != preTextureWidth || textureHeight_ != preTextureHeight)
         {
             MessageManager::Get().Add({ MessageType::WindowSizeChanged, window_->GetId(), window_->GetHandle() });
@@ -224,10 +402,10 @@ bool WindowTexture::Capture()
     }
 
     auto hDcMem = ::CreateCompatibleDC(hDc);
-    ScopedReleaser hDcMemRelaser([&] { ::DeleteDC(hDcMem); });
+    const auto hDcMemRelaser = MakeScopedReleaser([&] { ::DeleteDC(hDcMem); });
 
     HGDIOBJ preObject = ::SelectObject(hDcMem, bitmap_);
-    ScopedReleaser selectObject([&] { ::SelectObject(hDcMem, preObject); });
+    const auto selectObject = MakeScopedReleaser([&] { ::SelectObject(hDcMem, preObject); });
 
     int offsetLeft = 0, offsetRight = 0, offsetTop = 0, offsetBottom = 0;
 
@@ -239,7 +417,7 @@ bool WindowTexture::Capture()
             if (!::PrintWindow(hWnd, hDcMem, PW_RENDERFULLCONTENT)) 
             {
                 OutputApiError(__FUNCTION__, "PrintWindow");
-                return false;
+                return CaptureResult::Failed;
             }
             break;
         }
@@ -252,13 +430,13 @@ bool WindowTexture::Capture()
             if (!::BitBlt(hDcMem, 0, 0, bufferWidth_, bufferHeight_, hDc, x, y, SRCCOPY | CAPTUREBLT))
             {
                 OutputApiError(__FUNCTION__, "BitBlt");
-                return false;
+                return CaptureResult::Failed;
             }
             break;
         }
         default:
         {
-            return false;
+            return CaptureResult::Failed;
         }
     }
 
@@ -277,17 +455,100 @@ bool WindowTexture::Capture()
     bmi.biCompression = BI_RGB;
     bmi.biSizeImage   = 0;
 
+    // If all the other slots are being read, drop this frame rather than waiting for readers.
+    auto frame = frames_->BeginWrite();
+    if (!frame)
     {
-        std::lock_guard<std::mutex> lock(bufferMutex_);
+        return CaptureResult::Failed;
+    }
 
-        if (!::GetDIBits(hDcMem, bitmap_, 0, bufferHeight_, buffer_.Get(), reinterpret_cast<BITMAPINFO*>(&bmi), DIB_RGB_COLORS))
+    UINT frameWidth = bufferWidth_, frameHeight = bufferHeight_;
+    if (isRotated)
+    {
+        ImageRotation::GetRotatedSize(rotation, bufferWidth_, bufferHeight_, &frameWidth, &frameHeight);
+    }
+
+    frame->width = frameWidth;
+    frame->height = frameHeight;
+    frame->alphaMode = AlphaMode::Ignore; // GDI leaves the alpha of most windows undefined.
+    frame->buffer.SetGrowthPolicy(GetBufferGrowthPolicy());
+    frame->buffer.ExpandIfNeeded(frame->width * frame->height * 4);
+
+    {
+        std::lock_guard<std::mutex> lock(bufferStatsMutex_);
+        bufferStats_ = frames_->GetStats();
+    }
+
+    // A rotated frame is read into a scratch image first since GetDIBits can only flip rows.
+    if (isRotated)
+    {
+        rotationImage_.Create(bufferWidth_, bufferHeight_);
+    }
+    BYTE* bits = isRotated ? rotationImage_.GetData() : frame->buffer.Get();
+
+    if (!::GetDIBits(hDcMem, bitmap_, 0, bufferHeight_, bits, reinterpret_cast<BITMAPINFO*>(&bmi), DIB_RGB_COLORS))
+    {
+        OutputApiError(__FUNCTION__, "GetDIBits");
+        frames_->EndWrite(false);
+        return CaptureResult::Failed;
+    }
+
+    const UINT threadCount = std::max<UINT>(std::thread::hardware_concurrency(), 1);
+
+    if (isRotated)
+    {
+        SCOPE_TIMER(Rotate)
+
+        const ImageView<PixelFormatBGRA8> dst(frame->buffer.Get(), frame->width, frame->height);
+        if (!ImageRotation::Rotate(rotationImage_.GetView(), dst, rotation, mirror, threadCount))
         {
-            OutputApiError(__FUNCTION__, "GetDIBits");
-            return false;
+            DebugLog::Error(__FUNCTION__, " => Failed to rotate the frame.");
+            frames_->EndWrite(false);
+            return CaptureResult::Failed;
         }
     }
 
-    return true;
+    // The region goes with the frame, so that its readers never mix it with a later capture's.
+    frame->regionX = offsetX_;
+    frame->regionY = offsetY_;
+    frame->regionWidth = textureWidth_;
+    frame->regionHeight = textureHeight_;
+
+    bool isHashed = false;
+    {
+        SCOPE_TIMER(HashTiles)
+        const bool detectScroll = scrollDetection_;
+        if (!detectScroll) frame->motion.Clear();
+        isHashed = tileHasher_.Update(frame->GetView(), frame->regionX, frame->regionY, frame->regionWidth, frame->regionHeight, threadCount, &frame->dirtyTiles, detectScroll ? &frame->motion : nullptr);
+    }
+
+    // Drop a frame identical to the published one, so that Upload(), Render() and the
+    // WindowCaptured message are skipped and readers keep the same sequence.
+    const UINT64 frameHash = tileHasher_.GetFrameHash();
+    const bool forcePublish = forcePublish_.exchange(false);
+    if (isHashed && hasPublishedHash_ && frameHash == publishedHash_ && !forcePublish && frames_->HasFrame())
+    {
+        ++suppressedFrameCount_;
+        frames_->EndWrite(false);
+        return CaptureResult::Suppressed;
+    }
+    publishedHash_ = frameHash;
+    hasPublishedHash_ = isHashed;
+    frame->isForced = forcePublish;
+
+    if (generateMips_)
+    {
+        const auto timer = MakeScopedTimer([&](std::chrono::microseconds time) { mipGenerationTime_ = time.count(); });
+        frame->mips.Generate(frame->GetView(), frame->regionX, frame->regionY, frame->regionWidth, frame->regionHeight);
+    }
+    else
+    {
+        frame->mips.Reset();
+    }
+
+    frames_->EndWrite(true);
+
+    return CaptureResult::Captured;
 }
 
 
@@ -381,12 +642,63 @@ bool WindowTexture::Upload()
         }
     }
 
-    if (offsetX_ + textureWidth_ > bufferWidth_ || offsetY_ + textureHeight_ > bufferHeight_)
+    const int frameIndex = frames_->AcquireRead();
+    if (frameIndex < 0) return false;
+    const auto frameReleaser = MakeScopedReleaser([&] { frames_->ReleaseRead(frameIndex); });
+    const auto& frame = frames_->GetFrame(frameIndex);
+
+    if (frame.buffer.Empty()) return false;
+
+    auto image = frame.GetRegionView();
+    if (image.Empty())
     {
         DebugLog::Error(__FUNCTION__, " => Offsets are invalid.");
         return false;
     }
 
+    // The dirty tiles tell what to upload only if the texture has the previous frame of the same region.
+    const DirtyTiles* dirtyTiles = nullptr;
+    {
+        const RECT region = frame.dirtyTiles.GetRegion();
+        const bool isContinuous =
+            !shouldUpdateTexture &&
+            !frame.isForced &&
+            frame.sequence == uploadedSequence_ + 1 &&
+            !frame.dirtyTiles.Empty() &&
+            region.left == static_cast<LONG>(offsetX_) && region.top == static_cast<LONG>(offsetY_) &&
+            region.right - region.left == static_cast<LONG>(image.GetWidth()) &&
+            region.bottom - region.top == static_cast<LONG>(image.GetHeight());
+        if (isContinuous) dirtyTiles = &frame.dirtyTiles;
+    }
+
+    // A resampled frame is uploaded whole, since its pixels also depend on the output filter.
+    UINT outputWidth, outputHeight;
+    GetOutputSize(&outputWidth, &outputHeight);
+    const bool isResampled = outputWidth != image.GetWidth() || outputHeight != image.GetHeight();
+
+    if (dirtyTiles && dirtyTiles->GetDirtyCount() == 0 && !isResampled)
+    {
+        partialUploader_.Skip(image);
+        uploadedSequence_ = frame.sequence;
+        return true;
+    }
+
+    if (isResampled)
+    {
+        SCOPE_TIMER(Resample)
+
+        outputImage_.Create(outputWidth, outputHeight);
+        const bool result = ImagePipeline<PixelFormatBGRA8, PixelFormatBGRA8>()
+            .Resample(outputFilter_, &outputResampler_)
+            .Run(image, outputImage_.GetView());
+        if (!result) return false;
+
+        image = outputImage_.GetView();
+
+        // Tiles of the captured size do not map onto resampled pixels.
+        dirtyTiles = nullptr;
+    }
+
     auto& uploader = WindowManager::GetUploadManager();
     if (!uploader) return false;
 
@@ -410,18 +722,14 @@ bool WindowTexture::Upload()
     }
 
     {
-        std::lock_guard<std::mutex> lock(bufferMutex_);
-
-        const UINT rawPitch = bufferWidth_ * 4;
-        const int startIndex = offsetX_ * 4 + offsetY_ * rawPitch;
-        const auto* start = buffer_.Get(startIndex);
-
         ComPtr<ID3D11DeviceContext> context;
         uploader->GetDevice()->GetImmediateContext(&context);
-        context->UpdateSubresource(sharedTexture_.Get(), 0, nullptr, start, rawPitch, 0);
-        context->Flush();
+        D3D11UploadTarget target(context.Get(), sharedTexture_.Get(), &moveTexture_);
+        if (!partialUploader_.Upload(&target, image, dirtyTiles, dirtyTiles ? &frame.motion : nullptr)) return false;
     }
 
+    uploadedSequence_ = frame.sequence;
+
     return true;
 }
 
@@ -466,14 +774,133 @@ bool WindowTexture::Render()
 
 BYTE* WindowTexture::GetBuffer()
 {
-    if (buffer_.Empty()) return nullptr;
+    // Keep the latest frame pinned instead of copying it.
+    // The returned pointer stays valid until the next GetBuffer() call.
+    FrameSnapshot snapshot;
+    if (!AcquireSnapshot(&snapshot)) return nullptr;
+
+    std::lock_guard<std::mutex> lock(bufferSnapshotMutex_);
+
+    ReleaseFrameSnapshot(&bufferSnapshot_);
+    bufferSnapshot_ = snapshot;
+
+    return const_cast<BYTE*>(bufferSnapshot_.pixels);
+}
+
+
+bool WindowTexture::AcquireSnapshot(FrameSnapshot* snapshot) const
+{
+    return AcquireFrameSnapshot(frames_, snapshot);
+}
+
 
-    std::lock_guard<std::mutex> lock(bufferMutex_);
+bool WindowTexture::AcquireMipSnapshot(UINT level, FrameSnapshot* snapshot) const
+{
+    return ::AcquireMipSnapshot(frames_, level, snapshot);
+}
 
-    bufferForGetBuffer_.ExpandIfNeeded(buffer_.Size());
-    memcpy(bufferForGetBuffer_.Get(), buffer_.Get(), buffer_.Size());
 
-    return bufferForGetBuffer_.Get();
+UINT WindowTexture::GetMipLevelCount() const
+{
+    const int frameIndex = frames_->AcquireRead();
+    if (frameIndex < 0) return 0;
+    const auto frameReleaser = MakeScopedReleaser([&] { frames_->ReleaseRead(frameIndex); });
+
+    return frames_->GetFrame(frameIndex).mips.GetLevelCount();
+}
+
+
+void WindowTexture::SetPartialUploadRatio(float ratio)
+{
+    partialUploader_.SetMaxDirtyRatio(ratio);
+}
+
+
+float WindowTexture::GetPartialUploadRatio() const
+{
+    return partialUploader_.GetMaxDirtyRatio();
+}
+
+
+UploadStats WindowTexture::GetUploadStats() const
+{
+    return partialUploader_.GetStats();
+}
+
+
+void WindowTexture::SetScrollDetection(bool enabled)
+{
+    scrollDetection_ = enabled;
+}
+
+
+bool WindowTexture::GetScrollDetection() const
+{
+    return scrollDetection_;
+}
+
+
+UINT64 WindowTexture::GetSuppressedFrameCount() const
+{
+    return suppressedFrameCount_;
+}
+
+
+bool WindowTexture::IsPublishPending() const
+{
+    return forcePublish_;
+}
+
+
+int WindowTexture::GetDirtyTileCount() const
+{
+    const int frameIndex = frames_->AcquireRead();
+    if (frameIndex < 0) return -1;
+    const auto frameReleaser = MakeScopedReleaser([&] { frames_->ReleaseRead(frameIndex); });
+
+    const auto& dirtyTiles = frames_->GetFrame(frameIndex).dirtyTiles;
+    if (dirtyTiles.Empty()) return -1;
+
+    return static_cast<int>(dirtyTiles.GetDirtyCount());
+}
+
+
+size_t WindowTexture::EvictBuffers()
+{
+    // Pinned slots (including the one kept by GetBuffer()) are skipped.
+    size_t freed = frames_->Evict();
+
+    for (auto& converted : convertedFrames_)
+    {
+        std::lock_guard<std::mutex> lock(converted.mutex);
+        freed += converted.buffer.Capacity() + converted.scratch.Capacity();
+        converted.buffer.Reset();
+        converted.scratch.Reset();
+        converted.sequence = 0;
+    }
+
+    return freed;
+}
+
+
+size_t WindowTexture::CompressBuffers()
+{
+    // Try each frame only once so that a frame which does not compress is not encoded on every tick.
+    const UINT64 sequence = frames_->GetSequence();
+    if (sequence == compressedSequence_) return 0;
+    compressedSequence_ = sequence;
+
+    SCOPE_TIMER(CompressBuffers)
+
+    // The frame pinned by GetBuffer() stays uncompressed.
+    Buffer<BYTE> scratch;
+    const size_t saved = frames_->Compress(&scratch);
+    if (saved > 0)
+    {
+        DebugLog::Log(__FUNCTION__, " => ", saved, " bytes saved (id=", window_->GetId(), ").");
+    }
+
+    return saved;
 }
 
 
@@ -490,39 +917,97 @@ UINT WindowTexture::GetPixel(int x, int y) const
 
 bool WindowTexture::GetPixels(BYTE* output, int x, int y, int width, int height) const
 {
-    if (!buffer_)
+    SCOPE_TIMER(GetPixels)
+
+    const int frameIndex = frames_->AcquireRead();
+    const auto frameReleaser = MakeScopedReleaser([&] { frames_->ReleaseRead(frameIndex); });
+    if (frameIndex < 0 || !frames_->GetFrame(frameIndex).buffer)
     {
         DebugLog::Error("WindowTexture::GetPixels() => buffer has not been set yet.");
         return false;
     }
+    const auto& frame = frames_->GetFrame(frameIndex);
 
-    int bufferWidth = bufferWidth_.load();
-    int bufferHeight = bufferHeight_.load();
+    const int bufferWidth = frame.width;
+    const int bufferHeight = frame.height;
     if (x < 0 || x + width >= bufferWidth || y < 0 || y + height >= bufferHeight)
     {
         DebugLog::Error("The given range is out of the buffer area: x=", x, ", y=", y, ", width=", width, ", height=", height);
-        DebugLog::Error("The buffer width=", bufferWidth_, ", height=", bufferHeight_);
+        DebugLog::Error("The buffer width=", bufferWidth, ", height=", bufferHeight);
+        return false;
+    }
+
+    // The frame is stored top-down in BGRA, while the output is bottom-up in RGBA.
+    return ImagePipeline<PixelFormatBGRA8, PixelFormatRGBA8>()
+        .Crop(x, y, width, height)
+        .FlipVertical()
+        .Run(frame.GetView(), ImageView<PixelFormatRGBA8>(output, width, height));
+}
+
+
+bool WindowTexture::GetPixelsAs(OutputFormat format, BYTE* output, UINT outputSize, int x, int y, int width, int height) const
+{
+    SCOPE_TIMER(GetPixelsAs)
+
+    const UINT formatIndex = static_cast<UINT>(format);
+    if (formatIndex >= FormatConverter::kFormatCount)
+    {
+        DebugLog::Error(__FUNCTION__, " => Unknown format: ", static_cast<int>(format));
+        return false;
+    }
+
+    const int frameIndex = frames_->AcquireRead();
+    const auto frameReleaser = MakeScopedReleaser([&] { frames_->ReleaseRead(frameIndex); });
+    if (frameIndex < 0 || !frames_->GetFrame(frameIndex).buffer)
+    {
+        DebugLog::Error(__FUNCTION__, " => buffer has not been set yet.");
+        return false;
+    }
+    const auto& frame = frames_->GetFrame(frameIndex);
+
+    const int bufferWidth = frame.width;
+    const int bufferHeight = frame.height;
+    if (x < 0 || y < 0 || width <= 0 || height <= 0 || width > bufferWidth - x || height > bufferHeight - y)
+    {
+        DebugLog::Error("The given range is out of the buffer area: x=", x, ", y=", y, ", width=", width, ", height=", height);
+        DebugLog::Error("The buffer width=", bufferWidth, ", height=", bufferHeight);
         return false;
     }
 
-    std::lock_guard<std::mutex> lock(bufferMutex_);
+    const UINT size = FormatConverter::GetSize(format, width, height);
+    if (!output || outputSize < size)
+    {
+        DebugLog::Error(__FUNCTION__, " => The output needs ", size, " bytes but has ", outputSize, ".");
+        return false;
+    }
 
-    constexpr int rgba = 4;
-    for (int j = 0; j < height; ++j)
+    // Holding the lock while converting makes other consumers of the format wait for the result.
+    auto& converted = convertedFrames_[formatIndex];
+    std::lock_guard<std::mutex> lock(converted.mutex);
+
+    // A conversion of the previous frame is still valid if no tile in the region has changed since.
+    const RECT rect = { x, y, x + width, y + height };
+    const bool isCached =
+        converted.buffer &&
+        (converted.sequence == frame.sequence || (converted.sequence + 1 == frame.sequence && !frame.dirtyTiles.Intersects(rect))) &&
+        converted.x == x && converted.y == y &&
+        converted.width == width && converted.height == height;
+    if (!isCached)
     {
-        for (int i = 0; i < width; ++i)
+        converted.buffer.ExpandIfNeeded(size);
+        const auto region = frame.GetView().Crop(x, y, width, height);
+        if (!FormatConverter::Convert(region, format, converted.buffer.Get(), size, std::max<UINT>(std::thread::hardware_concurrency(), 1), &converted.scratch))
         {
-            for (int c = 0; c < rgba; ++c)
-            {
-                const int indexOut = i + j * width;
-                const int indexIn = (x + i) + (y + (height - 1 - j)) * bufferWidth_;
-                output[indexOut * rgba + 0] = buffer_[indexIn * rgba + 2];
-                output[indexOut * rgba + 1] = buffer_[indexIn * rgba + 1];
-                output[indexOut * rgba + 2] = buffer_[indexIn * rgba + 0];
-                output[indexOut * rgba + 3] = buffer_[indexIn * rgba + 3];
-            }
+            converted.sequence = 0;
+            return false;
         }
+        converted.x = x;
+        converted.y = y;
+        converted.width = width;
+        converted.height = height;
     }
+    converted.sequence = frame.sequence;
 
+    memcpy(output, converted.buffer.Get(), size);
     return true;
 }
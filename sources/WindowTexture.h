@@ -7,6 +7,12 @@
 #include <atomic>
 
 #include "Buffer.h"
+#include "FormatConverter.h"
+#include "FrameRing.h"
+#include "Image.h"
+#include "ImageRotation.h"
+#include "PartialUpload.h"
+#include "Resampler.h"
 
 
 enum class CaptureMode
@@ -16,6 +22,15 @@ enum class CaptureMode
     BitBlt = 1,
 };
 
+enum class CaptureResult
+{
+    // A new frame was published.
+    Captured = 0,
+    // The frame was identical to the published one and was dropped.
+    Suppressed = 1,
+    Failed = 2,
+};
+
 class Window;
 
 class WindowTexture
@@ -33,35 +48,103 @@ public:
     void SetCursorDraw(bool draw);
     bool GetCursorDraw() const;
 
+    // Rotates and then mirrors each captured frame, e.g. to upright a desktop of a portrait monitor.
+    // The offsets and the size of the texture refer to the rotated frame.
+    void SetRotation(FrameRotation rotation);
+    FrameRotation GetRotation() const;
+    void SetMirror(bool mirror);
+    bool GetMirror() const;
+
+    void SetBufferGrowthPolicy(const BufferGrowthPolicy& policy);
+    BufferGrowthPolicy GetBufferGrowthPolicy() const;
+    BufferStats GetBufferStats() const;
+
+    // The frame is resampled to this size on upload, e.g. for thumbnails.
+    // 0 keeps the captured size, or keeps the aspect ratio if only the other one is set.
+    void SetOutputSize(UINT width, UINT height);
+    void SetOutputFilter(ResampleFilter filter);
+    ResampleFilter GetOutputFilter() const;
+
+    // Generates a mip chain of the captured region on the capture thread after each capture.
+    void SetMipGeneration(bool enabled);
+    bool GetMipGeneration() const;
+    UINT64 GetMipGenerationTime() const;
+
     UINT GetWidth() const;
     UINT GetHeight() const;
     UINT GetOffsetX() const;
     UINT GetOffsetY() const;
 
-    bool Capture();
+    CaptureResult Capture();
     bool Upload();
     bool Render();
 
     BYTE* GetBuffer();
+    bool AcquireSnapshot(FrameSnapshot* snapshot) const;
+    bool AcquireMipSnapshot(UINT level, FrameSnapshot* snapshot) const;
+    UINT GetMipLevelCount() const;
+
+    // Number of 64x64 tiles of the captured region that changed in the latest frame,
+    // or -1 if it is not known and the whole frame has to be taken as changed.
+    int GetDirtyTileCount() const;
+
+    // Captures identical to the published frame are dropped instead of being published.
+    UINT64 GetSuppressedFrameCount() const;
+    // Whether the next capture is published even if nothing changed.
+    bool IsPublishPending() const;
+
+    // Uploads only the changed tiles unless more than this fraction of the frame changed.
+    void SetPartialUploadRatio(float ratio);
+    float GetPartialUploadRatio() const;
+
+    // Looks for scrolls between frames, so that uploads move the pixels in the texture and
+    // readers can do the same. Costs an extra hash of every column, so it is off by default.
+    void SetScrollDetection(bool enabled);
+    bool GetScrollDetection() const;
+
+    UploadStats GetUploadStats() const;
+    size_t EvictBuffers();
+    size_t CompressBuffers();
 
     UINT GetPixel(int x, int y) const;
     bool GetPixels(BYTE* output, int x, int y, int width, int height) const;
 
+    // Converts the region of the latest frame to the format. The result is kept until the next
+    // frame, so consumers asking for the same format and region share one conversion.
+    bool GetPixelsAs(OutputFormat format, BYTE* output, UINT outputSize, int x, int y, int width, int height) const;
+
 private:
+    struct ConvertedFrame
+    {
+        std::mutex mutex;
+        UINT64 sequence = 0;
+        int x = 0;
+        int y = 0;
+        int width = 0;
+        int height = 0;
+        Buffer<BYTE> buffer;
+        Buffer<BYTE> scratch;
+    };
+
     void CreateBitmapIfNeeded(HDC hDc, UINT width, UINT height);
     void DeleteBitmap();
     void DrawCursor(HWND hWnd, HDC hDcMem);
+    void GetOutputSize(UINT* width, UINT* height) const;
+    FrameRotation GetAppliedRotation() const;
 
     const Window* const window_;
     CaptureMode captureMode_ = CaptureMode::PrintWindow;
 
     std::atomic<ID3D11Texture2D*> unityTexture_ = nullptr;
     Microsoft::WRL::ComPtr<ID3D11Texture2D> sharedTexture_;
+    Microsoft::WRL::ComPtr<ID3D11Texture2D> moveTexture_;
     HANDLE sharedHandle_;
     std::mutex sharedTextureMutex_;
 
-    Buffer<BYTE> buffer_;
-    Buffer<BYTE> bufferForGetBuffer_;
+    std::shared_ptr<FrameRing> frames_ = std::make_shared<FrameRing>();
+    FrameSnapshot bufferSnapshot_;
+    UINT64 compressedSequence_ = 0;
+    std::mutex bufferSnapshotMutex_;
     HBITMAP bitmap_ = nullptr;
     std::atomic<UINT> bufferWidth_ = 0;
     std::atomic<UINT> bufferHeight_ = 0;
@@ -70,7 +153,29 @@ private:
     std::atomic<UINT> textureWidth_ = 0;
     std::atomic<UINT> textureHeight_ = 0;
     std::atomic<bool> drawCursor_ = true;
-    mutable std::mutex bufferMutex_;
+    std::atomic<FrameRotation> rotation_ = FrameRotation::None;
+    std::atomic<bool> mirror_ = false;
+    Image<PixelFormatBGRA8> rotationImage_;
+    std::atomic<UINT> outputWidth_ = 0;
+    std::atomic<UINT> outputHeight_ = 0;
+    std::atomic<ResampleFilter> outputFilter_ = ResampleFilter::Bilinear;
+    Image<PixelFormatBGRA8> outputImage_;
+    Resampler outputResampler_;
+    std::atomic<bool> generateMips_ = false;
+    std::atomic<UINT64> mipGenerationTime_ = 0;
+    TileHasher tileHasher_;
+    UINT64 publishedHash_ = 0;
+    bool hasPublishedHash_ = false;
+    std::atomic<bool> forcePublish_ = true;
+    std::atomic<UINT64> suppressedFrameCount_ = 0;
+    std::atomic<bool> scrollDetection_ = false;
+    UINT64 uploadedSequence_ = 0;
+    PartialUploader partialUploader_;
+    mutable ConvertedFrame convertedFrames_[FormatConverter::kFormatCount];
+
+    BufferGrowthPolicy growthPolicy_;
+    BufferStats bufferStats_;
+    mutable std::mutex bufferStatsMutex_;
 
     float dpiScaleX_ = 1.f;
     float dpiScaleY_ = 1.f;
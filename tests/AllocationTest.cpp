@@ -0,0 +1,211 @@
+#include "pch.h"
+#include <cstring>
+#include <vector>
+#include "Test.h"
+#include "../sources/AllocationCounter.h"
+#include "../sources/Arena.h"
+#include "../sources/FormatConverter.h"
+#include "../sources/FrameRing.h"
+#include "../sources/Image.h"
+#include "../sources/ImagePipeline.h"
+#include "../sources/ImageRotation.h"
+#include "../sources/PartialUpload.h"
+
+namespace
+{
+    // The CPU side of WindowTexture::Capture() and Upload() on a simulated window: the "GDI" bits are
+    // rotated into a ring slot, hashed into dirty tiles and a scroll, and reduced to mips; the upload
+    // sends the dirty boxes of the captured region to a memory target, and consumers read a scaled
+    // copy as GetPixels() does and an NV12 copy as GetPixelsAs() does. Each cycle also builds its
+    // temporaries in the window's arena, as the title update does. Bands run on one thread, since
+    // starting a band thread allocates by design.
+    class CaptureCycle
+    {
+    public:
+        static constexpr UINT kWidth = 640;
+        static constexpr UINT kHeight = 360;
+
+        CaptureCycle()
+            : screen_(kWidth, kHeight)
+        {
+            for (UINT y = 0; y < kHeight; ++y)
+            {
+                auto row = screen_.GetView().GetRowPixels(y);
+                for (UINT x = 0; x < kWidth; ++x) row[x] = Next();
+            }
+        }
+
+        bool Run(UINT frameNumber)
+        {
+            Edit(frameNumber);
+            return UpdateTitle(frameNumber) && Capture() && Upload(frameNumber);
+        }
+
+    private:
+        UINT Next()
+        {
+            seed_ = seed_ * 1664525u + 1013904223u;
+            return seed_;
+        }
+
+        // Cycles through a small edit, a scroll of the content area and no change at all.
+        void Edit(UINT frameNumber)
+        {
+            const auto view = screen_.GetView();
+            switch (frameNumber % 3)
+            {
+                case 0:
+                {
+                    const UINT x = Next() % (kWidth - 32);
+                    const UINT y = Next() % (kHeight - 32);
+                    for (UINT i = 0; i < 32; ++i)
+                    {
+                        auto row = view.GetRowPixels(y + i);
+                        for (UINT j = 0; j < 32; ++j) row[x + j] = Next();
+                    }
+                    break;
+                }
+                case 1:
+                {
+                    constexpr UINT kLeft = 40, kTop = 60, kRight = 600, kBottom = 340, kStep = 12;
+                    for (UINT y = kTop; y < kBottom - kStep; ++y)
+                    {
+                        memcpy(view.GetRowPixels(y) + kLeft, view.GetRowPixels(y + kStep) + kLeft, (kRight - kLeft) * 4);
+                    }
+                    for (UINT y = kBottom - kStep; y < kBottom; ++y)
+                    {
+                        auto row = view.GetRowPixels(y);
+                        for (UINT x = kLeft; x < kRight; ++x) row[x] = Next();
+                    }
+                    break;
+                }
+                default:
+                {
+                    break;
+                }
+            }
+        }
+
+        bool UpdateTitle(UINT frameNumber)
+        {
+            arena_.Reset();
+
+            const ArenaAllocator<WCHAR> allocator(&arena_);
+            std::vector<WCHAR, ArenaAllocator<WCHAR>> title(allocator);
+            title.resize(64 + frameNumber % 200, L'a');
+            return title.size() > 0;
+        }
+
+        bool Capture()
+        {
+            auto frame = ring_.BeginWrite();
+            if (!frame) return false;
+
+            UINT width, height;
+            ImageRotation::GetRotatedSize(FrameRotation::Clockwise90, kWidth, kHeight, &width, &height);
+            frame->width = width;
+            frame->height = height;
+            frame->buffer.ExpandIfNeeded(width * height * 4);
+
+            bits_.Create(kWidth, kHeight);
+            memcpy(bits_.GetData(), screen_.GetData(), kWidth * kHeight * 4);
+
+            const ImageView<PixelFormatBGRA8> dst(frame->buffer.Get(), width, height);
+            if (!ImageRotation::Rotate(bits_.GetView(), dst, FrameRotation::Clockwise90, false, 1))
+            {
+                ring_.EndWrite(false);
+                return false;
+            }
+
+            // The margins are the same on every side, so the region needs no mapping.
+            frame->regionX = kMargin;
+            frame->regionY = kMargin;
+            frame->regionWidth = width - kMargin * 2;
+            frame->regionHeight = height - kMargin * 2;
+            hasher_.Update(frame->GetView(), frame->regionX, frame->regionY, frame->regionWidth, frame->regionHeight, 1, &frame->dirtyTiles, &frame->motion);
+            frame->mips.Generate(frame->GetView(), frame->regionX, frame->regionY, frame->regionWidth, frame->regionHeight);
+            ring_.EndWrite(true);
+            return true;
+        }
+
+        bool Upload(UINT frameNumber)
+        {
+            const int index = ring_.AcquireRead();
+            if (index < 0) return false;
+            const auto releaser = MakeScopedReleaser([&] { ring_.ReleaseRead(index); });
+
+            const auto& frame = ring_.GetFrame(index);
+            const auto image = frame.GetRegionView();
+            if (image.Empty()) return false;
+
+            // Only the dirty boxes once the target holds the previous frame, as Upload() does.
+            const bool isContinuous = frame.sequence == uploadedSequence_ + 1 && !frame.dirtyTiles.Empty();
+            const DirtyTiles* dirtyTiles = isContinuous ? &frame.dirtyTiles : nullptr;
+            if (dirtyTiles && dirtyTiles->GetDirtyCount() == 0)
+            {
+                uploader_.Skip(image);
+            }
+            else if (!uploader_.Upload(&target_, image, dirtyTiles, dirtyTiles ? &frame.motion : nullptr))
+            {
+                return false;
+            }
+            uploadedSequence_ = frame.sequence;
+
+            // Every filter, each with the resampler that keeps its weights.
+            const auto filter = static_cast<ResampleFilter>(frameNumber % kFilterCount);
+            pixels_.Create(kWidth / 3, kHeight / 2 + 1);
+            const bool isResampled = ImagePipeline<PixelFormatBGRA8, PixelFormatRGBA8>()
+                .Crop(frame.regionX, frame.regionY, frame.regionWidth, frame.regionHeight)
+                .FlipVertical()
+                .Resample(filter, &resamplers_[static_cast<int>(filter)])
+                .SetMaxThreadCount(1)
+                .Run(frame.GetView(), pixels_.GetView());
+            if (!isResampled) return false;
+
+            // An odd width takes the path that averages the last column with itself.
+            const auto region = image.Crop(1, 1, image.GetWidth() - 1, image.GetHeight() - 1);
+            const UINT size = FormatConverter::GetSize(OutputFormat::NV12, region.GetWidth(), region.GetHeight());
+            converted_.ExpandIfNeeded(size);
+            return FormatConverter::Convert(region, OutputFormat::NV12, converted_.Get(), size, 1, &convertScratch_);
+        }
+
+        static constexpr UINT kMargin = 8;
+        static constexpr UINT kFilterCount = 4;
+
+        Image<PixelFormatBGRA8> screen_;
+        Image<PixelFormatBGRA8> bits_;
+        Image<PixelFormatRGBA8> pixels_;
+        FrameRing ring_;
+        TileHasher hasher_;
+        PartialUploader uploader_;
+        MemoryUploadTarget target_;
+        Resampler resamplers_[kFilterCount];
+        Arena arena_;
+        Buffer<BYTE> converted_;
+        Buffer<BYTE> convertScratch_;
+        UINT64 uploadedSequence_ = 0;
+        UINT seed_ = 12345;
+    };
+}
+
+
+TEST(Allocation_SteadyStateCaptureAndUploadDoNotAllocate)
+{
+    CHECK(AllocationCounter::IsEnabled());
+
+    CaptureCycle cycle;
+
+    // The first frames size every buffer, resampler and the arena.
+    UINT frameNumber = 0;
+    for (; frameNumber < 12; ++frameNumber)
+    {
+        CHECK(cycle.Run(frameNumber));
+    }
+
+    const UINT64 start = AllocationCounter::GetThreadCount();
+    for (; frameNumber < 60; ++frameNumber)
+    {
+        CHECK(cycle.Run(frameNumber));
+    }
+    CHECK(AllocationCounter::GetThreadCount() == start);
+}
@@ -0,0 +1,108 @@
+#include "pch.h"
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include "Test.h"
+#include "../sources/FrameCodec.h"
+
+namespace
+{
+    constexpr UINT kWidth = 1920;
+    constexpr UINT kHeight = 1080;
+    constexpr int kRunCount = 10;
+
+    UINT Next(UINT* seed)
+    {
+        *seed = *seed * 1664525u + 1013904223u;
+        return *seed;
+    }
+
+    // Flat panels, a title bar and a few buttons, as most application windows are.
+    void FillUserInterface(UINT* pixels)
+    {
+        for (UINT y = 0; y < kHeight; ++y)
+        {
+            for (UINT x = 0; x < kWidth; ++x)
+            {
+                UINT color = 0xFFF0F0F0;
+                if (y < 32) color = 0xFF2B579A;
+                else if (x < 240) color = 0xFFE1E1E1;
+                else if (y % 120 >= 80 && y % 120 < 108 && x % 300 >= 260) color = 0xFF0078D7;
+                pixels[y * kWidth + x] = color;
+            }
+        }
+    }
+
+    // Lines of dark glyph strokes on a white page, as in an editor or a browser.
+    void FillText(UINT* pixels)
+    {
+        UINT seed = 7;
+        for (UINT y = 0; y < kHeight; ++y)
+        {
+            const bool isTextLine = y % 20 >= 4 && y % 20 < 16;
+            for (UINT x = 0; x < kWidth; ++x)
+            {
+                const bool isInk = isTextLine && x >= 40 && x < kWidth - 40 && Next(&seed) % 5 == 0;
+                pixels[y * kWidth + x] = isInk ? 0xFF202020 : 0xFFFFFFFF;
+            }
+        }
+    }
+
+    // A photo or a video: every pixel differs from its neighbours.
+    void FillNoise(UINT* pixels)
+    {
+        UINT seed = 11;
+        for (UINT i = 0; i < kWidth * kHeight; ++i)
+        {
+            pixels[i] = Next(&seed) | 0xFF000000;
+        }
+    }
+}
+
+
+// The ratio and the encode and decode times of an idle 1080p frame, for the kinds of content that
+// get compressed at rest.
+BENCHMARK(FrameCodec_RatioAndSpeed)
+{
+    const struct
+    {
+        const char* name;
+        void (*fill)(UINT*);
+    } contents[] = { { "user interface", FillUserInterface }, { "text", FillText }, { "noise", FillNoise } };
+
+    const size_t rawSize = kWidth * kHeight * 4;
+    std::vector<UINT> frame(kWidth * kHeight);
+    std::vector<UINT> decoded(kWidth * kHeight);
+    std::vector<BYTE> encoded(FrameCodec::GetMaxEncodedSize(kWidth, kHeight));
+
+    printf("  %ux%u, best of %d runs\n", kWidth, kHeight, kRunCount);
+    for (const auto& content : contents)
+    {
+        content.fill(frame.data());
+        const auto pixels = reinterpret_cast<const BYTE*>(frame.data());
+
+        size_t size = 0;
+        const double encodeTime = MeasureMilliseconds(kRunCount, [&]
+        {
+            size = FrameCodec::Encode(pixels, kWidth, kHeight, encoded.data(), encoded.size());
+        });
+        CHECK(size > 0);
+
+        bool isDecoded = false;
+        const double decodeTime = MeasureMilliseconds(kRunCount, [&]
+        {
+            isDecoded = FrameCodec::Decode(encoded.data(), size, kWidth, kHeight, reinterpret_cast<BYTE*>(decoded.data()));
+        });
+        CHECK(isDecoded);
+        CHECK(memcmp(frame.data(), decoded.data(), rawSize) == 0);
+
+        // FrameRing::Compress() keeps a frame raw unless it gets smaller.
+        printf("  %-16s %8.1f:1 (%5.1f%%)  encode %6.2f ms (%6.0f MB/s)  decode %6.2f ms (%6.0f MB/s)%s\n",
+            content.name,
+            static_cast<double>(rawSize) / size,
+            100.0 * size / rawSize,
+            encodeTime, rawSize / encodeTime / 1e3,
+            decodeTime, rawSize / decodeTime / 1e3,
+            size < rawSize ? "" : "  kept raw");
+    }
+}
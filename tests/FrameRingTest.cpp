@@ -0,0 +1,306 @@
+#include "pch.h"
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "Test.h"
+#include "../sources/AllocationCounter.h"
+#include "../sources/FrameRing.h"
+
+namespace
+{
+    // Every published frame is derived from its sequence, so a reader can tell a torn or stale frame
+    // from a good one. Rows of one value keep the frames compressible.
+    UINT GetFrameWidth(UINT64 sequence) { return 32 + static_cast<UINT>(sequence % 29); }
+    UINT GetFrameHeight(UINT64 sequence) { return 16 + static_cast<UINT>(sequence % 7); }
+    BYTE GetRowValue(UINT64 sequence, UINT y) { return static_cast<BYTE>(sequence * 3 + y); }
+
+    void WriteFrame(FrameRing::Frame* frame, UINT64 sequence)
+    {
+        frame->width = GetFrameWidth(sequence);
+        frame->height = GetFrameHeight(sequence);
+        frame->buffer.ExpandIfNeeded(frame->width * frame->height * 4);
+        for (UINT y = 0; y < frame->height; ++y)
+        {
+            memset(frame->buffer.Get() + y * frame->width * 4, GetRowValue(sequence, y), frame->width * 4);
+        }
+    }
+
+    bool IsFrameIntact(const BYTE* pixels, UINT width, UINT height, UINT64 sequence)
+    {
+        if (!pixels || width != GetFrameWidth(sequence) || height != GetFrameHeight(sequence)) return false;
+
+        for (UINT y = 0; y < height; ++y)
+        {
+            const BYTE value = GetRowValue(sequence, y);
+            for (UINT i = 0; i < width * 4; ++i)
+            {
+                if (pixels[y * width * 4 + i] != value) return false;
+            }
+        }
+        return true;
+    }
+
+    bool Publish(FrameRing* ring)
+    {
+        auto frame = ring->BeginWrite();
+        if (!frame) return false;
+
+        WriteFrame(frame, ring->GetSequence() + 1);
+        ring->EndWrite(true);
+        return true;
+    }
+
+    bool IsPublishedIntact(const FrameRing& ring)
+    {
+        const int index = ring.AcquireRead();
+        if (index < 0) return false;
+
+        const auto& frame = ring.GetFrame(index);
+        const bool isIntact = IsFrameIntact(frame.buffer.Get(), frame.width, frame.height, frame.sequence);
+        ring.ReleaseRead(index);
+        return isIntact;
+    }
+}
+
+
+TEST(FrameRing_PublishAndRead)
+{
+    FrameRing ring;
+    CHECK(!ring.HasFrame());
+    CHECK(ring.AcquireRead() < 0);
+
+    // A frame that is not published stays invisible.
+    auto frame = ring.BeginWrite();
+    CHECK(frame != nullptr);
+    WriteFrame(frame, 1);
+    ring.EndWrite(false);
+    CHECK(!ring.HasFrame());
+    CHECK(ring.GetSequence() == 0);
+
+    for (int i = 0; i < FrameRing::kSlotCount * 2; ++i)
+    {
+        CHECK(Publish(&ring));
+        CHECK(ring.GetSequence() == static_cast<UINT64>(i + 1));
+        CHECK(IsPublishedIntact(ring));
+    }
+}
+
+
+TEST(FrameRing_CompressRestoreAndEvict)
+{
+    FrameRing ring;
+    Buffer<BYTE> scratch;
+
+    CHECK(Publish(&ring));
+    CHECK(ring.Compress(&scratch) > 0);
+    CHECK(ring.IsCompressed());
+
+    // The first reader restores the frame and pins it, so neither Compress() nor Evict() may touch it.
+    const int index = ring.AcquireRead();
+    CHECK(index >= 0);
+    CHECK(!ring.IsCompressed());
+    ring.Compress(&scratch);
+    ring.Evict();
+    CHECK(!ring.IsCompressed());
+    CHECK(ring.HasFrame());
+    const auto& frame = ring.GetFrame(index);
+    CHECK(IsFrameIntact(frame.buffer.Get(), frame.width, frame.height, frame.sequence));
+    ring.ReleaseRead(index);
+
+    // A compressed slot that is no longer published is reused by the writer.
+    CHECK(ring.Compress(&scratch) > 0);
+    for (int i = 0; i < FrameRing::kSlotCount * 2; ++i)
+    {
+        CHECK(Publish(&ring));
+        CHECK(!ring.IsCompressed());
+        CHECK(IsPublishedIntact(ring));
+    }
+
+    ring.Evict();
+    CHECK(!ring.HasFrame());
+    CHECK(ring.AcquireRead() < 0);
+}
+
+
+TEST(FrameRing_EvictSkipsPinnedSlots)
+{
+    FrameRing ring;
+    CHECK(Publish(&ring));
+
+    // A pinned frame may not be evicted.
+    const int index = ring.AcquireRead();
+    CHECK(index >= 0);
+    ring.Evict();
+    CHECK(ring.HasFrame());
+    const auto& frame = ring.GetFrame(index);
+    CHECK(IsFrameIntact(frame.buffer.Get(), frame.width, frame.height, frame.sequence));
+    ring.ReleaseRead(index);
+
+    ring.Evict();
+    CHECK(!ring.HasFrame());
+    CHECK(ring.AcquireRead() < 0);
+
+    // The next capture refills the ring.
+    CHECK(Publish(&ring));
+    CHECK(IsPublishedIntact(ring));
+}
+
+
+TEST(FrameRing_WriterSkipsPinnedSlots)
+{
+    FrameRing ring;
+    int pinned[FrameRing::kSlotCount];
+
+    // Pin every slot in turn; once all of them are pinned the writer has to drop its frame.
+    for (int i = 0; i < FrameRing::kSlotCount; ++i)
+    {
+        CHECK(Publish(&ring));
+        pinned[i] = ring.AcquireRead();
+        CHECK(pinned[i] >= 0);
+    }
+    CHECK(ring.BeginWrite() == nullptr);
+
+    for (int i = 0; i < FrameRing::kSlotCount; ++i)
+    {
+        const auto& frame = ring.GetFrame(pinned[i]);
+        CHECK(frame.sequence == static_cast<UINT64>(i + 1));
+        CHECK(IsFrameIntact(frame.buffer.Get(), frame.width, frame.height, frame.sequence));
+        ring.ReleaseRead(pinned[i]);
+    }
+
+    CHECK(Publish(&ring));
+    CHECK(IsPublishedIntact(ring));
+}
+
+
+// One writer, several snapshot readers and concurrent Compress()/Evict(): readers must only ever see
+// whole published frames, in order.
+TEST(FrameRing_ConcurrentReadersNeverSeeTornFrames)
+{
+    constexpr int kFrameCount = 20000;
+    constexpr int kMinReadCount = 10000;
+    constexpr int kReaderCount = 4;
+
+    auto ring = std::make_shared<FrameRing>();
+    std::atomic<bool> isWriting { true };
+    std::atomic<int> tornCount { 0 };
+    std::atomic<int> reorderCount { 0 };
+    std::atomic<int> readCount { 0 };
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < kReaderCount; ++i)
+    {
+        threads.emplace_back([&]
+        {
+            UINT64 lastSequence = 0;
+            while (isWriting)
+            {
+                FrameSnapshot snapshot;
+                if (!AcquireFrameSnapshot(ring, &snapshot))
+                {
+                    std::this_thread::yield();
+                    continue;
+                }
+
+                // A pinned frame must stay intact while other threads run.
+                if (!IsFrameIntact(snapshot.pixels, snapshot.width, snapshot.height, snapshot.sequence)) ++tornCount;
+                std::this_thread::yield();
+                if (!IsFrameIntact(snapshot.pixels, snapshot.width, snapshot.height, snapshot.sequence)) ++tornCount;
+                if (snapshot.sequence < lastSequence) ++reorderCount;
+                lastSequence = snapshot.sequence;
+                ++readCount;
+
+                ReleaseFrameSnapshot(&snapshot);
+                std::this_thread::yield();
+            }
+        });
+    }
+
+    threads.emplace_back([&]
+    {
+        Buffer<BYTE> scratch;
+        while (isWriting)
+        {
+            ring->Compress(&scratch);
+            std::this_thread::yield();
+        }
+    });
+
+    threads.emplace_back([&]
+    {
+        while (isWriting)
+        {
+            ring->Evict();
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    });
+
+    for (int i = 0; i < kFrameCount || readCount < kMinReadCount; ++i)
+    {
+        std::this_thread::yield();
+
+        auto frame = ring->BeginWrite();
+        if (!frame) continue;
+
+        // Unpublished frames hold garbage that no reader may see.
+        if (i % 5 == 4)
+        {
+            frame->width = GetFrameWidth(0);
+            frame->height = GetFrameHeight(0);
+            frame->buffer.ExpandIfNeeded(frame->width * frame->height * 4);
+            memset(frame->buffer.Get(), 0xCD, frame->width * frame->height * 4);
+            ring->EndWrite(false);
+            continue;
+        }
+
+        WriteFrame(frame, ring->GetSequence() + 1);
+        ring->EndWrite(true);
+    }
+
+    isWriting = false;
+    for (auto& thread : threads) thread.join();
+
+    CHECK(tornCount == 0);
+    CHECK(reorderCount == 0);
+    CHECK(readCount > 0);
+
+    // No pin may be left behind.
+    ring->Evict();
+    CHECK(!ring->HasFrame());
+}
+
+
+// Snapshots are taken every frame, so their leases must not allocate, and each one must keep the
+// ring alive after its owner lets go of it, also beyond the pool.
+TEST(FrameRing_SnapshotLeasesArePooled)
+{
+    auto ring = std::make_shared<FrameRing>();
+    CHECK(Publish(ring.get()));
+
+    const UINT64 start = AllocationCounter::GetThreadCount();
+    for (int i = 0; i < 100; ++i)
+    {
+        FrameSnapshot snapshot;
+        CHECK(AcquireFrameSnapshot(ring, &snapshot));
+        ReleaseFrameSnapshot(&snapshot);
+    }
+    CHECK(AllocationCounter::GetThreadCount() == start);
+
+    std::vector<FrameSnapshot> snapshots(FrameRing::kLeaseCount + 4);
+    for (auto& held : snapshots)
+    {
+        CHECK(AcquireFrameSnapshot(ring, &held));
+    }
+
+    const std::weak_ptr<FrameRing> weakRing = ring;
+    ring.reset();
+    for (auto& held : snapshots)
+    {
+        CHECK(!weakRing.expired());
+        CHECK(IsFrameIntact(held.pixels, held.width, held.height, held.sequence));
+        ReleaseFrameSnapshot(&held);
+        CHECK(held.handle == nullptr);
+    }
+    CHECK(weakRing.expired());
+}
@@ -0,0 +1,120 @@
+#include "pch.h"
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <vector>
+#include "Test.h"
+#include "../sources/ImagePipeline.h"
+#include "../sources/PixelKernels.h"
+
+namespace
+{
+    constexpr int kRunCount = 5;
+
+    void FillRandom(const ImageView<PixelFormatBGRA8>& view)
+    {
+        UINT seed = 1;
+        for (UINT y = 0; y < view.GetHeight(); ++y)
+        {
+            auto row = view.GetRowPixels(y);
+            for (UINT x = 0; x < view.GetWidth(); ++x)
+            {
+                seed = seed * 1664525u + 1013904223u;
+                row[x] = seed;
+            }
+        }
+    }
+
+    // GetPixels() as it was before the kernels: one pixel at a time into the flipped output.
+    void SwizzleAndFlipPerPixel(const ConstImageView<PixelFormatBGRA8>& src, BYTE* output)
+    {
+        const UINT width = src.GetWidth();
+        const UINT height = src.GetHeight();
+        for (UINT y = 0; y < height; ++y)
+        {
+            const BYTE* srcRow = reinterpret_cast<const BYTE*>(src.GetRowPixels(y));
+            BYTE* dstRow = output + static_cast<size_t>(height - 1 - y) * width * 4;
+            for (UINT x = 0; x < width; ++x)
+            {
+                dstRow[x * 4 + 0] = srcRow[x * 4 + 2];
+                dstRow[x * 4 + 1] = srcRow[x * 4 + 1];
+                dstRow[x * 4 + 2] = srcRow[x * 4 + 0];
+                dstRow[x * 4 + 3] = srcRow[x * 4 + 3];
+            }
+        }
+    }
+
+    // The pipeline of GetPixels() over the whole frame.
+    bool SwizzleAndFlip(const ConstImageView<PixelFormatBGRA8>& src, BYTE* output, UINT maxThreadCount)
+    {
+        return ImagePipeline<PixelFormatBGRA8, PixelFormatRGBA8>()
+            .Crop(0, 0, src.GetWidth(), src.GetHeight())
+            .FlipVertical()
+            .SetMaxThreadCount(maxThreadCount)
+            .Run(src, ImageView<PixelFormatRGBA8>(output, src.GetWidth(), src.GetHeight()));
+    }
+
+    void Report(const char* name, double time, size_t bytes)
+    {
+        printf("    %-20s %8.2f ms  %6.2f GB/s\n", name, time, bytes / time / 1e6);
+    }
+}
+
+
+// The BGRA to RGBA swizzle and vertical flip of GetPixels() for a whole frame at common sizes: the
+// per-pixel loop it replaced, the pipeline on one thread with each kernel variant the CPU has, and
+// the pipeline on every thread.
+BENCHMARK(GetPixels_SwizzleAndFlip)
+{
+    const struct
+    {
+        const char* name;
+        UINT width;
+        UINT height;
+    } sizes[] = { { "720p", 1280, 720 }, { "1080p", 1920, 1080 }, { "4K", 3840, 2160 }, { "8K", 7680, 4320 } };
+
+    const char* const isaNames[] = { "Scalar", "SSE2", "AVX2" };
+
+    // The variants are capped below, so bind the best ones again however this returns.
+    const auto isaRestorer = MakeScopedReleaser([] { PixelKernels::Initialize(); });
+
+    printf("  best of %d runs\n", kRunCount);
+    for (const auto& size : sizes)
+    {
+        Image<PixelFormatBGRA8> frame(size.width, size.height);
+        FillRandom(frame.GetView());
+        const ConstImageView<PixelFormatBGRA8> src = frame.GetView();
+
+        const size_t bytes = static_cast<size_t>(size.width) * size.height * 4;
+        std::vector<BYTE> expected(bytes);
+        std::vector<BYTE> output(bytes);
+
+        printf("  %s (%ux%u)\n", size.name, size.width, size.height);
+        Report("per pixel", MeasureMilliseconds(kRunCount, [&] { SwizzleAndFlipPerPixel(src, expected.data()); }), bytes);
+
+        for (int isa = 0; isa <= static_cast<int>(PixelKernels::GetDetectedIsa()); ++isa)
+        {
+            PixelKernels::Initialize(static_cast<CpuIsa>(isa));
+            CHECK(PixelKernels::GetActiveIsa() == static_cast<CpuIsa>(isa));
+
+            bool isConverted = false;
+            const double time = MeasureMilliseconds(kRunCount, [&] { isConverted = SwizzleAndFlip(src, output.data(), 1); });
+            CHECK(isConverted);
+            CHECK(memcmp(output.data(), expected.data(), bytes) == 0);
+            Report(isaNames[isa], time, bytes);
+        }
+
+        PixelKernels::Initialize();
+        memset(output.data(), 0, bytes);
+
+        const UINT threadCount = std::max<UINT>(std::thread::hardware_concurrency(), 1);
+        bool isConverted = false;
+        const double time = MeasureMilliseconds(kRunCount, [&] { isConverted = SwizzleAndFlip(src, output.data(), threadCount); });
+        CHECK(isConverted);
+        CHECK(memcmp(output.data(), expected.data(), bytes) == 0);
+
+        char name[32];
+        snprintf(name, sizeof(name), "%s, %u thread(s)", isaNames[static_cast<int>(PixelKernels::GetActiveIsa())], threadCount);
+        Report(name, time, bytes);
+    }
+}
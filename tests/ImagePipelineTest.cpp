@@ -0,0 +1,69 @@
+#include "pch.h"
+#include <cstring>
+#include "Test.h"
+#include "../sources/FormatConverter.h"
+#include "../sources/ImagePipeline.h"
+
+namespace
+{
+    void FillRandom(const ImageView<PixelFormatBGRA8>& view, UINT seed)
+    {
+        for (UINT y = 0; y < view.GetHeight(); ++y)
+        {
+            auto row = view.GetRowPixels(y);
+            for (UINT x = 0; x < view.GetWidth(); ++x)
+            {
+                seed = seed * 1664525u + 1013904223u;
+                row[x] = seed;
+            }
+        }
+    }
+
+    bool IsSame(const ConstImageView<PixelFormatBGRA8>& a, const ConstImageView<PixelFormatBGRA8>& b)
+    {
+        if (a.GetWidth() != b.GetWidth() || a.GetHeight() != b.GetHeight()) return false;
+        for (UINT y = 0; y < a.GetHeight(); ++y)
+        {
+            if (memcmp(a.GetRow(y), b.GetRow(y), a.GetWidth() * 4) != 0) return false;
+        }
+        return true;
+    }
+}
+
+
+// Every band works on its own slice of the shared scratch, so the result must not depend on how
+// many bands the rows are split into, also when one resampler or scratch is reused with more bands.
+TEST(ImagePipeline_BandsMatchOneThread)
+{
+    Image<PixelFormatBGRA8> src(1920, 1080);
+    FillRandom(src.GetView(), 7);
+    CHECK(GetRowBandCount(src.GetHeight() / 2, src.GetWidth() * 2, 4) > 1);
+
+    const UINT dstWidth = 957;
+    const UINT dstHeight = 541;
+    for (const auto filter : { ResampleFilter::Box, ResampleFilter::Bilinear, ResampleFilter::Lanczos })
+    {
+        Resampler resampler;
+        ImagePipeline<PixelFormatBGRA8, PixelFormatBGRA8> pipeline;
+        pipeline.Resample(filter, &resampler);
+
+        Image<PixelFormatBGRA8> expected(dstWidth, dstHeight);
+        Image<PixelFormatBGRA8> actual(dstWidth, dstHeight);
+        CHECK(pipeline.SetMaxThreadCount(1).Run(src.GetView(), expected.GetView()));
+        CHECK(pipeline.SetMaxThreadCount(4).Run(src.GetView(), actual.GetView()));
+        CHECK(IsSame(expected.GetView(), actual.GetView()));
+    }
+
+    for (const auto format : { OutputFormat::NV12, OutputFormat::I420 })
+    {
+        // An odd width takes the path that averages the last column with itself.
+        const auto region = ConstImageView<PixelFormatBGRA8>(src.GetView()).Crop(0, 0, 1919, 1079);
+        const UINT size = FormatConverter::GetSize(format, region.GetWidth(), region.GetHeight());
+        Buffer<BYTE> scratch;
+        Buffer<BYTE> expected(size);
+        Buffer<BYTE> actual(size);
+        CHECK(FormatConverter::Convert(region, format, expected.Get(), size, 1, &scratch));
+        CHECK(FormatConverter::Convert(region, format, actual.Get(), size, 4, &scratch));
+        CHECK(memcmp(expected.Get(), actual.Get(), size) == 0);
+    }
+}
@@ -0,0 +1,109 @@
+#include "pch.h"
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include "Test.h"
+#include "../sources/ImageRotation.h"
+
+namespace
+{
+    constexpr UINT kWidth = 3840;
+    constexpr UINT kHeight = 2160;
+    constexpr int kRunCount = 5;
+
+    void FillRandom(const ImageView<PixelFormatBGRA8>& view)
+    {
+        UINT seed = 3;
+        for (UINT y = 0; y < view.GetHeight(); ++y)
+        {
+            auto row = view.GetRowPixels(y);
+            for (UINT x = 0; x < view.GetWidth(); ++x)
+            {
+                seed = seed * 1664525u + 1013904223u;
+                row[x] = seed;
+            }
+        }
+    }
+
+    // Reads the source in order and writes every pixel where it goes, which for a quarter turn
+    // steps a whole row of the destination between writes.
+    void RotatePerPixel(const ConstImageView<PixelFormatBGRA8>& src, const ImageView<PixelFormatBGRA8>& dst, FrameRotation rotation)
+    {
+        const UINT width = src.GetWidth();
+        const UINT height = src.GetHeight();
+        for (UINT y = 0; y < height; ++y)
+        {
+            const auto srcRow = src.GetRowPixels(y);
+            for (UINT x = 0; x < width; ++x)
+            {
+                switch (rotation)
+                {
+                    case FrameRotation::Clockwise90: dst.GetRowPixels(x)[height - 1 - y] = srcRow[x]; break;
+                    case FrameRotation::Clockwise180: dst.GetRowPixels(height - 1 - y)[width - 1 - x] = srcRow[x]; break;
+                    case FrameRotation::Clockwise270: dst.GetRowPixels(width - 1 - x)[y] = srcRow[x]; break;
+                    default: dst.GetRowPixels(y)[x] = srcRow[x]; break;
+                }
+            }
+        }
+    }
+
+    bool IsSame(const ConstImageView<PixelFormatBGRA8>& a, const ConstImageView<PixelFormatBGRA8>& b)
+    {
+        for (UINT y = 0; y < a.GetHeight(); ++y)
+        {
+            if (memcmp(a.GetRow(y), b.GetRow(y), a.GetWidth() * 4) != 0) return false;
+        }
+        return true;
+    }
+
+    void Report(const char* name, double time)
+    {
+        printf("    %-20s %8.2f ms  %6.2f GB/s\n", name, time, kWidth * kHeight * 4.0 / time / 1e6);
+    }
+}
+
+
+// A 4K frame rotated the way a portrait or upside-down monitor needs it: the per-pixel loop
+// against the tiled Rotate() on one thread and on every thread.
+BENCHMARK(ImageRotation_TiledVersusPerPixel)
+{
+    const struct
+    {
+        const char* name;
+        FrameRotation rotation;
+    } rotations[] = { { "90", FrameRotation::Clockwise90 }, { "180", FrameRotation::Clockwise180 }, { "270", FrameRotation::Clockwise270 } };
+
+    Image<PixelFormatBGRA8> src(kWidth, kHeight);
+    FillRandom(src.GetView());
+
+    const UINT threadCount = std::max<UINT>(std::thread::hardware_concurrency(), 1);
+
+    printf("  %ux%u, best of %d runs\n", kWidth, kHeight, kRunCount);
+    for (const auto& rotation : rotations)
+    {
+        UINT width, height;
+        ImageRotation::GetRotatedSize(rotation.rotation, kWidth, kHeight, &width, &height);
+        Image<PixelFormatBGRA8> expected(width, height);
+        Image<PixelFormatBGRA8> dst(width, height);
+
+        printf("  Clockwise %s\n", rotation.name);
+        Report("per pixel", MeasureMilliseconds(kRunCount, [&] { RotatePerPixel(src.GetView(), expected.GetView(), rotation.rotation); }));
+
+        for (UINT maxThreadCount = 1; ; maxThreadCount = threadCount)
+        {
+            bool isRotated = false;
+            const double time = MeasureMilliseconds(kRunCount, [&]
+            {
+                isRotated = ImageRotation::Rotate(src.GetView(), dst.GetView(), rotation.rotation, false, maxThreadCount);
+            });
+            CHECK(isRotated);
+            CHECK(IsSame(dst.GetView(), expected.GetView()));
+
+            char name[32];
+            snprintf(name, sizeof(name), "tiled, %u thread(s)", maxThreadCount);
+            Report(name, time);
+
+            if (maxThreadCount == threadCount) break;
+        }
+    }
+}
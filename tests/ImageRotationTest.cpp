@@ -0,0 +1,127 @@
+#include "pch.h"
+#include <cstdio>
+#include "Test.h"
+#include "../sources/ImageRotation.h"
+
+namespace
+{
+    const FrameRotation kRotations[] = { FrameRotation::None, FrameRotation::Clockwise90, FrameRotation::Clockwise180, FrameRotation::Clockwise270 };
+
+    void FillRandom(const ImageView<PixelFormatBGRA8>& view, UINT seed)
+    {
+        for (UINT y = 0; y < view.GetHeight(); ++y)
+        {
+            auto row = view.GetRowPixels(y);
+            for (UINT x = 0; x < view.GetWidth(); ++x)
+            {
+                seed = seed * 1664525u + 1013904223u;
+                row[x] = seed;
+            }
+        }
+    }
+
+    // Where pixel (x, y) of a width x height image goes, one pixel at a time.
+    void MapPixel(FrameRotation rotation, bool mirror, UINT width, UINT height, UINT x, UINT y, UINT* dstX, UINT* dstY)
+    {
+        switch (rotation)
+        {
+            case FrameRotation::Clockwise90: *dstX = height - 1 - y; *dstY = x; break;
+            case FrameRotation::Clockwise180: *dstX = width - 1 - x; *dstY = height - 1 - y; break;
+            case FrameRotation::Clockwise270: *dstX = y; *dstY = width - 1 - x; break;
+            default: *dstX = x; *dstY = y; break;
+        }
+
+        if (mirror)
+        {
+            const bool isSwapped = rotation == FrameRotation::Clockwise90 || rotation == FrameRotation::Clockwise270;
+            *dstX = (isSwapped ? height : width) - 1 - *dstX;
+        }
+    }
+
+    bool IsRotated(const ConstImageView<PixelFormatBGRA8>& src, const ConstImageView<PixelFormatBGRA8>& dst, FrameRotation rotation, bool mirror)
+    {
+        for (UINT y = 0; y < src.GetHeight(); ++y)
+        {
+            for (UINT x = 0; x < src.GetWidth(); ++x)
+            {
+                UINT dstX, dstY;
+                MapPixel(rotation, mirror, src.GetWidth(), src.GetHeight(), x, y, &dstX, &dstY);
+                if (dst.GetRowPixels(dstY)[dstX] != src.GetRowPixels(y)[x])
+                {
+                    printf("  Rotation %d%s of %ux%u differs at (%u, %u)\n", static_cast<int>(rotation), mirror ? " mirrored" : "", src.GetWidth(), src.GetHeight(), x, y);
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+}
+
+
+// Every orientation against the per-pixel mapping, for sizes that are not multiples of the
+// 32x32 cache tile or the SIMD blocks, with one band and with several.
+TEST(ImageRotation_MatchesPerPixelReference)
+{
+    const UINT sizes[][2] = { { 1, 1 }, { 1, 37 }, { 37, 1 }, { 31, 33 }, { 33, 31 }, { 70, 37 }, { 257, 129 }, { 600, 75 } };
+
+    for (const auto& size : sizes)
+    {
+        Image<PixelFormatBGRA8> src(size[0], size[1]);
+        FillRandom(src.GetView(), size[0] * 131 + size[1]);
+
+        for (const auto rotation : kRotations)
+        {
+            for (const bool mirror : { false, true })
+            {
+                UINT width, height;
+                ImageRotation::GetRotatedSize(rotation, size[0], size[1], &width, &height);
+
+                for (const UINT threadCount : { 1u, 4u })
+                {
+                    Image<PixelFormatBGRA8> dst(width, height);
+                    CHECK(ImageRotation::Rotate(src.GetView(), dst.GetView(), rotation, mirror, threadCount));
+                    CHECK(IsRotated(src.GetView(), dst.GetView(), rotation, mirror));
+                }
+            }
+        }
+    }
+}
+
+
+// The captured region is mapped into the rotated frame, so its pixels must be the rotated pixels
+// of the region in the source.
+TEST(ImageRotation_RegionFollowsRotation)
+{
+    constexpr UINT kWidth = 97;
+    constexpr UINT kHeight = 61;
+    constexpr UINT kLeft = 5;
+    constexpr UINT kTop = 11;
+    constexpr UINT kRegionWidth = 70;
+    constexpr UINT kRegionHeight = 33;
+
+    Image<PixelFormatBGRA8> src(kWidth, kHeight);
+    FillRandom(src.GetView(), 3);
+    const auto region = ConstImageView<PixelFormatBGRA8>(src.GetView()).Crop(kLeft, kTop, kRegionWidth, kRegionHeight);
+
+    for (const auto rotation : kRotations)
+    {
+        for (const bool mirror : { false, true })
+        {
+            UINT width, height;
+            ImageRotation::GetRotatedSize(rotation, kWidth, kHeight, &width, &height);
+            Image<PixelFormatBGRA8> dst(width, height);
+            CHECK(ImageRotation::Rotate(src.GetView(), dst.GetView(), rotation, mirror, 1));
+
+            UINT x = kLeft, y = kTop, regionWidth = kRegionWidth, regionHeight = kRegionHeight;
+            CHECK(ImageRotation::RotateRegion(rotation, mirror, kWidth, kHeight, &x, &y, &regionWidth, &regionHeight));
+            const auto rotatedRegion = ConstImageView<PixelFormatBGRA8>(dst.GetView()).Crop(x, y, regionWidth, regionHeight);
+            CHECK(!rotatedRegion.Empty());
+            CHECK(IsRotated(region, rotatedRegion, rotation, mirror));
+        }
+    }
+
+    // A region that does not fit is left as it is.
+    UINT x = kLeft, y = kTop, regionWidth = kWidth, regionHeight = kRegionHeight;
+    CHECK(!ImageRotation::RotateRegion(FrameRotation::Clockwise90, false, kWidth, kHeight, &x, &y, &regionWidth, &regionHeight));
+    CHECK(x == kLeft && y == kTop && regionWidth == kWidth && regionHeight == kRegionHeight);
+}
@@ -0,0 +1,173 @@
+#include "pch.h"
+#include <algorithm>
+#include <cstring>
+#include <vector>
+#include "Test.h"
+#include "../sources/PartialUpload.h"
+
+namespace
+{
+    // A window of random pixels whose content area is edited and scrolled, as an editor or a
+    // browser would be. Only a region inside the frame is uploaded, as with a captured window.
+    class EditedWindow
+    {
+    public:
+        static constexpr UINT kWidth = 1300;
+        static constexpr UINT kHeight = 900;
+
+        EditedWindow()
+            : frame_(kWidth, kHeight)
+            , previous_(kWidth * kHeight)
+        {
+            for (UINT y = 0; y < kHeight; ++y)
+            {
+                auto row = frame_.GetView().GetRowPixels(y);
+                for (UINT x = 0; x < kWidth; ++x) row[x] = Next();
+            }
+        }
+
+        ConstImageView<PixelFormatBGRA8> GetView() const
+        {
+            return frame_.GetView();
+        }
+
+        // Cycles through edits, two vertical scrolls and a horizontal scroll.
+        void Change(UINT frameNumber)
+        {
+            switch (frameNumber % 4)
+            {
+                case 1:
+                case 2:
+                    Scroll(150, 40, 900, 700, 0, GetOffset(60));
+                    break;
+                case 3:
+                    Scroll(100, 200, 1000, 400, GetOffset(40), 0);
+                    break;
+                default:
+                    Edit();
+                    break;
+            }
+        }
+
+    private:
+        UINT Next()
+        {
+            seed_ = seed_ * 1664525u + 1013904223u;
+            return seed_;
+        }
+
+        int GetOffset(UINT maxOffset)
+        {
+            const int offset = static_cast<int>(Next() % maxOffset) + 1;
+            return Next() % 2 ? offset : -offset;
+        }
+
+        // Up to three random rectangles, possibly none at all.
+        void Edit()
+        {
+            const auto view = frame_.GetView();
+            const UINT count = Next() % 4;
+            for (UINT i = 0; i < count; ++i)
+            {
+                const UINT left = Next() % kWidth;
+                const UINT top = Next() % kHeight;
+                const UINT right = std::min<UINT>(kWidth, left + 1 + Next() % 150);
+                const UINT bottom = std::min<UINT>(kHeight, top + 1 + Next() % 150);
+                for (UINT y = top; y < bottom; ++y)
+                {
+                    auto row = view.GetRowPixels(y);
+                    for (UINT x = left; x < right; ++x) row[x] = Next();
+                }
+            }
+        }
+
+        // Moves the pixels of the rectangle by (-dx, -dy); what scrolls in is new content.
+        void Scroll(UINT left, UINT top, UINT width, UINT height, int dx, int dy)
+        {
+            const auto view = frame_.GetView();
+            memcpy(previous_.data(), view.GetData(), previous_.size() * 4);
+
+            for (UINT y = top; y < top + height; ++y)
+            {
+                auto row = view.GetRowPixels(y);
+                for (UINT x = left; x < left + width; ++x)
+                {
+                    const int srcX = static_cast<int>(x) + dx;
+                    const int srcY = static_cast<int>(y) + dy;
+                    const bool isInside =
+                        srcX >= static_cast<int>(left) && srcX < static_cast<int>(left + width) &&
+                        srcY >= static_cast<int>(top) && srcY < static_cast<int>(top + height);
+                    row[x] = isInside ? previous_[srcY * kWidth + srcX] : Next();
+                }
+            }
+        }
+
+        Image<PixelFormatBGRA8> frame_;
+        std::vector<UINT> previous_;
+        UINT seed_ = 9;
+    };
+
+    bool IsSame(const ConstImageView<PixelFormatBGRA8>& a, const ConstImageView<PixelFormatBGRA8>& b)
+    {
+        if (a.GetWidth() != b.GetWidth() || a.GetHeight() != b.GetHeight()) return false;
+        for (UINT y = 0; y < a.GetHeight(); ++y)
+        {
+            if (memcmp(a.GetRow(y), b.GetRow(y), a.GetWidth() * 4) != 0) return false;
+        }
+        return true;
+    }
+}
+
+
+// Replays edited and scrolled frames through the dirty tiles and scroll detection into a memory
+// target, the way Upload() feeds a texture. After every frame the target must hold the same pixels
+// as a target that received the frame in full.
+TEST(PartialUpload_EditedAndScrolledFramesMatchFullUpload)
+{
+    constexpr UINT kLeft = 7;
+    constexpr UINT kTop = 9;
+    constexpr UINT kWidth = 1250;
+    constexpr UINT kHeight = 850;
+    constexpr UINT kFrameCount = 200;
+
+    EditedWindow window;
+    TileHasher hasher;
+    DirtyTiles dirtyTiles;
+    FrameMotion motion;
+    PartialUploader uploader;
+    MemoryUploadTarget target;
+    MemoryUploadTarget fullTarget;
+
+    for (UINT frameNumber = 0; frameNumber < kFrameCount; ++frameNumber)
+    {
+        if (frameNumber > 0) window.Change(frameNumber);
+
+        CHECK(hasher.Update(window.GetView(), kLeft, kTop, kWidth, kHeight, 2, &dirtyTiles, &motion));
+        const auto image = window.GetView().Crop(kLeft, kTop, kWidth, kHeight);
+
+        // The first frame has no previous one in the target.
+        if (frameNumber == 0)
+        {
+            CHECK(uploader.Upload(&target, image, nullptr));
+        }
+        else if (dirtyTiles.GetDirtyCount() == 0)
+        {
+            uploader.Skip(image);
+        }
+        else
+        {
+            CHECK(uploader.Upload(&target, image, &dirtyTiles, &motion));
+        }
+
+        CHECK(fullTarget.Upload(image));
+        CHECK(IsSame(target.GetImage(), fullTarget.GetImage()));
+    }
+
+    const auto stats = uploader.GetStats();
+    CHECK(stats.fullUploads + stats.partialUploads + stats.skippedUploads == kFrameCount);
+    CHECK(stats.partialUploads > 0);
+    CHECK(stats.moves > 0);
+    CHECK(stats.uploadedBytes == target.GetUploadedBytes());
+    CHECK(stats.uploadedBytes < stats.frameBytes);
+    CHECK(stats.frameBytes == fullTarget.GetUploadedBytes());
+}
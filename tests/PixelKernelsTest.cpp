@@ -0,0 +1,440 @@
+#include "pch.h"
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include "Test.h"
+#include "../sources/PixelKernels.h"
+
+namespace
+{
+    // Widths up to this cover several full vectors and every tail length of the AVX2 loops.
+    constexpr UINT kMaxWidth = 67;
+
+    const char* GetIsaName(CpuIsa isa)
+    {
+        switch (isa)
+        {
+            case CpuIsa::SSE2: return "SSE2";
+            case CpuIsa::AVX2: return "AVX2";
+            default: return "Scalar";
+        }
+    }
+
+    // The SIMD levels the CPU can run, each compared with the scalar variant.
+    std::vector<CpuIsa> GetSimdIsas()
+    {
+        std::vector<CpuIsa> isas;
+        if (PixelKernels::GetDetectedIsa() >= CpuIsa::SSE2) isas.push_back(CpuIsa::SSE2);
+        if (PixelKernels::GetDetectedIsa() >= CpuIsa::AVX2) isas.push_back(CpuIsa::AVX2);
+        return isas;
+    }
+
+    std::vector<BYTE> MakeRandomBytes(size_t size, UINT seed)
+    {
+        std::vector<BYTE> bytes(size);
+        for (auto& value : bytes)
+        {
+            seed = seed * 1664525 + 1013904223;
+            value = static_cast<BYTE>(seed >> 24);
+        }
+        return bytes;
+    }
+
+    bool IsSame(const char* kernel, CpuIsa isa, UINT width, const void* expected, const void* actual, size_t size)
+    {
+        if (memcmp(expected, actual, size) == 0) return true;
+        printf("  %s (%s) differs from the scalar one. width=%u\n", kernel, GetIsaName(isa), width);
+        return false;
+    }
+
+    UINT LoadPixel(const BYTE* src)
+    {
+        UINT pixel;
+        memcpy(&pixel, src, 4);
+        return pixel;
+    }
+
+    bool IsPixel(const char* kernel, CpuIsa isa, UINT x, const BYTE* actual, UINT expected)
+    {
+        if (LoadPixel(actual) == expected) return true;
+        printf("  %s (%s) wrote %08X instead of %08X. x=%u\n", kernel, GetIsaName(isa), LoadPixel(actual), expected, x);
+        return false;
+    }
+
+    void StorePixel(BYTE* dst, UINT pixel)
+    {
+        memcpy(dst, &pixel, 4);
+    }
+
+    // Source rows start 0 to 3 pixels into the buffer, so that every alignment is covered.
+    UINT GetOffset(UINT width)
+    {
+        return (width % 4) * 4;
+    }
+}
+
+
+// Kernels that map pixels to pixels. The output buffers are compared whole, so a variant that
+// writes past the width fails too.
+TEST(PixelKernels_RowKernelsMatchScalar)
+{
+    using RowFunc = void(*)(const BYTE*, BYTE*, UINT);
+    struct Kernel
+    {
+        const char* name;
+        RowFunc funcs[3];
+    };
+    const Kernel kernels[] =
+    {
+        { "SwapRedBlue", { &PixelKernels::SwapRedBlueScalar, &PixelKernels::SwapRedBlueSSE2, &PixelKernels::SwapRedBlueAVX2 } },
+        { "ToRGB565", { &PixelKernels::ToRGB565Scalar, &PixelKernels::ToRGB565SSE2, &PixelKernels::ToRGB565AVX2 } },
+        { "ToRGBA16F", { &PixelKernels::ToRGBA16FScalar, &PixelKernels::ToRGBA16FScalar, &PixelKernels::ToRGBA16FAVX2 } },
+        { "Premultiply", { &PixelKernels::PremultiplyScalar, &PixelKernels::PremultiplySSE2, &PixelKernels::PremultiplyAVX2 } },
+        { "Unpremultiply", { &PixelKernels::UnpremultiplyScalar, &PixelKernels::UnpremultiplySSE2, &PixelKernels::UnpremultiplyAVX2 } },
+        { "ReverseRow", { &PixelKernels::ReverseRowScalar, &PixelKernels::ReverseRowSSE2, &PixelKernels::ReverseRowAVX2 } },
+    };
+
+    // Zero alpha on some pixels and colors above alpha on most cover the premultiply clamping.
+    auto src = MakeRandomBytes((kMaxWidth + 4) * 4, 1);
+    for (UINT i = 0; i < kMaxWidth; i += 3) src[i * 4 + 3] = 0;
+
+    for (const auto isa : GetSimdIsas())
+    {
+        for (const auto& kernel : kernels)
+        {
+            for (UINT width = 0; width <= kMaxWidth; ++width)
+            {
+                std::vector<BYTE> expected(kMaxWidth * 8 + 16, 0xCD);
+                std::vector<BYTE> actual(kMaxWidth * 8 + 16, 0xCD);
+                kernel.funcs[0](src.data() + GetOffset(width), expected.data(), width);
+                kernel.funcs[static_cast<int>(isa)](src.data() + GetOffset(width), actual.data(), width);
+                CHECK(IsSame(kernel.name, isa, width, expected.data(), actual.data(), expected.size()));
+            }
+        }
+
+        // In place, as GetPixels() converts its output.
+        for (UINT width = 0; width <= kMaxWidth; ++width)
+        {
+            std::vector<BYTE> expected(src.begin(), src.end());
+            std::vector<BYTE> actual(src.begin(), src.end());
+            PixelKernels::SwapRedBlueScalar(expected.data() + 4, expected.data() + 4, width);
+            kernels[0].funcs[static_cast<int>(isa)](actual.data() + 4, actual.data() + 4, width);
+            CHECK(IsSame("SwapRedBlue in place", isa, width, expected.data(), actual.data(), expected.size()));
+        }
+    }
+}
+
+
+TEST(PixelKernels_XorAndHasAlphaMatchScalar)
+{
+    const PixelKernels::XorFunc xors[] = { &PixelKernels::XorScalar, &PixelKernels::XorSSE2, &PixelKernels::XorAVX2 };
+    const PixelKernels::HasAlphaFunc hasAlphas[] = { &PixelKernels::HasAlphaScalar, &PixelKernels::HasAlphaSSE2, &PixelKernels::HasAlphaAVX2 };
+
+    const auto src1 = MakeRandomBytes((kMaxWidth + 4) * 4, 2);
+    const auto src2 = MakeRandomBytes((kMaxWidth + 4) * 4, 3);
+
+    for (const auto isa : GetSimdIsas())
+    {
+        for (UINT width = 0; width <= kMaxWidth; ++width)
+        {
+            std::vector<BYTE> expected(kMaxWidth * 4 + 16, 0xCD);
+            std::vector<BYTE> actual(kMaxWidth * 4 + 16, 0xCD);
+            xors[0](src1.data() + GetOffset(width), src2.data(), expected.data(), width);
+            xors[static_cast<int>(isa)](src1.data() + GetOffset(width), src2.data(), actual.data(), width);
+            CHECK(IsSame("Xor", isa, width, expected.data(), actual.data(), expected.size()));
+
+            // A single alpha in the last pixel has to be found in the tail, and alpha past the width must be ignored.
+            std::vector<BYTE> noAlpha(kMaxWidth * 4 + 16, 0x7F);
+            for (size_t i = 3; i < noAlpha.size(); i += 4) noAlpha[i] = 0;
+            for (size_t i = width * 4 + 3; i < noAlpha.size(); i += 4) noAlpha[i] = 0xFF;
+            CHECK(!hasAlphas[static_cast<int>(isa)](noAlpha.data(), width));
+
+            if (width == 0) continue;
+            noAlpha[(width - 1) * 4 + 3] = 1;
+            CHECK(hasAlphas[static_cast<int>(isa)](noAlpha.data(), width));
+        }
+    }
+}
+
+
+// The AND/XOR rules of monochrome and masked color cursors, checked on known pixels for every variant.
+TEST(PixelKernels_CursorMaskRules)
+{
+    const PixelKernels::ApplyCursorMaskFunc applyMasks[] = { &PixelKernels::ApplyCursorMaskScalar, &PixelKernels::ApplyCursorMaskSSE2, &PixelKernels::ApplyCursorMaskAVX2 };
+    const PixelKernels::CompositeCursorFunc composites[] = { &PixelKernels::CompositeCursorScalar, &PixelKernels::CompositeCursorSSE2, &PixelKernels::CompositeCursorAVX2 };
+
+    std::vector<CpuIsa> isas = GetSimdIsas();
+    isas.insert(isas.begin(), CpuIsa::Scalar);
+
+    for (const auto isa : isas)
+    {
+        const auto applyMask = applyMasks[static_cast<int>(isa)];
+        const auto composite = composites[static_cast<int>(isa)];
+
+        // Enough pixels to run through the vector loops and the tails, repeating the 4 cases.
+        for (UINT width = 0; width <= kMaxWidth; ++width)
+        {
+            std::vector<BYTE> color(width * 4 + 4), mask(width * 4 + 4), masked(width * 4 + 4);
+            for (UINT x = 0; x < width; ++x)
+            {
+                // The alpha bytes of the bitmaps are undefined and must be ignored.
+                switch (x % 4)
+                {
+                    case 0: StorePixel(&color[x * 4], 0x12345678); StorePixel(&mask[x * 4], 0x55000000); break;  // Outside the mask.
+                    case 1: StorePixel(&color[x * 4], 0x00000000); StorePixel(&mask[x * 4], 0x00FFFFFF); break;  // Masked black: transparent.
+                    case 2: StorePixel(&color[x * 4], 0xAAFFFFFF); StorePixel(&mask[x * 4], 0x00FFFFFF); break;  // Masked white: inverts the screen.
+                    case 3: StorePixel(&color[x * 4], 0x00000100); StorePixel(&mask[x * 4], 0x00010000); break;  // Masked, one colored bit.
+                }
+            }
+
+            applyMask(color.data(), mask.data(), masked.data(), width);
+            for (UINT x = 0; x < width; ++x)
+            {
+                const UINT expected[] = { 0xFF345678, 0x00000000, 0xFF000000, 0xFF000000 };
+                CHECK(IsPixel("ApplyCursorMask", isa, x, &masked[x * 4], expected[x % 4]));
+            }
+
+            // DrawIcon() inverts the desktop under a monochrome cursor; the changed pixels become opaque.
+            std::vector<BYTE> desktop(width * 4 + 4), desktopWithCursor(width * 4 + 4), cursor(width * 4 + 4), composited(width * 4 + 4);
+            for (UINT x = 0; x < width; ++x)
+            {
+                switch (x % 4)
+                {
+                    case 0: StorePixel(&desktop[x * 4], 0x00102030); StorePixel(&desktopWithCursor[x * 4], 0x00102030); StorePixel(&cursor[x * 4], 0x80405060); break;  // Cursor with alpha.
+                    case 1: StorePixel(&desktop[x * 4], 0x00102030); StorePixel(&desktopWithCursor[x * 4], 0x00EFDFCF); StorePixel(&cursor[x * 4], 0x00000000); break;  // Inverted.
+                    case 2: StorePixel(&desktop[x * 4], 0x00102030); StorePixel(&desktopWithCursor[x * 4], 0xFF102030); StorePixel(&cursor[x * 4], 0x00FFFFFF); break;  // Alpha only differs.
+                    case 3: StorePixel(&desktop[x * 4], 0x00102030); StorePixel(&desktopWithCursor[x * 4], 0x00000000); StorePixel(&cursor[x * 4], 0x00000000); break;  // Drawn black.
+                }
+            }
+
+            composite(desktop.data(), desktopWithCursor.data(), cursor.data(), composited.data(), width);
+            for (UINT x = 0; x < width; ++x)
+            {
+                const UINT expected[] = { 0x80405060, 0xFFEFDFCF, 0x00102030, 0xFF000000 };
+                CHECK(IsPixel("CompositeCursor", isa, x, &composited[x * 4], expected[x % 4]));
+            }
+        }
+    }
+}
+
+
+TEST(PixelKernels_CursorKernelsMatchScalarOnRandomRows)
+{
+    const PixelKernels::ApplyCursorMaskFunc applyMasks[] = { &PixelKernels::ApplyCursorMaskScalar, &PixelKernels::ApplyCursorMaskSSE2, &PixelKernels::ApplyCursorMaskAVX2 };
+    const PixelKernels::CompositeCursorFunc composites[] = { &PixelKernels::CompositeCursorScalar, &PixelKernels::CompositeCursorSSE2, &PixelKernels::CompositeCursorAVX2 };
+
+    // Equal, black and transparent pixels here and there take every branch.
+    auto desktop = MakeRandomBytes((kMaxWidth + 4) * 4, 4);
+    auto desktopWithCursor = MakeRandomBytes((kMaxWidth + 4) * 4, 5);
+    auto cursor = MakeRandomBytes((kMaxWidth + 4) * 4, 6);
+    for (UINT i = 0; i < (kMaxWidth + 4) * 4; i += 12)
+    {
+        memcpy(&desktopWithCursor[i], &desktop[i], 4);
+        cursor[i + 3] = 0;
+        if (i % 24 == 0) memset(&cursor[i + 4], 0, 3);
+        if (i % 36 == 0) memset(&desktopWithCursor[i + 4], 0, 3);
+    }
+
+    for (const auto isa : GetSimdIsas())
+    {
+        for (UINT width = 0; width <= kMaxWidth; ++width)
+        {
+            std::vector<BYTE> expected(kMaxWidth * 4 + 16, 0xCD);
+            std::vector<BYTE> actual(kMaxWidth * 4 + 16, 0xCD);
+            const BYTE* d = desktop.data() + GetOffset(width);
+            composites[0](d, desktopWithCursor.data(), cursor.data() + 4, expected.data(), width);
+            composites[static_cast<int>(isa)](d, desktopWithCursor.data(), cursor.data() + 4, actual.data(), width);
+            CHECK(IsSame("CompositeCursor", isa, width, expected.data(), actual.data(), expected.size()));
+
+            applyMasks[0](cursor.data() + 4, desktopWithCursor.data(), expected.data(), width);
+            applyMasks[static_cast<int>(isa)](cursor.data() + 4, desktopWithCursor.data(), actual.data(), width);
+            CHECK(IsSame("ApplyCursorMask", isa, width, expected.data(), actual.data(), expected.size()));
+        }
+    }
+}
+
+
+TEST(PixelKernels_ResampleKernelsMatchScalar)
+{
+    const PixelKernels::AccumulateRowFunc accumulates[] = { &PixelKernels::AccumulateRowScalar, &PixelKernels::AccumulateRowSSE2, &PixelKernels::AccumulateRowAVX2 };
+    const PixelKernels::FilterRowFunc filters[] = { &PixelKernels::FilterRowScalar, &PixelKernels::FilterRowSSE2, &PixelKernels::FilterRowAVX2 };
+    const PixelKernels::Downsample2xFunc downsamples[] = { &PixelKernels::Downsample2xScalar, &PixelKernels::Downsample2xSSE2, &PixelKernels::Downsample2xAVX2 };
+
+    const auto src0 = MakeRandomBytes((kMaxWidth * 2 + 4) * 4, 7);
+    const auto src1 = MakeRandomBytes((kMaxWidth * 2 + 4) * 4, 8);
+
+    for (const auto isa : GetSimdIsas())
+    {
+        for (UINT width = 0; width <= kMaxWidth; ++width)
+        {
+            std::vector<float> expectedSums((kMaxWidth + 8) * 4), actualSums((kMaxWidth + 8) * 4);
+            for (size_t i = 0; i < expectedSums.size(); ++i)
+            {
+                expectedSums[i] = actualSums[i] = static_cast<float>(src1[i % src1.size()]) * 0.5f;
+            }
+            accumulates[0](src0.data() + GetOffset(width), 0.3f, expectedSums.data(), width * 4);
+            accumulates[static_cast<int>(isa)](src0.data() + GetOffset(width), 0.3f, actualSums.data(), width * 4);
+            CHECK(IsSame("AccumulateRow", isa, width, expectedSums.data(), actualSums.data(), expectedSums.size() * sizeof(float)));
+
+            // Negative lobes and gains above 1 take the results out of range, so the clamping is covered too.
+            for (UINT tapCount = 1; tapCount <= 4; ++tapCount)
+            {
+                std::vector<UINT> starts(width + 1);
+                std::vector<float> weights((width + 1) * tapCount);
+                for (UINT x = 0; x < width; ++x)
+                {
+                    starts[x] = x;
+                    for (UINT i = 0; i < tapCount; ++i)
+                    {
+                        weights[x * tapCount + i] = (i % 2 ? -0.25f : 1.125f) + static_cast<float>(x % 5) * 0.0625f;
+                    }
+                }
+
+                std::vector<BYTE> expected(kMaxWidth * 4 + 16, 0xCD);
+                std::vector<BYTE> actual(kMaxWidth * 4 + 16, 0xCD);
+                filters[0](expectedSums.data(), starts.data(), weights.data(), tapCount, expected.data(), width);
+                filters[static_cast<int>(isa)](expectedSums.data(), starts.data(), weights.data(), tapCount, actual.data(), width);
+                CHECK(IsSame("FilterRow", isa, width, expected.data(), actual.data(), expected.size()));
+            }
+
+            std::vector<BYTE> expected(kMaxWidth * 4 + 16, 0xCD);
+            std::vector<BYTE> actual(kMaxWidth * 4 + 16, 0xCD);
+            downsamples[0](src0.data() + GetOffset(width), src1.data(), expected.data(), width);
+            downsamples[static_cast<int>(isa)](src0.data() + GetOffset(width), src1.data(), actual.data(), width);
+            CHECK(IsSame("Downsample2x", isa, width, expected.data(), actual.data(), expected.size()));
+        }
+    }
+}
+
+
+TEST(PixelKernels_WeightedSumMatchesScalar)
+{
+    const PixelKernels::WeightedSumFunc sums[] = { &PixelKernels::WeightedSumScalar, &PixelKernels::WeightedSumSSE2, &PixelKernels::WeightedSumAVX2 };
+
+    // Luma, and chroma with negative weights and an offset that takes some results out of range.
+    const ColorWeights weightSets[] = { { 25, 129, 66, 16 }, { 112, -86, -26, 128 }, { -38, -74, 112, 128 } };
+    const auto src = MakeRandomBytes((kMaxWidth + 4) * 4, 9);
+
+    for (const auto isa : GetSimdIsas())
+    {
+        for (const auto& weights : weightSets)
+        {
+            for (UINT step = 1; step <= 4; ++step)
+            {
+                for (UINT width = 0; width <= kMaxWidth; ++width)
+                {
+                    std::vector<BYTE> expected(kMaxWidth * 4 + 16, 0xCD);
+                    std::vector<BYTE> actual(kMaxWidth * 4 + 16, 0xCD);
+                    sums[0](src.data() + GetOffset(width), expected.data(), step, width, weights);
+                    sums[static_cast<int>(isa)](src.data() + GetOffset(width), actual.data(), step, width, weights);
+                    CHECK(IsSame("WeightedSum", isa, width, expected.data(), actual.data(), expected.size()));
+                }
+            }
+        }
+    }
+}
+
+
+TEST(PixelKernels_HashKernelsMatchScalar)
+{
+    const PixelKernels::HashTileRowFunc tileHashes[] = { &PixelKernels::HashTileRowScalar, &PixelKernels::HashTileRowSSE2, &PixelKernels::HashTileRowAVX2 };
+    const PixelKernels::HashColumnsFunc columnHashes[] = { &PixelKernels::HashColumnsScalar, &PixelKernels::HashColumnsSSE2, &PixelKernels::HashColumnsAVX2 };
+
+    const auto src = MakeRandomBytes((kMaxWidth + 4) * 4, 10);
+
+    for (const auto isa : GetSimdIsas())
+    {
+        for (UINT tileWidth = 8; tileWidth <= 64; tileWidth *= 2)
+        {
+            for (UINT width = 0; width <= kMaxWidth; ++width)
+            {
+                const UINT laneCount = (kMaxWidth + tileWidth - 1) / tileWidth * 4;
+                std::vector<UINT64> expected(laneCount), actual(laneCount);
+                for (UINT i = 0; i < laneCount; ++i)
+                {
+                    expected[i] = actual[i] = i * 0x9E3779B97F4A7C15ULL;
+                }
+                tileHashes[0](src.data() + GetOffset(width), width, tileWidth, expected.data());
+                tileHashes[static_cast<int>(isa)](src.data() + GetOffset(width), width, tileWidth, actual.data());
+                CHECK(IsSame("HashTileRow", isa, width, expected.data(), actual.data(), laneCount * sizeof(UINT64)));
+            }
+        }
+
+        for (UINT width = 0; width <= kMaxWidth; ++width)
+        {
+            std::vector<UINT> expected(kMaxWidth + 8), actual(kMaxWidth + 8);
+            for (UINT x = 0; x < kMaxWidth + 8; ++x)
+            {
+                expected[x] = actual[x] = x * 0x9E3779B1;
+            }
+            columnHashes[0](src.data() + GetOffset(width), width, expected.data());
+            columnHashes[static_cast<int>(isa)](src.data() + GetOffset(width), width, actual.data());
+            CHECK(IsSame("HashColumns", isa, width, expected.data(), actual.data(), expected.size() * sizeof(UINT)));
+        }
+    }
+}
+
+
+// Sizes cross the cache tile and leave partial micro tiles at both edges; either stride may be
+// negative, as for bottom-up reads and flipped outputs.
+TEST(PixelKernels_TransposeMatchesScalar)
+{
+    const PixelKernels::TransposeFunc transposes[] = { &PixelKernels::TransposeScalar, &PixelKernels::TransposeSSE2, &PixelKernels::TransposeAVX2 };
+    const UINT sizes[] = { 1, 3, 4, 7, 8, 9, 31, 33, 37, 70 };
+
+    for (const auto isa : GetSimdIsas())
+    {
+        for (const UINT width : sizes)
+        {
+            for (const UINT height : sizes)
+            {
+                const auto image = MakeRandomBytes(width * height * 4, width * 131 + height);
+                const int srcStride = static_cast<int>(width * 4);
+                const int dstStride = static_cast<int>(height * 4);
+
+                for (UINT flip = 0; flip < 4; ++flip)
+                {
+                    const bool flipSrc = (flip & 1) != 0;
+                    const bool flipDst = (flip & 2) != 0;
+                    const BYTE* src = image.data() + (flipSrc ? (height - 1) * width * 4 : 0);
+
+                    std::vector<BYTE> expected(width * height * 4, 0xCD);
+                    std::vector<BYTE> actual(width * height * 4, 0xCD);
+                    const size_t dstOffset = flipDst ? (width - 1) * height * 4 : 0;
+
+                    transposes[0](src, flipSrc ? -srcStride : srcStride, expected.data() + dstOffset, flipDst ? -dstStride : dstStride, width, height);
+                    transposes[static_cast<int>(isa)](src, flipSrc ? -srcStride : srcStride, actual.data() + dstOffset, flipDst ? -dstStride : dstStride, width, height);
+                    CHECK(IsSame("Transpose", isa, width * 1000 + height, expected.data(), actual.data(), expected.size()));
+                }
+
+                // And the scalar variant itself: column x of the source is row x of the destination.
+                std::vector<BYTE> transposed(width * height * 4);
+                PixelKernels::TransposeScalar(image.data(), srcStride, transposed.data(), dstStride, width, height);
+                for (UINT y = 0; y < height; ++y)
+                {
+                    for (UINT x = 0; x < width; ++x)
+                    {
+                        CHECK(LoadPixel(&transposed[(x * height + y) * 4]) == LoadPixel(&image[(y * width + x) * 4]));
+                    }
+                }
+            }
+        }
+    }
+}
+
+
+// Initialize() checks the variants it binds and falls back to the scalar ones if any differs,
+// so on a working build the best detected level stays active.
+TEST(PixelKernels_InitializeBindsVerifiedVariants)
+{
+    PixelKernels::Initialize();
+    CHECK(PixelKernels::GetActiveIsa() == PixelKernels::GetDetectedIsa());
+
+    for (const auto isa : GetSimdIsas())
+    {
+        PixelKernels::Initialize(isa);
+        CHECK(PixelKernels::GetActiveIsa() == isa);
+    }
+
+    PixelKernels::Initialize();
+}
@@ -0,0 +1,106 @@
+#include "pch.h"
+#include <cstdio>
+#include <functional>
+#include "Test.h"
+#include "../sources/AllocationCounter.h"
+#include "../sources/FrameRing.h"
+
+namespace
+{
+    constexpr int kIterationCount = 5000000;
+    constexpr int kRunCount = 5;
+
+    // The guard as it was before it became a template: the callback goes through std::function.
+    class FunctionReleaser
+    {
+    public:
+        explicit FunctionReleaser(std::function<void()>&& func) : func_(std::move(func)) {}
+        ~FunctionReleaser() { func_(); }
+
+    private:
+        const std::function<void()> func_;
+    };
+
+    bool Publish(FrameRing* ring)
+    {
+        auto frame = ring->BeginWrite();
+        if (!frame) return false;
+
+        frame->width = 1;
+        frame->height = 1;
+        frame->buffer.ExpandIfNeeded(4);
+        ring->EndWrite(true);
+        return true;
+    }
+
+    // Prints the time and the heap allocations per pin and release of a ring slot.
+    template <class Func>
+    void Report(const char* name, Func&& pinAndRelease)
+    {
+        const UINT64 start = AllocationCounter::GetThreadCount();
+        pinAndRelease();
+        const UINT64 allocationCount = AllocationCounter::GetThreadCount() - start;
+
+        const double time = MeasureMilliseconds(kRunCount, pinAndRelease);
+        printf("  %-20s %6.2f ns  %4.2f allocations\n", name, time * 1e6 / kIterationCount, static_cast<double>(allocationCount) / kIterationCount);
+    }
+}
+
+
+// Several timers and checks in one scope need names of their own, which only a paste of the
+// expanded __COUNTER__ gives; this does not compile otherwise.
+TEST(ScopeGuard_MacrosNestInOneScope)
+{
+    SCOPE_TIMER(First)
+    SCOPE_TIMER(Second)
+    ALLOCATION_CHECK(First)
+    ALLOCATION_CHECK(Second)
+    FUNCTION_SCOPE_TIMER
+    FUNCTION_SCOPE_TIMER
+}
+
+
+// The guard that releases the ring pin in Upload(), which runs every frame for every window, with
+// the callback stored inline and through std::function. The callback captures three references,
+// which is past the small buffer of some std::function implementations.
+BENCHMARK(ScopeGuard_TemplateVersusStdFunction)
+{
+    FrameRing ring;
+    CHECK(Publish(&ring));
+    UINT64 releaseCount = 0;
+
+    printf("  per guard, best of %d runs of %d\n", kRunCount, kIterationCount);
+
+    Report("no guard", [&]
+    {
+        for (int i = 0; i < kIterationCount; ++i)
+        {
+            const int index = ring.AcquireRead();
+            ring.ReleaseRead(index);
+            ++releaseCount;
+        }
+    });
+
+    Report("MakeScopedReleaser", [&]
+    {
+        for (int i = 0; i < kIterationCount; ++i)
+        {
+            const int index = ring.AcquireRead();
+            const auto releaser = MakeScopedReleaser([&] { ring.ReleaseRead(index); ++releaseCount; });
+        }
+    });
+
+    Report("std::function", [&]
+    {
+        for (int i = 0; i < kIterationCount; ++i)
+        {
+            const int index = ring.AcquireRead();
+            const FunctionReleaser releaser([&] { ring.ReleaseRead(index); ++releaseCount; });
+        }
+    });
+
+    // Every pin was released, so the slot can be evicted.
+    CHECK(releaseCount == 3ull * (kRunCount + 1) * kIterationCount);
+    ring.Evict();
+    CHECK(!ring.HasFrame());
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+// Minimal test registry for the tests project.
+// TEST() defines a test function and registers it; CHECK() marks the running test as failed and returns from it.
+// BENCHMARK() registers a function that prints timings; benchmarks run only with --benchmark.
+struct TestCase
+{
+    const char* name;
+    void (*func)();
+    bool isBenchmark;
+};
+
+std::vector<TestCase>& GetTestCases();
+void FailTest(const char* file, int line, const char* expression);
+
+struct TestRegistrar
+{
+    TestRegistrar(const char* name, void (*func)(), bool isBenchmark = false)
+    {
+        GetTestCases().push_back({ name, func, isBenchmark });
+    }
+};
+
+#define TEST(Name) \
+    static void Name(); \
+    static const TestRegistrar _testRegistrar_##Name(#Name, Name); \
+    static void Name()
+
+#define BENCHMARK(Name) \
+    static void Name(); \
+    static const TestRegistrar _testRegistrar_##Name(#Name, Name, true); \
+    static void Name()
+
+#define CHECK(Expression) \
+    do \
+    { \
+        if (!(Expression)) \
+        { \
+            FailTest(__FILE__, __LINE__, #Expression); \
+            return; \
+        } \
+    } while (false)
+
+
+// Runs func runCount times and returns the fastest run in milliseconds, which is the one least
+// disturbed by the rest of the system.
+template <class Func>
+double MeasureMilliseconds(int runCount, Func&& func)
+{
+    double best = 0.0;
+    for (int i = 0; i < runCount; ++i)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        func();
+        const std::chrono::duration<double, std::milli> time = std::chrono::steady_clock::now() - start;
+        best = i == 0 ? time.count() : std::min<double>(best, time.count());
+    }
+    return best;
+}
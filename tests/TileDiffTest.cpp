@@ -0,0 +1,63 @@
+#include "pch.h"
+#include "Test.h"
+#include "../sources/TileDiff.h"
+
+namespace
+{
+    void FillRandom(const ImageView<PixelFormatBGRA8>& view, UINT seed)
+    {
+        for (UINT y = 0; y < view.GetHeight(); ++y)
+        {
+            auto row = view.GetRowPixels(y);
+            for (UINT x = 0; x < view.GetWidth(); ++x)
+            {
+                seed = seed * 1664525u + 1013904223u;
+                row[x] = seed;
+            }
+        }
+    }
+}
+
+
+// Captures drop frames that hash the same as the published one, while GetBuffer() and the
+// snapshots expose the whole frame: a change outside the region, such as in the shadow of a
+// window, must change the frame hash although no tile is dirty.
+TEST(TileDiff_FrameHashCoversPixelsOutsideRegion)
+{
+    constexpr UINT kWidth = 300;
+    constexpr UINT kHeight = 200;
+    constexpr UINT kLeft = 10;
+    constexpr UINT kTop = 12;
+    constexpr UINT kRegionWidth = 250;
+    constexpr UINT kRegionHeight = 150;
+
+    Image<PixelFormatBGRA8> frame(kWidth, kHeight);
+    FillRandom(frame.GetView(), 5);
+
+    TileHasher hasher;
+    DirtyTiles dirtyTiles;
+    CHECK(hasher.Update(frame.GetView(), kLeft, kTop, kRegionWidth, kRegionHeight, 1, &dirtyTiles));
+    UINT64 hash = hasher.GetFrameHash();
+
+    // The same frame hashes the same.
+    CHECK(hasher.Update(frame.GetView(), kLeft, kTop, kRegionWidth, kRegionHeight, 1, &dirtyTiles));
+    CHECK(dirtyTiles.GetDirtyCount() == 0);
+    CHECK(hasher.GetFrameHash() == hash);
+
+    // Above, left of, right of and below the region, and the last pixel of the frame.
+    const UINT pixels[][2] = { { 150, 0 }, { 0, 80 }, { kLeft - 1, kTop }, { kLeft + kRegionWidth, 100 }, { 299, kTop + kRegionHeight }, { kWidth - 1, kHeight - 1 } };
+    for (const auto& pixel : pixels)
+    {
+        frame.GetView().GetRowPixels(pixel[1])[pixel[0]] ^= 0x00010000;
+        CHECK(hasher.Update(frame.GetView(), kLeft, kTop, kRegionWidth, kRegionHeight, 1, &dirtyTiles));
+        CHECK(dirtyTiles.GetDirtyCount() == 0);
+        CHECK(hasher.GetFrameHash() != hash);
+        hash = hasher.GetFrameHash();
+    }
+
+    // A change inside the region still changes both.
+    frame.GetView().GetRowPixels(kTop)[kLeft] ^= 0x00010000;
+    CHECK(hasher.Update(frame.GetView(), kLeft, kTop, kRegionWidth, kRegionHeight, 1, &dirtyTiles));
+    CHECK(dirtyTiles.GetDirtyCount() == 1);
+    CHECK(hasher.GetFrameHash() != hash);
+}
@@ -0,0 +1,49 @@
+#include "pch.h"
+#include <cstdio>
+#include <cstring>
+#include "Test.h"
+#include "../sources/PixelKernels.h"
+
+namespace
+{
+    bool _failed = false;
+}
+
+
+std::vector<TestCase>& GetTestCases()
+{
+    static std::vector<TestCase> cases;
+    return cases;
+}
+
+
+void FailTest(const char* file, int line, const char* expression)
+{
+    printf("  %s(%d): CHECK(%s) failed\n", file, line, expression);
+    _failed = true;
+}
+
+
+// Runs every registered test, or every benchmark with --benchmark, and returns the number of failed ones.
+int main(int argc, char* argv[])
+{
+    PixelKernels::Initialize();
+
+    const bool isBenchmark = argc > 1 && strcmp(argv[1], "--benchmark") == 0;
+
+    int failedCount = 0;
+    int runCount = 0;
+    for (const auto& test : GetTestCases())
+    {
+        if (test.isBenchmark != isBenchmark) continue;
+
+        ++runCount;
+        _failed = false;
+        test.func();
+        printf("[%s] %s\n", _failed ? "FAIL" : " OK ", test.name);
+        if (_failed) ++failedCount;
+    }
+
+    printf("%d of %d %s failed\n", failedCount, runCount, isBenchmark ? "benchmarks" : "tests");
+    return failedCount;
+}
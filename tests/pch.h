@@ -0,0 +1,12 @@
+﻿#ifndef PCH_H
+#define PCH_H
+
+// Stands in for the module's pch.h: the tests build the portable sources without the Unity/Unreal
+// interfaces and the window manager.
+#include <Windows.h>
+#include <wrl/client.h>
+#include <d3d11.h>
+
+#include "../sources/Debug.h"
+#include "../sources/Timer.h"
+#endif //PCH_H